@@ -0,0 +1,147 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   CompactPairings.h
+ * @brief  Compact, structure-of-arrays storage of pairings
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Pairings.h>
+#include <mp2p_icp/copyable_mutex.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup  mp2p_icp_grp
+ * @{ */
+
+/** Compact alternative to Pairings, with the coordinates of each pairing
+ * type in separate float arrays (structure-of-arrays), and planes stored
+ * once in a shared table and referenced by index.
+ *
+ * Compared to Pairings, point-to-plane pairings take 16 bytes (plus their
+ * share of the plane table) instead of 68, and coordinate arrays are
+ * streamed sequentially by the solvers. Point-to-point pairings keep their
+ * point indices, but drop `TMatchingPair::errorSquareAfterTransformation`.
+ *
+ * Point-to-line, line-to-line and plane-to-plane pairings, which are rare
+ * and small in number, are kept in their original form.
+ *
+ * Solvers take them through Solver::optimal_pose(const CompactPairings&,...).
+ * Solver_GaussNewton and Solver_LevenbergMarquardt work on these arrays
+ * directly, at every inner iteration; other solvers use asPairings(), which
+ * builds the equivalent legacy structure the first time it is called, and
+ * keeps it cached. ICP uses them if Parameters::compactPairings is set.
+ *
+ * The plane table is kept in double precision, so the conversion is exact
+ * in both directions.
+ */
+struct CompactPairings
+{
+    /** Point-to-point pairings: coordinates and indices of the global
+     * ("this") and local ("other") points. */
+    struct PointPairs
+    {
+        std::vector<float>    this_x, this_y, this_z;
+        std::vector<float>    other_x, other_y, other_z;
+        std::vector<uint32_t> this_idx, other_idx;
+
+        PointPairs() = default;
+        explicit PointPairs(const mrpt::tfest::TMatchingPairList& pairs);
+
+        std::size_t size() const { return this_x.size(); }
+        bool        empty() const { return this_x.empty(); }
+
+        void reserve(const std::size_t n);
+        void push_back(const mrpt::tfest::TMatchingPair& p);
+        mrpt::tfest::TMatchingPair at(const std::size_t i) const;
+    };
+
+    /** Shared table of planes. */
+    struct PlaneTable
+    {
+        std::vector<double> nx, ny, nz, d;  //!< Plane: nx*x+ny*y+nz*z+d=0
+        std::vector<double> cx, cy, cz;  //!< Centroid of the plane patch
+
+        std::size_t size() const { return nx.size(); }
+        bool        empty() const { return nx.empty(); }
+
+        /** Appends a plane and returns its index. */
+        uint32_t      push_back(const plane_patch_t& p);
+        plane_patch_t at(const std::size_t i) const;
+    };
+
+    /** Point-to-plane pairings: local points, and the index of the global
+     * plane in the shared `planes` table. */
+    struct PointPlanePairs
+    {
+        std::vector<float>    other_x, other_y, other_z;
+        std::vector<uint32_t> plane_idx;
+
+        std::size_t size() const { return other_x.size(); }
+        bool        empty() const { return other_x.empty(); }
+
+        void push_back(const mrpt::math::TPoint3Df& pt, const uint32_t plane);
+    };
+
+    /** Symmetric point-to-plane pairings. See point_plane_sym_pair_t. */
+    struct PointPlaneSymPairs
+    {
+        std::vector<float> this_x, this_y, this_z;
+        std::vector<float> n_this_x, n_this_y, n_this_z;
+        std::vector<float> other_x, other_y, other_z;
+        std::vector<float> n_other_x, n_other_y, n_other_z;
+
+        std::size_t size() const { return this_x.size(); }
+        bool        empty() const { return this_x.empty(); }
+
+        void                   push_back(const point_plane_sym_pair_t& p);
+        point_plane_sym_pair_t at(const std::size_t i) const;
+    };
+
+    PointPairs         pt2pt;
+    PointPlanePairs    pt2pl;
+    PointPlaneSymPairs pt2pl_sym;
+    PlaneTable         planes;
+
+    TMatchedPointLineList paired_pt2ln;
+    TMatchedLineList      paired_ln2ln;
+    TMatchedPlaneList     paired_pl2pl;
+
+    /** Optional *individual* weights of each pairing, in the same order than
+     * the arrays above. See PairingWeights. */
+    PairingWeights weights;
+
+    /** Builds the compact form of `p`. Identical planes of point-to-plane
+     * pairings are stored only once. */
+    static CompactPairings FromPairings(const Pairings& p);
+
+    bool empty() const;
+
+    /** Overall number of pairings, of all types */
+    std::size_t size() const;
+
+    /** Returns the equivalent Pairings, built on the first call and cached.
+     * Safe to call from several threads.
+     * \note Call invalidateCache() after modifying any pairing. */
+    const Pairings& asPairings() const;
+
+    /** Drops the cached result of asPairings(). */
+    void invalidateCache();
+
+   private:
+    mutable std::optional<Pairings> legacy_;
+    mutable copyable_mutex_t        legacyMtx_;
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
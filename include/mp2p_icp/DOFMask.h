@@ -0,0 +1,65 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   DOFMask.h
+ * @brief  Selection of the degrees of freedom of the pose to be estimated
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mrpt/containers/yaml.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/serialization/CArchive.h>
+
+#include <vector>
+
+namespace mp2p_icp
+{
+/** Selection of which degrees of freedom (DOFs) of the relative pose are
+ * estimated by ICP solvers. Fixed DOFs keep the value of the initial guess.
+ *
+ * Typical uses are ground vehicles or planar robots (Planar(): x, y, yaw),
+ * or platforms where an IMU provides roll and pitch (XYZYaw()).
+ *
+ * Solvers working on incremental rotations handle rotational DOFs as
+ * rotations about the global axes: `roll`, `pitch`, `yaw` about X, Y, Z,
+ * respectively. This matches exactly the yaw-pitch-roll angles when only
+ * `yaw` is free, which covers the cases above.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+struct DOFMask
+{
+    bool x = true, y = true, z = true;
+    bool yaw = true, pitch = true, roll = true;
+
+    /** x, y and yaw free; z, pitch, roll fixed */
+    static DOFMask Planar();
+
+    /** x, y, z and yaw free; pitch, roll fixed */
+    static DOFMask XYZYaw();
+
+    /** true if all 6 DOFs are free (the default) */
+    bool allFree() const { return x && y && z && yaw && pitch && roll; }
+
+    /** Indices of the free DOFs in an SE(3) increment vector
+     * `[tx ty tz wx wy wz]`, with `wx,wy,wz` the rotations about the global
+     * X (roll), Y (pitch), and Z (yaw) axes. */
+    std::vector<int> freeIncrementIndices() const;
+
+    /** Returns `p`, with its fixed DOFs (in the x,y,z,yaw,pitch,roll
+     * parameterization) replaced by those of `ref`. */
+    mrpt::poses::CPose3D project(
+        const mrpt::poses::CPose3D& p, const mrpt::poses::CPose3D& ref) const;
+
+    void load_from(const mrpt::containers::yaml& p);
+    void save_to(mrpt::containers::yaml& p) const;
+    void serializeTo(mrpt::serialization::CArchive& out) const;
+    void serializeFrom(mrpt::serialization::CArchive& in);
+};
+
+}  // namespace mp2p_icp
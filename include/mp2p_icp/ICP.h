@@ -20,6 +20,7 @@
 #include <mp2p_icp/Solver.h>
 #include <mp2p_icp/pointcloud.h>
 #include <mrpt/containers/yaml.h>
+#include <mrpt/math/TPose2D.h>
 #include <mrpt/math/TPose3D.h>
 #include <mrpt/rtti/CObject.h>
 #include <mrpt/system/COutputLogger.h>
@@ -57,6 +58,16 @@ class ICP : public mrpt::system::COutputLogger, public mrpt::rtti::CObject
         const mrpt::math::TPose3D& initialGuessM2wrtM1, const Parameters& p,
         Results& result);
 
+    /** Like the TPose3D version, for an SE(2) initial guess. For planar
+     * point clouds (e.g. 2D laser scans), this runs in SE(2) mode (see
+     * Parameters::autoSE2Mode), and the result is also available as a 2D
+     * pose via Results::optimal_tf_2d().
+     */
+    void align(
+        const pointcloud_t& pc1, const pointcloud_t& pc2,
+        const mrpt::math::TPose2D& initialGuessM2wrtM1, const Parameters& p,
+        Results& result);
+
     /** @name Module: Solver instances
      * @{ */
     using solver_list_t = std::vector<mp2p_icp::Solver::Ptr>;
@@ -89,6 +100,12 @@ class ICP : public mrpt::system::COutputLogger, public mrpt::rtti::CObject
         OptimalTF_Result& out, const WeightParameters& wp,
         const SolverContext& sc = {});
 
+    /** \overload For pairings in compact form. */
+    static bool run_solvers(
+        const solver_list_t& solvers, const CompactPairings& pairings,
+        OptimalTF_Result& out, const WeightParameters& wp,
+        const SolverContext& sc = {});
+
     /** @} */
 
     /** @name Module: Matcher instances
@@ -117,11 +134,20 @@ class ICP : public mrpt::system::COutputLogger, public mrpt::rtti::CObject
     const matcher_list_t& matchers() const { return matchers_; }
     matcher_list_t&       matchers() { return matchers_; }
 
-    /** Runs a set of matchers. */
+    /** Runs a set of matchers, and returns all their pairings concatenated
+     * in the same order than in `matchers`.
+     *
+     * Matchers are run concurrently on up to `maxThreads` threads (`0`: as
+     * many as hardware threads). The default (`1`) runs them serially.
+     * Before running them concurrently, the KD-trees of all point layers of
+     * both clouds are built, so the matchers only read them, and the threads
+     * each matcher may use internally are capped (MatchContext::maxThreads)
+     * so that all matchers together use at most the hardware threads.
+     */
     static Pairings run_matchers(
         const matcher_list_t& matchers, const pointcloud_t& pc1,
         const pointcloud_t& pc2, const mrpt::poses::CPose3D& pc2_wrt_pc1,
-        const MatchContext& mc = {});
+        const MatchContext& mc = {}, const std::size_t maxThreads = 1);
 
     /** @} */
 
@@ -31,6 +31,8 @@ class ICP_LibPointmatcher : public ICP
     DEFINE_MRPT_OBJECT(ICP_LibPointmatcher, mp2p_icp)
 
    public:
+    using ICP::align;
+
     void align(
         const pointcloud_t& pc1, const pointcloud_t& pc2,
         const mrpt::math::TPose3D& initialGuessM2wrtM1, const Parameters& p,
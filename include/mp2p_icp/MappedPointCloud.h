@@ -0,0 +1,111 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   MappedPointCloud.h
+ * @brief  Memory-mapped, columnar on-disk format for pointcloud_t
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** Saves a point cloud in the columnar file format, to be opened with
+ * MappedPointCloud.
+ *
+ * File layout (all numbers in host byte order, checked on load):
+ * - A header with the format version, the number of layers, planes and lines,
+ * and the offset of each data block, followed by one index entry per point
+ * layer: its name, the class name of its `CPointsMap`, its number of points,
+ * and the offsets of its `x`, `y` and `z` blocks.
+ * - One block per coordinate of each layer, as a plain `float` array.
+ * - The plane table: 7 `double`s per plane (4 plane coefficients, centroid).
+ * - The line table: 6 `double`s per line (base point, director vector).
+ *
+ * Each block starts at a multiple of 4096 bytes.
+ *
+ * The format only covers `point_layers`, `planes` and `lines`. Point clouds
+ * with `external_layers`, `quantized_layers` or `layer_normals` are rejected.
+ *
+ * \note Only the `x`, `y`, `z` coordinates of points are saved, not other
+ * per-point fields (e.g. intensity, color). Layer names must be shorter than
+ * 64 characters.
+ * \exception std::exception On any I/O error, or if `pc` has contents the
+ * format does not cover (see above).
+ */
+void save_columnar(const pointcloud_t& pc, const std::string& fileName);
+
+/** Read-only access to a point cloud saved with save_columnar(). The file is
+ * memory-mapped, so opening it takes no time regardless of its size, and
+ * point coordinates are read directly from the mapped pages, which the OS
+ * loads on demand.
+ *
+ * The coordinate pointers remain valid while this object lives.
+ */
+class MappedPointCloud
+{
+   public:
+    /** A point layer, as views of its coordinate arrays in the file */
+    struct Layer
+    {
+        std::string  name, className;
+        std::size_t  size = 0;
+        const float* x    = nullptr;
+        const float* y    = nullptr;
+        const float* z    = nullptr;
+    };
+
+    /** Maps the given file and checks its header and index.
+     * \exception std::exception If the file cannot be read, or it is not a
+     * valid columnar point cloud file.
+     */
+    explicit MappedPointCloud(const std::string& fileName);
+    ~MappedPointCloud();
+
+    MappedPointCloud(const MappedPointCloud&) = delete;
+    MappedPointCloud& operator=(const MappedPointCloud&) = delete;
+
+    const std::vector<Layer>& layers() const { return layers_; }
+
+    /** Returns the layer with the given name, or nullptr if it does not
+     * exist. */
+    const Layer* layer(const std::string& name) const;
+
+    std::size_t   planeCount() const { return nPlanes_; }
+    plane_patch_t plane(const std::size_t i) const;
+
+    std::size_t         lineCount() const { return nLines_; }
+    mrpt::math::TLine3D line(const std::size_t i) const;
+
+    /** Copies all contents into a regular point cloud. Point layers are
+     * created with their original class if it is registered, or as
+     * `CSimplePointsMap` otherwise. */
+    pointcloud_t toPointCloud() const;
+
+   private:
+    const uint8_t*       data_ = nullptr;
+    std::size_t          size_ = 0;
+    std::vector<uint8_t> buffer_;  //!< File contents, if mmap() is missing
+
+    std::vector<Layer> layers_;
+    const double*      planes_  = nullptr;
+    const double*      lines_   = nullptr;
+    std::size_t        nPlanes_ = 0, nLines_ = 0;
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
@@ -28,6 +28,15 @@ struct MatchContext
     MatchContext() = default;
 
     uint32_t icpIteration = 0;
+
+    /** true if both point clouds lie on the z=0 plane and the relative pose
+     * is an SE(2) one, so matchers may search neighbors in 2D only. */
+    bool se2 = false;
+
+    /** Maximum number of threads each matcher may use internally (`0`: no
+     * limit, other than its own parameters). Set by ICP::run_matchers() when
+     * several matchers run concurrently, to avoid oversubscribing the CPU. */
+    uint32_t maxThreads = 0;
 };
 
 /** Pointcloud matching generic base class.
@@ -44,9 +44,9 @@ class Matcher_Point2Plane : public Matcher_Points_Base
     double   planeEigenThreshold = 0.01;
 
     void implMatchOneLayer(
-        const mrpt::maps::CPointsMap& pcGlobal,
-        const mrpt::maps::CPointsMap& pcLocal,
-        const mrpt::poses::CPose3D& localPose, Pairings& out) const override;
+        const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const override;
 };
 
 }  // namespace mp2p_icp
@@ -0,0 +1,156 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Matcher_Point2PlaneSymmetric.h
+ * @brief  Pointcloud matcher: nearest points, with normals on both clouds
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Matcher_Points_Base.h>
+#include <mp2p_icp/PointNormals.h>
+#include <mp2p_icp/copyable_mutex.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** Pointcloud matcher for the symmetric point-to-plane objective
+ * (Rusinkiewicz, 2019): each local point is paired with its nearest global
+ * point, and both carry the normal of a plane fit to their own neighbors.
+ * Generates `Pairings::paired_pt2pl_sym`.
+ *
+ * Normals only depend on each point cloud, not on the relative pose, so they
+ * are computed on demand the first time a point is paired, and reused in the
+ * following ICP iterations of the same alignment. Layers with normals in
+ * pointcloud_t::layer_normals (see estimate_normals()) use those instead,
+ * regardless of `knn`. Normals are cached per layer, global or local, so a
+ * local layer matched against several global layers, even in parallel (see
+ * Matcher_Points_Base), fits each normal only once.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+class Matcher_Point2PlaneSymmetric : public Matcher_Points_Base
+{
+    DEFINE_MRPT_OBJECT(Matcher_Point2PlaneSymmetric, mp2p_icp)
+
+   public:
+    Matcher_Point2PlaneSymmetric();
+
+    /*** Parameters:
+     * - `distanceThreshold`: Inliers distance threshold [meters][mandatory]
+     * - `knn`: Number of neighbors to fit the plane of each point [mandatory]
+     * - `planeEigenThreshold`: maximum e0/e2 ratio [mandatory]
+     *
+     * Where e0 and e2 are the smallest and largest eigenvalues of the Gaussian
+     * covariance fitting the knn closest points to a point, in its own cloud.
+     * Points with a non-planar neighborhood are not paired.
+     *
+     * Plus: the parameters of Matcher_Points_Base::initialize()
+     */
+    void initialize(const mrpt::containers::yaml& params) override;
+
+    void match(
+        const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const override;
+
+   private:
+    double   distanceThreshold   = 0.50;
+    uint32_t knn                 = 5;
+    double   planeEigenThreshold = 0.01;
+
+    void implMatchOneLayer(
+        const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const override;
+
+    /** Per-point normals of one point layer, computed on demand. */
+    struct LayerNormals
+    {
+        enum class State : uint8_t
+        {
+            Unknown = 0,
+            Computing,
+            Valid,
+            NotPlanar
+        };
+
+        /** Atomic, since a local layer may be matched against several
+         * global layers from different threads. Copyable, so matchers are. */
+        struct AtomicState
+        {
+            AtomicState() = default;
+            AtomicState(const AtomicState& o) : value(o.value.load()) {}
+            AtomicState& operator=(const AtomicState& o)
+            {
+                value = o.value.load();
+                return *this;
+            }
+
+            std::atomic<State> value{State::Unknown};
+        };
+
+        std::size_t                         nPoints = 0;
+        std::vector<AtomicState>            state;
+        std::vector<mrpt::math::TVector3Df> normals;  //!< If `Valid`
+    };
+
+    /** Normals of global and local layers, keyed by their points map (for
+     * external local layers, their copy in `externalLocalCopies_`). Each
+     * point normal is written once, by the first thread to fit it. */
+    mutable std::map<const mrpt::maps::CPointsMap*, LayerNormals> normals_;
+
+    /** Normals of global and local layers in pointcloud_t::layer_normals,
+     * referenced (not copied) at the start of each alignment. */
+    mutable std::map<const mrpt::maps::CPointsMap*, PointNormals::ConstPtr>
+        precomputedNormals_;
+
+    /** Protects the maps above, not their entries. */
+    mutable copyable_mutex_t normalsMtx_;
+
+    /** Copies of external local layers, for their KD-trees. Key is the
+     * address of their `x` coordinates. */
+    mutable std::map<const float*, mrpt::maps::CPointsMap::Ptr>
+        externalLocalCopies_;
+
+    /** The points map of a local layer, or a copy of it, if external. */
+    const mrpt::maps::CPointsMap& localPointsMap(
+        const PointsView& pcLocal) const;
+
+    /** Finds (or creates) the entry of `normals_` for a layer, reset if the
+     * layer has changed its number of points. */
+    LayerNormals& layerNormals(const mrpt::maps::CPointsMap& pc) const;
+
+    /** Fits the normal of a point with the KD-tree of `pc`. Returns false if
+     * its neighborhood is not planar. */
+    bool fitNormal(
+        const mrpt::maps::CPointsMap& pc, const std::size_t idx,
+        mrpt::math::TVector3Df& normal) const;
+
+    /** Like fitNormal(), but only the first time for each point, storing
+     * the result in `ln`. */
+    bool pointNormal(
+        const mrpt::maps::CPointsMap& pc, LayerNormals& ln,
+        const std::size_t idx, mrpt::math::TVector3Df& normal) const;
+
+    /** Returns the entry of `precomputedNormals_` for a layer, or nullptr
+     * if there is none, or it does not have `nPoints` normals. */
+    PointNormals::ConstPtr findPrecomputedNormals(
+        const mrpt::maps::CPointsMap* pts, const std::size_t nPoints) const;
+
+    /** Like pointNormal(), for normals in pointcloud_t::layer_normals. */
+    bool precomputedNormal(
+        const PointNormals& pn, const std::size_t idx,
+        mrpt::math::TVector3Df& normal) const;
+};
+
+}  // namespace mp2p_icp
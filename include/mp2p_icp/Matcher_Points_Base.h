@@ -12,16 +12,25 @@
 #pragma once
 
 #include <mp2p_icp/Matcher.h>
+#include <mp2p_icp/PointsView.h>
+#include <mp2p_icp/copyable_mutex.h>
 #include <mrpt/math/TPoint3D.h>
 
 #include <cstdlib>
 #include <limits>  // std::numeric_limits
+#include <map>
+#include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace mp2p_icp
 {
 /** Pointcloud matcher auxiliary class for iterating over point layers.
+ *
+ * Local layers may be either in `pointcloud_t::point_layers` or in
+ * `pointcloud_t::external_layers`, while global layers must be in
+ * `pointcloud_t::point_layers`, since they are searched with KD-trees.
  *
  * \ingroup mp2p_icp_grp
  */
@@ -31,8 +40,8 @@ class Matcher_Points_Base : public Matcher
     Matcher_Points_Base() = default;
 
     /** Weights for each potential Local->Global point layer matching.
-     * If empty, the output Pairings::point_weights
-     * will left empty (=all points have equal weight).
+     * If empty, the output Pairings::weights will be left empty (=all points
+     * have equal weight).
      * \note Note: this field can be loaded from a configuration file via
      * initializeLayerWeights().
      *
@@ -41,8 +50,14 @@ class Matcher_Points_Base : public Matcher
      */
     std::map<std::string, std::map<std::string, double>> weight_pt2pt_layers;
 
-    uint64_t maxLocalPointsPerLayer_ = 0;
-    uint64_t localPointsSampleSeed_  = 0;
+    uint64_t maxLocalPointsPerLayer_       = 0;
+    uint64_t localPointsSampleSeed_        = 0;
+    bool     mortonOrderLocalPoints_       = false;
+    double   localPointsVoxelSize_         = 0;
+    uint32_t maxLocalPointsPerVoxel_       = 1;
+    bool     localPointsReservoirSampling_ = false;
+    bool     cacheLocalPointsSample_       = false;
+    uint32_t maxLayerMatchingThreads_      = 0;
 
     /** Common parameters to all derived classes:
      *
@@ -56,6 +71,35 @@ class Matcher_Points_Base : public Matcher
      * time-based seed.
      *
      * - `pointLayerWeights`: Optional map of layer names to relative weights.
+     *
+     * - `mortonOrderLocalPoints`: If `true`, local points are sorted by the
+     * Z-order (Morton) code of their transformed coordinates before querying
+     * the KD-tree of the global map, so consecutive queries visit nearby
+     * tree nodes. Pairings are not affected. [Default=false]
+     *
+     * - `localPointsVoxelSize`: If >0, local points are decimated by keeping at
+     * most `maxLocalPointsPerVoxel` points per voxel of this size [meters], in
+     * one linear pass. If the result still has more than
+     * `maxLocalPointsPerLayer` points, it is uniformly decimated. [Default=0]
+     *
+     * - `maxLocalPointsPerVoxel`: See `localPointsVoxelSize`. [Default=1]
+     *
+     * - `localPointsReservoirSampling`: If `true`, and there is no voxel
+     * decimation, the random subset of `maxLocalPointsPerLayer` points is
+     * picked with reservoir sampling, which only allocates memory for the
+     * chosen points instead of for all local points. [Default=false]
+     *
+     * - `cacheLocalPointsSample`: If `true`, the subset of local points picked
+     * in the first ICP iteration is reused in all subsequent iterations of the
+     * same alignment, instead of drawing a new one. [Default=false]
+     *
+     * - `maxLayerMatchingThreads`: Maximum number of threads used to match
+     * different point layers in parallel. All local layers paired with the
+     * same global layer are matched by one thread, since KD-tree queries on
+     * one map are not thread-safe. `0` means as many as hardware threads, `1`
+     * matches all layers serially in the calling thread. Threads are taken
+     * from a pool created once, so clouds with a single layer pay nothing.
+     * [Default=0]
      */
     void initialize(const mrpt::containers::yaml& params) override;
 
@@ -66,21 +110,71 @@ class Matcher_Points_Base : public Matcher
         mrpt::math::TPoint3Df localMin{fMax, fMax, fMax};
         mrpt::math::TPoint3Df localMax{-fMax, -fMax, -fMax};
 
-        /** Reordering indexes, used only if we had to pick random indexes */
+        /** Reordering indexes, used only if we had to pick random indexes, or
+         * if points were sorted. If present, `(*idxs)[i]` is the index in the
+         * original local point cloud of the i-th transformed point. */
         std::optional<std::vector<std::size_t>> idxs;
 
-        /** Transformed local points: all, or a random subset */
+        /** Transformed local points: all, or a random subset, possibly
+         * reordered (see `idxs`) */
         mrpt::aligned_std_vector<float> x_locals, y_locals, z_locals;
 
        private:
         static constexpr auto fMax = std::numeric_limits<float>::max();
     };
 
+    static TransformedLocalPointCloud transform_local_to_global(
+        const PointsView&           pcLocal,
+        const mrpt::poses::CPose3D& localPose,
+        const std::size_t           maxLocalPoints        = 0,
+        const uint64_t              localPointsSampleSeed = 0,
+        const bool                  sortByMortonCode      = false);
+
+    /** Like the other overload, but transforms only the given subset of
+     * local point indices (or all points, if `sampleIdxs` is empty) */
+    static TransformedLocalPointCloud transform_local_to_global(
+        const PointsView&                       pcLocal,
+        const mrpt::poses::CPose3D&             localPose,
+        std::optional<std::vector<std::size_t>> sampleIdxs,
+        const bool                              sortByMortonCode = false);
+
     static TransformedLocalPointCloud transform_local_to_global(
         const mrpt::maps::CPointsMap& pcLocal,
         const mrpt::poses::CPose3D&   localPose,
         const std::size_t             maxLocalPoints        = 0,
-        const uint64_t                localPointsSampleSeed = 0);
+        const uint64_t                localPointsSampleSeed = 0,
+        const bool                    sortByMortonCode      = false)
+    {
+        return transform_local_to_global(
+            PointsView::FromPointsMap(pcLocal), localPose, maxLocalPoints,
+            localPointsSampleSeed, sortByMortonCode);
+    }
+
+    /** Parameters for sample_local_points(). See initialize() for the
+     * meaning of each field. */
+    struct LocalSamplingParameters
+    {
+        LocalSamplingParameters() = default;
+
+        uint64_t maxLocalPoints    = 0;
+        uint64_t seed              = 0;
+        double   voxelSize         = 0;
+        uint32_t maxPointsPerVoxel = 1;
+        bool     reservoir         = false;
+    };
+
+    /** Picks the subset of local points to match. Returns an empty optional
+     * if all points must be used.
+     */
+    static std::optional<std::vector<std::size_t>> sample_local_points(
+        const PointsView& pcLocal, const LocalSamplingParameters& p);
+
+    static std::optional<std::vector<std::size_t>> sample_local_points(
+        const mrpt::maps::CPointsMap&  pcLocal,
+        const LocalSamplingParameters& p)
+    {
+        return sample_local_points(PointsView::FromPointsMap(pcLocal), p);
+    }
 
    protected:
     void impl_match(
@@ -88,11 +182,71 @@ class Matcher_Points_Base : public Matcher
         const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
         Pairings& out) const override final;
 
+    /** Transforms the local points, applying the decimation, caching, and
+     * reordering options of this object. Meant to be used from within
+     * implMatchOneLayer() */
+    TransformedLocalPointCloud sampleAndTransformLocal(
+        const PointsView&           pcLocal,
+        const mrpt::poses::CPose3D& localPose) const;
+
    private:
+    /** Local point subsets kept across ICP iterations, if
+     * cacheLocalPointsSample_ is enabled. Key is the address of the `x`
+     * coordinates of the local layer. */
+    struct CachedSample
+    {
+        std::size_t                             nLocalPoints = 0;
+        std::optional<std::vector<std::size_t>> idxs;
+    };
+    mutable std::map<const float*, CachedSample> cachedLocalSamples_;
+    mutable copyable_mutex_t                     cachedLocalSamplesMtx_;
+
+    /** The (global,local) layer pairs to match, with layer names already
+     * resolved. Built in the first ICP iteration of each alignment, and
+     * reused in later iterations, so they do no name lookups nor allocations,
+     * as long as the layers of both point clouds are the same ones. */
+    struct LayerPairingPlan
+    {
+        const pointcloud_t* pcGlobal = nullptr;
+        const pointcloud_t* pcLocal  = nullptr;
+
+        /** Identity of each layer the plan was built from: the address of
+         * its name (the key in `point_layers` or `external_layers`), the
+         * address of its `x` coordinates, and its size. */
+        struct LayerId
+        {
+            const std::string* name = nullptr;
+            const float*       xs   = nullptr;
+            std::size_t        size = 0;
+        };
+        std::vector<LayerId> globalLayers, localLayers;
+
+        /** Whether the plan still applies to these point clouds: the same
+         * objects, with the same layers, buffers, and sizes. */
+        bool isValidFor(
+            const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal) const;
+
+        struct Task
+        {
+            const mrpt::maps::CPointsMap* glLayer = nullptr;
+            PointsView                    lcLayer;
+            std::optional<double>         weight;
+        };
+        std::vector<Task> tasks;
+
+        /** Indices of tasks sharing the same global layer */
+        std::vector<std::vector<std::size_t>> groups;
+    };
+    mutable std::shared_ptr<const LayerPairingPlan> plan_;
+    mutable copyable_mutex_t                        planMtx_;
+
+    std::shared_ptr<const LayerPairingPlan> buildLayerPairingPlan(
+        const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal) const;
+
     virtual void implMatchOneLayer(
-        const mrpt::maps::CPointsMap& pcGlobal,
-        const mrpt::maps::CPointsMap& pcLocal,
-        const mrpt::poses::CPose3D& localPose, Pairings& out) const = 0;
+        const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const = 0;
 };
 
 }  // namespace mp2p_icp
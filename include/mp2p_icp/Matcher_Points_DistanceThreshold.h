@@ -43,9 +43,9 @@ class Matcher_Points_DistanceThreshold : public Matcher_Points_Base
     double threshold = 0.50;
 
     void implMatchOneLayer(
-        const mrpt::maps::CPointsMap& pcGlobal,
-        const mrpt::maps::CPointsMap& pcLocal,
-        const mrpt::poses::CPose3D& localPose, Pairings& out) const override;
+        const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const override;
 };
 
 }  // namespace mp2p_icp
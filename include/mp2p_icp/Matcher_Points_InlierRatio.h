@@ -41,9 +41,9 @@ class Matcher_Points_InlierRatio : public Matcher_Points_Base
     double inliersRatio = 0.80;
 
     void implMatchOneLayer(
-        const mrpt::maps::CPointsMap& pcGlobal,
-        const mrpt::maps::CPointsMap& pcLocal,
-        const mrpt::poses::CPose3D& localPose, Pairings& out) const override;
+        const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+        const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+        Pairings& out) const override;
 };
 
 }  // namespace mp2p_icp
@@ -76,6 +76,58 @@ struct point_line_pair_t
 
 using TMatchedPointLineList = std::vector<point_line_pair_t>;
 
+/** Pairing for the symmetric point-to-plane objective: a global and a local
+ * point, each with the unit normal of the surface around it, so the error
+ * is measured along the sum of both normals. See error_point2plane_sym().
+ */
+struct point_plane_sym_pair_t
+{
+    /// \note "this"=global, "other"=local, while finding the transformation
+    /// local wrt global
+    mrpt::math::TPoint3Df  pt_this, pt_other;
+    mrpt::math::TVector3Df n_this, n_other;
+
+    point_plane_sym_pair_t() = default;
+    point_plane_sym_pair_t(
+        const mrpt::math::TPoint3Df&  p_this,
+        const mrpt::math::TVector3Df& nThis,
+        const mrpt::math::TPoint3Df&  p_other,
+        const mrpt::math::TVector3Df& nOther)
+        : pt_this(p_this), pt_other(p_other), n_this(nThis), n_other(nOther)
+    {
+    }
+};
+
+using TMatchedPointPlaneSymList = std::vector<point_plane_sym_pair_t>;
+
+/** *Individual* weights of pairings: one array per pairing type, each one
+ * either empty (all pairings of that type have weight 1) or with one entry
+ * per pairing, in the same order than the corresponding `Pairings::paired_*`
+ * container.
+ *
+ * Individual weights multiply the per-type weights in
+ * WeightParameters::pair_weights, so they can hold per-layer, robust or
+ * learned weights of each pairing.
+ */
+struct PairingWeights
+{
+    std::vector<double> pt2pt, pt2ln, pt2pl, ln2ln, pl2pl, pt2pl_sym;
+
+    bool empty() const
+    {
+        return pt2pt.empty() && pt2ln.empty() && pt2pl.empty() &&
+               ln2ln.empty() && pl2pl.empty() && pt2pl_sym.empty();
+    }
+};
+
+/** Weight of the i-th pairing given its array of individual weights `w` (see
+ * PairingWeights) and the weight of its type. */
+inline double pairing_weight(
+    const std::vector<double>& w, const std::size_t i, const double typeWeight)
+{
+    return w.empty() ? typeWeight : typeWeight * w[i];
+}
+
 /** Common pairing input data for OLAE, Horn's, and other solvers.
  * Planes and lines must have unit director and normal vectors, respectively.
  *
@@ -92,18 +144,16 @@ struct Pairings
     TMatchedPointPlaneList         paired_pt2pl;
     TMatchedLineList               paired_ln2ln;
     TMatchedPlaneList              paired_pl2pl;
+    TMatchedPointPlaneSymList      paired_pt2pl_sym;
 
-    /** *Individual* weights for paired_pt2pt: each entry specifies how many
-     * points have the given (mapped second value) weight, in the same order as
-     * stored in paired_pt2pt. If empty, all points will have equal weights.
-     */
-    std::vector<std::pair<std::size_t, double>> point_weights;
+    /** Optional *individual* weights of each pairing. See PairingWeights. */
+    PairingWeights weights;
 
     virtual bool empty() const
     {
         return paired_pt2pt.empty() && paired_pl2pl.empty() &&
                paired_ln2ln.empty() && paired_pt2ln.empty() &&
-               paired_pt2pl.empty();
+               paired_pt2pl.empty() && paired_pt2pl_sym.empty();
     }
 
     /** Overall number of element-to-element pairings (points, lines, planes) */
@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include <mp2p_icp/DOFMask.h>
 #include <mp2p_icp/WeightParameters.h>
+#include <mp2p_icp/select_informative_pairings.h>
 #include <mrpt/containers/yaml.h>
 #include <mrpt/core/bits_math.h>  // DEG2RAD()
 #include <mrpt/serialization/CSerializable.h>
@@ -53,6 +55,48 @@ struct Parameters : public mrpt::serialization::CSerializable
      * optimal pose estimation algorithms */
     WeightParameters pairingsWeightParameters;
 
+    /** Optional selection of the most informative pairings before running
+     * the solvers, at each ICP iteration. Disabled by default.
+     * \sa select_informative_pairings()
+     */
+    PairingsSelectionParameters pairingsSelection;
+
+    /** Maximum number of matchers to run concurrently at each ICP iteration.
+     * `0` means as many as hardware threads, `1` (the default) runs them
+     * serially.
+     * \sa ICP::run_matchers()
+     */
+    uint32_t maxParallelMatchers{1};
+
+    /** If >0, the outer ICP loop is accelerated with Anderson acceleration,
+     * extrapolating the next pose guess from this number of past iterates
+     * (typically 3-6). Extrapolated poses that increase the mean squared
+     * error of the pairings are discarded, falling back to the plain ICP
+     * iterate. `0` (default) disables it.
+     */
+    uint32_t andersonHistory{0};
+
+    /** Degrees of freedom to estimate. All of them by default. Fixed ones
+     * keep the values of the initial guess.
+     * \sa DOFMask::Planar(), DOFMask::XYZYaw()
+     */
+    DOFMask dofMask;
+
+    /** If true (default), when both point clouds lie on the z=0 plane (e.g.
+     * 2D laser scans) and the initial guess is an SE(2) pose, ICP switches
+     * to SE(2) mode: 2D nearest neighbors, 3-DOF solvers, and a planar
+     * result. See Results::optimal_tf_2d().
+     */
+    bool autoSE2Mode{true};
+
+    /** If true, the pairings of each ICP iteration are converted once into a
+     * CompactPairings before running the solvers, so iterative solvers
+     * (Solver_GaussNewton, Solver_LevenbergMarquardt) stream compact
+     * coordinate arrays at each of their inner iterations. Other solvers get
+     * the equivalent Pairings. Default: false.
+     */
+    bool compactPairings{false};
+
     void load_from(const mrpt::containers::yaml& p);
     void save_to(mrpt::containers::yaml& p) const;
 };
@@ -0,0 +1,59 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   PointNormals.h
+ * @brief  Per-point normals and local surface shape of a point layer
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mrpt/serialization/CSerializable.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** Per-point attributes of a point layer, from the eigen-decomposition of
+ * the covariance of the neighbors of each point, with eigenvalues
+ * e0 <= e1 <= e2. All vectors have one entry per point of the layer.
+ *
+ * Computed with estimate_normals(), and stored in
+ * pointcloud_t::layer_normals.
+ */
+class PointNormals : public mrpt::serialization::CSerializable
+{
+    DEFINE_SERIALIZABLE(PointNormals, mp2p_icp)
+
+   public:
+    PointNormals() = default;
+
+    /** Unit normal: the eigenvector of e0. Its sign is arbitrary. */
+    std::vector<float> nx, ny, nz;
+
+    /** Surface variation: e0/(e0+e1+e2) */
+    std::vector<float> curvature;
+
+    /** Eigenvalue ratios e0/e2 (small for planar neighborhoods) and e1/e2
+     * (small for linear neighborhoods) */
+    std::vector<float> ratio02, ratio12;
+
+    /** 0 for points with less than 3 neighbors, or with all of them at the
+     * same position, whose other attributes are all 0. */
+    std::vector<uint8_t> valid;
+
+    std::size_t size() const { return valid.size(); }
+    void        resize(const std::size_t n);
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
@@ -0,0 +1,110 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   PointsView.h
+ * @brief  Non-owning view of points in external buffers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mrpt/maps/CPointsMap.h>
+
+#include <cstddef>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** Read-only, non-owning view of the 3D points in buffers owned by the
+ * caller: either separate `x`, `y`, `z` arrays, or one interleaved array
+ * (e.g. `x,y,z,intensity,x,y,z,intensity...`), with a given stride between
+ * consecutive points.
+ *
+ * Building a view copies nothing, so the buffers must outlive it, and must
+ * not be modified while in use by any algorithm.
+ *
+ * \sa pointcloud_t::external_layers
+ */
+class PointsView
+{
+   public:
+    PointsView() = default;
+
+    /** View of separate coordinate arrays, with the i-th point at
+     * `xs[i*stride]`, `ys[i*stride]`, `zs[i*stride]`. */
+    static PointsView FromArrays(
+        const float* xs, const float* ys, const float* zs, const std::size_t n,
+        const std::size_t stride = 1)
+    {
+        PointsView v;
+        v.xs_     = xs;
+        v.ys_     = ys;
+        v.zs_     = zs;
+        v.size_   = n;
+        v.stride_ = stride;
+        return v;
+    }
+
+    /** View of an interleaved array, with the i-th point at
+     * `xyz[i*stride + {0,1,2}]`. */
+    static PointsView FromInterleaved(
+        const float* xyz, const std::size_t n, const std::size_t stride = 3)
+    {
+        return FromArrays(xyz, xyz + 1, xyz + 2, n, stride);
+    }
+
+    /** View of the points in a points map, which must outlive the view. */
+    static PointsView FromPointsMap(const mrpt::maps::CPointsMap& pts)
+    {
+        PointsView v = FromArrays(
+            pts.getPointsBufferRef_x().data(),
+            pts.getPointsBufferRef_y().data(),
+            pts.getPointsBufferRef_z().data(), pts.size());
+        v.map_ = &pts;
+        return v;
+    }
+
+    std::size_t size() const { return size_; }
+    bool        empty() const { return size_ == 0; }
+
+    /** Distance between consecutive points, in number of floats. */
+    std::size_t stride() const { return stride_; }
+
+    /** Whether each coordinate is a contiguous array (stride=1). */
+    bool contiguous() const { return stride_ == 1; }
+
+    float x(const std::size_t i) const { return xs_[i * stride_]; }
+    float y(const std::size_t i) const { return ys_[i * stride_]; }
+    float z(const std::size_t i) const { return zs_[i * stride_]; }
+
+    /** Pointers to the first point coordinates. */
+    const float* xs() const { return xs_; }
+    const float* ys() const { return ys_; }
+    const float* zs() const { return zs_; }
+
+    /** The points map this view was built from with FromPointsMap(), or
+     * nullptr for views of external buffers. */
+    const mrpt::maps::CPointsMap* pointsMap() const { return map_; }
+
+    /** Copies the points into a new map, e.g. for algorithms that need a
+     * KD-tree. */
+    mrpt::maps::CPointsMap::Ptr toPointsMap() const;
+
+   private:
+    const float*                  xs_     = nullptr;
+    const float*                  ys_     = nullptr;
+    const float*                  zs_     = nullptr;
+    std::size_t                   size_   = 0;
+    std::size_t                   stride_ = 1;
+    const mrpt::maps::CPointsMap* map_    = nullptr;
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
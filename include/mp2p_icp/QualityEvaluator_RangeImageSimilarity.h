@@ -72,10 +72,18 @@ class QualityEvaluator_RangeImageSimilarity : public QualityEvaluator
     bool debug_save_all_matrices  = false;
 
     mrpt::math::CMatrixDouble projectPoints(
-        const mrpt::maps::CPointsMap&              pts,
+        const PointsView&                          pts,
         const std::optional<mrpt::poses::CPose3D>& relativePose =
             std::nullopt) const;
 
+    mrpt::math::CMatrixDouble projectPoints(
+        const mrpt::maps::CPointsMap&              pts,
+        const std::optional<mrpt::poses::CPose3D>& relativePose =
+            std::nullopt) const
+    {
+        return projectPoints(PointsView::FromPointsMap(pts), relativePose);
+    }
+
     std::vector<double> scores(
         const mrpt::math::CMatrixDouble& m1,
         const mrpt::math::CMatrixDouble& m2) const;
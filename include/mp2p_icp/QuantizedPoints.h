@@ -0,0 +1,108 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   QuantizedPoints.h
+ * @brief  Compressed point storage, quantized relative to tile origins
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/PointsView.h>
+#include <mrpt/maps/CPointsMap.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/serialization/CSerializable.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** Compressed storage of 3D points, for large maps: each coordinate is
+ * quantized with a fixed `resolution` and stored as a 16-bit offset from the
+ * origin of its tile, where tiles are cubes of 65536 resolution steps per
+ * side (65.5 m for the default 1 mm). That is 6 bytes per point, instead of
+ * the 12 bytes of a `CPointsMap`.
+ *
+ * Points are grouped by tile, so their order is not preserved.
+ *
+ * This is a storage and I/O format only, to keep and serialize large maps in
+ * less memory. It saves no memory while matching: neighbor searches need a
+ * KD-tree, which is built on a `CPointsMap`, so a layer must be decoded with
+ * toPointsMap() before it is used in an alignment, and the decoded copy has
+ * the full size. Decoding is a branch-free loop over each tile, which the
+ * compiler vectorizes.
+ *
+ * \sa pointcloud_t::quantized_layers
+ */
+class QuantizedPoints : public mrpt::serialization::CSerializable
+{
+    DEFINE_SERIALIZABLE(QuantizedPoints, mp2p_icp)
+
+   public:
+    QuantizedPoints() = default;
+    explicit QuantizedPoints(const double resolution);
+
+    /** Quantization step [meters] */
+    double resolution() const { return resolution_; }
+
+    std::size_t size() const { return nPoints_; }
+    bool        empty() const { return nPoints_ == 0; }
+    void        clear();
+
+    /** Approximate memory used by the points, in bytes */
+    std::size_t memoryUsage() const;
+
+    /** Quantizes and appends the given points, optionally transformed by
+     * `pose` first. */
+    void insertPoints(
+        const PointsView&                          pts,
+        const std::optional<mrpt::poses::CPose3D>& pose = std::nullopt);
+
+    /** Appends all points of another quantized cloud, optionally
+     * transformed by `pose` first. */
+    void insertPoints(
+        const QuantizedPoints&                     other,
+        const std::optional<mrpt::poses::CPose3D>& pose = std::nullopt);
+
+    /** Decodes all points into the given arrays, of size() elements each. */
+    void decode(float* xs, float* ys, float* zs) const;
+
+    /** Decodes all points into a new points map. */
+    mrpt::maps::CPointsMap::Ptr toPointsMap() const;
+
+    /** Whether all points have |z| <= zTolerance. Only the z offsets are
+     * read, and tiles are checked one by one, stopping at the first one out
+     * of tolerance. \sa pointcloud_t::isPlanar() */
+    bool isPlanar(const double zTolerance) const;
+
+   private:
+    struct Tile
+    {
+        std::array<int64_t, 3> index{0, 0, 0};
+        std::vector<int16_t>   dx, dy, dz;
+    };
+
+    double            resolution_ = 0.001;
+    std::size_t       nPoints_    = 0;
+    std::vector<Tile> tiles_;
+
+    /** Tile index to position in tiles_. Not serialized, rebuilt on load */
+    std::map<std::array<int64_t, 3>, std::size_t> tileLookup_;
+
+    Tile& tileFor(const std::array<int64_t, 3>& index);
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
@@ -7,6 +7,7 @@
 
 #include <mp2p_icp/Pairings.h>
 #include <mrpt/poses/CPose3DPDFGaussian.h>
+#include <mrpt/poses/CPosePDFGaussian.h>
 
 #include <cstdint>
 
@@ -38,6 +39,24 @@ struct Results
 
     /** A copy of the pairings found in the last ICP iteration. */
     Pairings finalPairings;
+
+    /** true if the alignment ran in SE(2) mode (see
+     * Parameters::autoSE2Mode) */
+    bool se2Mode = false;
+
+    /** The optimal transformation as an SE(2) pose, with the covariance of
+     * (x,y,yaw). Only meaningful for planar alignments, see `se2Mode`. */
+    mrpt::poses::CPosePDFGaussian optimal_tf_2d() const
+    {
+        mrpt::poses::CPosePDFGaussian ret;
+        ret.mean = mrpt::poses::CPose2D(optimal_tf.mean);
+
+        const int idxs[3] = {0, 1, 3};  // x, y, yaw
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                ret.cov(r, c) = optimal_tf.cov(idxs[r], idxs[c]);
+        return ret;
+    }
 };
 /** @} */
 
@@ -0,0 +1,91 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   SharedPointCloud.h
+ * @brief  A global map shared between a writer thread and ICP readers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** A global map read by localization threads while a mapping thread keeps
+ * extending it, following a read-copy-update scheme:
+ *
+ * - Readers call snapshot() to pin the current version, and use its `map`
+ * as the global point cloud in ICP::align() for as long as they hold it.
+ * Snapshots are never modified once published, and their KD-trees and
+ * bounding boxes are computed before publishing, so readers never trigger
+ * the lazily-built caches of `CPointsMap`. Taking a snapshot takes no lock.
+ * - Writers call update() or publish() to build the next version aside,
+ * which is swapped in atomically. Writers are serialized among them, but
+ * never wait for readers.
+ *
+ * Old versions are freed when the last reader releases them.
+ */
+class SharedPointCloud
+{
+   public:
+    /** One immutable version of the map */
+    struct Snapshot
+    {
+        Snapshot() = default;
+
+        uint64_t     version = 0;
+        pointcloud_t map;
+    };
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    /** Starts with an empty map, as version 0 */
+    SharedPointCloud();
+
+    /** Starts with the given map, as version 0 */
+    explicit SharedPointCloud(pointcloud_t initialMap);
+
+    /** Returns the latest published version. Thread-safe and lock-free. */
+    SnapshotPtr snapshot() const;
+
+    /** Builds the next version by applying `updateFn` to a copy of the
+     * latest one, e.g. to merge a new scan with pointcloud_t::mergeWith().
+     * The copy shares its layers with the published version, so `updateFn`
+     * must modify layers only through pointcloud_t::mergeWith() or
+     * pointcloud_t::mutableLayer(), which copy a shared layer first. Only
+     * the modified layers are copied.
+     * \return The new version number.
+     */
+    uint64_t update(const std::function<void(pointcloud_t&)>& updateFn);
+
+    /** Publishes a map built by the caller as the next version. The caller
+     * must not modify it nor its layers afterwards.
+     * \return The new version number.
+     */
+    uint64_t publish(pointcloud_t newMap);
+
+   private:
+    /** Accessed only with std::atomic_load() / std::atomic_store() */
+    std::shared_ptr<const Snapshot> current_;
+
+    /** Serializes writers */
+    std::mutex writerMtx_;
+
+    uint64_t publishLocked(pointcloud_t&& newMap);
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
@@ -0,0 +1,119 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   SlidingWindowMap.h
+ * @brief  Incremental local map around the latest pose, for odometry
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/poses/CPose3D.h>
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** A local map for scan-to-map odometry, updated incrementally with each
+ * registered scan instead of being rebuilt from all past scans.
+ *
+ * Each point layer of an inserted scan goes into the map layer of the same
+ * name, keeping at most one point per voxel of `voxelSize`: a voxel hash
+ * maps each occupied voxel to its point, so inserting a scan costs
+ * O(scan size). Points farther than `radius` from the latest scan pose are
+ * evicted.
+ *
+ * Use asPointCloud() as the global map in ICP::align(). Its KD-trees are
+ * rebuilt by MRPT on the first query after each change, so insertScan() keeps
+ * new points pending, already deduplicated, until they are a fraction
+ * `maxPendingRatio` of the map, or until the next eviction. asPointCloud()
+ * adds any pending point before returning the map, so matching always sees
+ * all inserted points, and several scans inserted between two queries cost
+ * a single rebuild.
+ */
+class SlidingWindowMap
+{
+   public:
+    SlidingWindowMap() = default;
+
+    /** Voxel size for deduplication [meters]. Must be >0. */
+    double voxelSize = 0.2;
+
+    /** Points farther than this from the latest scan pose are evicted
+     * [meters]. */
+    double radius = 50.0;
+
+    /** Eviction requires visiting all points, so it is only done once the
+     * scan pose has moved this far since the last eviction [meters].
+     * `0` means after every insertion. */
+    double evictionCheckDistance = 1.0;
+
+    /** insertScan() adds new points to the map, which forces a rebuild of
+     * its KD-trees, once there are more than this ratio times the points
+     * already in it. `0` means after every insertion. asPointCloud() adds
+     * them anyway. */
+    double maxPendingRatio = 0.1;
+
+    /** Loads `voxelSize`, `radius`, `evictionCheckDistance` and
+     * `maxPendingRatio`, all optional. */
+    void initialize(const mrpt::containers::yaml& params);
+
+    /** Inserts all point layers of `scan`, transformed by `scanPose` (the
+     * registered pose of the scan in the map frame), then evicts points far
+     * from `scanPose` if applicable. Other primitives are ignored. */
+    void insertScan(
+        const pointcloud_t& scan, const mrpt::poses::CPose3D& scanPose);
+
+    /** The map, with one `CSimplePointsMap` layer per inserted layer name.
+     * Adds all pending points first, see flush(). */
+    const pointcloud_t& asPointCloud();
+
+    /** Overall number of points in the map, pending ones excluded */
+    std::size_t size() const { return map_.size(); }
+
+    /** Number of inserted points not yet in the map */
+    std::size_t pendingSize() const { return nPending_; }
+
+    /** Adds all pending points to the map */
+    void flush();
+
+    void clear();
+
+   private:
+    pointcloud_t map_;
+
+    struct LayerIndex
+    {
+        /** Voxel key to the index of its point in the layer, where pending
+         * points follow those already in the layer */
+        std::unordered_map<uint64_t, uint32_t> voxels;
+        /** Voxel key of each point, to update `voxels` when points move */
+        std::vector<uint64_t> keys;
+        /** Pending points */
+        std::vector<float> pendingX, pendingY, pendingZ;
+    };
+    std::map<std::string, LayerIndex> index_;
+    std::size_t                       nPending_ = 0;
+
+    std::optional<mrpt::math::TPoint3D> lastEvictionCenter_;
+
+    void evict(const mrpt::math::TPoint3D& center);
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
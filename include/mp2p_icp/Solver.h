@@ -11,6 +11,8 @@
  */
 #pragma once
 
+#include <mp2p_icp/CompactPairings.h>
+#include <mp2p_icp/DOFMask.h>
 #include <mp2p_icp/OptimalTF_Result.h>
 #include <mp2p_icp/Pairings.h>
 #include <mp2p_icp/WeightParameters.h>
@@ -33,6 +35,15 @@ struct SolverContext
 
     std::optional<uint32_t>             icpIteration;
     std::optional<mrpt::poses::CPose3D> guessRelativePose;
+
+    /** Degrees of freedom to estimate. Solvers that cannot restrict their
+     * search to them get their solution projected, keeping the fixed DOFs
+     * from `guessRelativePose` (or zero, if there is no guess). */
+    DOFMask dofMask;
+
+    /** true if both point clouds lie on the z=0 plane and the relative pose
+     * is an SE(2) one. Solvers may then use 3-DOF specializations. */
+    bool se2 = false;
 };
 
 /** Virtual base class for optimal alignment solvers (one step in ICP).
@@ -56,11 +67,20 @@ class Solver : public mrpt::system::COutputLogger, public mrpt::rtti::CObject
      *
      * \return true if the method was actually invoked (due to the filter in
      * runFromIteration and runUpToIteration) and valid solution was found.
+     *
+     * \note The solution always respects `sc.dofMask`.
      */
     virtual bool optimal_pose(
         const Pairings& pairings, OptimalTF_Result& out,
         const WeightParameters& wp, const SolverContext& sc) const;
 
+    /** \overload For pairings in compact form. Solvers which do not
+     * override impl_optimal_pose_compact() work on
+     * CompactPairings::asPairings(). */
+    bool optimal_pose(
+        const CompactPairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const;
+
     uint32_t runFromIteration = 0;
     uint32_t runUpToIteration = 0;  //!< 0: no limit
 
@@ -68,6 +88,18 @@ class Solver : public mrpt::system::COutputLogger, public mrpt::rtti::CObject
     virtual bool impl_optimal_pose(
         const Pairings& pairings, OptimalTF_Result& out,
         const WeightParameters& wp, const SolverContext& sc) const = 0;
+
+    /** Like impl_optimal_pose(), for pairings in compact form. By default,
+     * calls impl_optimal_pose() with CompactPairings::asPairings(). */
+    virtual bool impl_optimal_pose_compact(
+        const CompactPairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const;
+
+   private:
+    template <class PAIRINGS>
+    bool solve(
+        const PAIRINGS& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const;
 };
 
 }  // namespace mp2p_icp
@@ -12,6 +12,7 @@
 #pragma once
 
 #include <mp2p_icp/Solver.h>
+#include <mp2p_icp/robust_kernels.h>
 
 namespace mp2p_icp
 {
@@ -27,6 +28,12 @@ class Solver_GaussNewton : public Solver
    public:
     uint32_t maxIterations = 5;
 
+    /** Optional robust kernel, applied via IRLS. In YAML, set `robustKernel`
+     * to one of: `None` (default), `Huber`, `Cauchy`, `Tukey`,
+     * `GemanMcClure`, and its parameter `robustKernelParam` [meters]. */
+    RobustKernel robustKernel      = RobustKernel::None;
+    double       robustKernelParam = 0.10;
+
     void initialize(const mrpt::containers::yaml& params) override;
 
    protected:
@@ -34,6 +41,11 @@ class Solver_GaussNewton : public Solver
     bool impl_optimal_pose(
         const Pairings& pairings, OptimalTF_Result& out,
         const WeightParameters& wp, const SolverContext& sc) const override;
+
+    // Works directly on the compact arrays:
+    bool impl_optimal_pose_compact(
+        const CompactPairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const override;
 };
 
 }  // namespace mp2p_icp
@@ -0,0 +1,63 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_LevenbergMarquardt.h
+ * @brief  ICP registration for points and planes
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Solver.h>
+#include <mp2p_icp/robust_kernels.h>
+
+namespace mp2p_icp
+{
+/** ICP registration for points, planes, and lines, using an iterative
+ * Levenberg-Marquardt numerical solver with adaptive damping.
+ *
+ * Compared to Solver_GaussNewton, steps that do not decrease the cost are
+ * rejected, which avoids oscillations near degeneracies or with poor initial
+ * guesses.
+ *
+ * Parameters (all optional):
+ * - `maxIterations`: Max. number of (accepted or rejected) steps.
+ * - `minDelta`: Minimum SE(3) step norm to keep iterating.
+ * - `initialLambdaFactor`: Initial damping, relative to the largest diagonal
+ * entry of the approximate Hessian.
+ * - `robustKernel`: `None` (default), `Huber`, `Cauchy`, `Tukey`, or
+ * `GemanMcClure`, applied via IRLS.
+ * - `robustKernelParam`: The parameter of the robust kernel [meters].
+ *
+ * \ingroup mp2p_icp_grp
+ */
+class Solver_LevenbergMarquardt : public Solver
+{
+    DEFINE_MRPT_OBJECT(Solver_LevenbergMarquardt, mp2p_icp)
+
+   public:
+    uint32_t maxIterations       = 20;
+    double   minDelta            = 1e-7;
+    double   initialLambdaFactor = 1e-3;
+
+    RobustKernel robustKernel      = RobustKernel::None;
+    double       robustKernelParam = 0.10;
+
+    void initialize(const mrpt::containers::yaml& params) override;
+
+   protected:
+    // See base class docs
+    bool impl_optimal_pose(
+        const Pairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const override;
+
+    // Works directly on the compact arrays:
+    bool impl_optimal_pose_compact(
+        const CompactPairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const override;
+};
+
+}  // namespace mp2p_icp
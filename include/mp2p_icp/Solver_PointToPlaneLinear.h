@@ -0,0 +1,40 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_PointToPlaneLinear.h
+ * @brief  ICP registration for points and planes
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Solver.h>
+
+namespace mp2p_icp
+{
+/** ICP registration for point-to-plane (and point-to-point) pairings, using
+ * the closed-form small-angle linearization in
+ * optimal_tf_point2plane_linear().
+ *
+ * Each call solves one 6x6 linear system, with no inner iterations, which
+ * makes it well suited for the first, coarse ICP iterations. Use
+ * `runUpToIteration` to hand off to an iterative solver (e.g.
+ * Solver_GaussNewton, with `runFromIteration`) for the final ones.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+class Solver_PointToPlaneLinear : public Solver
+{
+    DEFINE_MRPT_OBJECT(Solver_PointToPlaneLinear, mp2p_icp)
+
+   protected:
+    // See base class docs
+    bool impl_optimal_pose(
+        const Pairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const override;
+};
+
+}  // namespace mp2p_icp
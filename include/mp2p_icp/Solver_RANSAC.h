@@ -0,0 +1,68 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_RANSAC.h
+ * @brief  Robust solver from minimal samples of point-to-point pairings
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Solver.h>
+
+namespace mp2p_icp
+{
+/** Robust solver for point-to-point pairings with a large ratio of outliers,
+ * e.g. with a poor initial guess.
+ *
+ * Hypotheses are built from random minimal samples of 3 pairings of
+ * `Pairings::paired_pt2pt`, solved with optimal_tf_horn(), and scored by
+ * their number of inliers (pairings with a residual below
+ * `inlierThreshold`). Hypotheses are scored in parallel, and the required
+ * number of hypotheses is adapted from the best inlier ratio so far, for the
+ * desired `confidence`. The result only depends on `randomSeed`, not on the
+ * number of threads.
+ *
+ * The best hypothesis is then refined with optimal_tf_horn() on its inliers
+ * (plus all line and plane pairings, if any), and the remaining
+ * point-to-point pairings are reported in `OptimalTF_Result::outliers`.
+ *
+ * Parameters (all optional):
+ * - `inlierThreshold`: Max. residual of inliers [meters]. [Default=0.10]
+ * - `confidence`: Probability of drawing at least one outlier-free sample,
+ * used for adaptive termination. [Default=0.99]
+ * - `maxHypotheses`: Max. number of hypotheses. [Default=1000]
+ * - `refineIterations`: Number of refinement steps on the inliers.
+ * [Default=2]
+ * - `maxThreads`: Max. number of threads to score hypotheses. `0` means as
+ * many as hardware threads. [Default=0]
+ * - `randomSeed`: Seed of the RNG for samples. `0` means to use a time-based
+ * seed. [Default=0]
+ *
+ * \ingroup mp2p_icp_grp
+ */
+class Solver_RANSAC : public Solver
+{
+    DEFINE_MRPT_OBJECT(Solver_RANSAC, mp2p_icp)
+
+   public:
+    double   inlierThreshold  = 0.10;
+    double   confidence       = 0.99;
+    uint32_t maxHypotheses    = 1000;
+    uint32_t refineIterations = 2;
+    uint32_t maxThreads       = 0;
+    uint64_t randomSeed       = 0;
+
+    void initialize(const mrpt::containers::yaml& params) override;
+
+   protected:
+    // See base class docs
+    bool impl_optimal_pose(
+        const Pairings& pairings, OptimalTF_Result& out,
+        const WeightParameters& wp, const SolverContext& sc) const override;
+};
+
+}  // namespace mp2p_icp
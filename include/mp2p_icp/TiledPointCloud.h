@@ -0,0 +1,157 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   TiledPointCloud.h
+ * @brief  Out-of-core global map, split in tiles loaded on demand
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/math/TPoint3D.h>
+#include <mrpt/poses/CPose3D.h>
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{
+ */
+
+/** Splits a point cloud into cubic tiles of `tileSize` meters per side, and
+ * saves them into `directory` (which must exist): one file per non-empty
+ * tile, in the format of save_columnar(), plus an index file. The result is
+ * opened with TiledPointCloud.
+ *
+ * Points are assigned to the tile containing them, planes to the tile
+ * containing their centroid, and lines to the tile containing their base
+ * point. Points within each tile are sorted with reorder_layers_morton().
+ *
+ * \exception std::exception On any I/O error.
+ */
+void save_tiled(
+    const pointcloud_t& pc, const std::string& directory,
+    const double tileSize);
+
+/** A global map too large to be kept in memory, saved with save_tiled().
+ *
+ * Tiles are loaded on demand into an LRU cache of up to `maxCachedTiles`
+ * tiles. mapAround() and mapFor() return a regular pointcloud_t with the
+ * tiles overlapping a region, to be used as the global map in
+ * ICP::align(). Since assembling it means copying the tiles and building
+ * new KD-trees, it covers half a tile more than requested on each side, and
+ * is reused while requested regions stay within it. Layers found in a
+ * single tile are shared with it, and keep its KD-tree. Both tiles and maps
+ * are returned with their KD-trees and bounding boxes already built, so they
+ * can be used by several threads at once.
+ *
+ * prefetch() loads tiles in a background thread, e.g. those along the
+ * predicted trajectory of the vehicle, so they are ready when requested.
+ *
+ * All methods are thread-safe.
+ */
+class TiledPointCloud
+{
+   public:
+    using TileIndex = std::array<int32_t, 3>;
+
+    /** Opens the index file in the given directory.
+     * \exception std::exception If it is missing or invalid.
+     */
+    explicit TiledPointCloud(
+        const std::string& directory, const std::size_t maxCachedTiles = 64);
+
+    /** Waits for pending prefetches */
+    ~TiledPointCloud();
+
+    TiledPointCloud(const TiledPointCloud&) = delete;
+    TiledPointCloud& operator=(const TiledPointCloud&) = delete;
+
+    double tileSize() const { return tileSize_; }
+
+    /** All (non-empty) tiles in the map */
+    const std::set<TileIndex>& tiles() const { return tiles_; }
+
+    /** Index of the tile containing a point */
+    TileIndex tileOf(const mrpt::math::TPoint3D& p) const;
+
+    /** Returns one tile, loading it if it is not in the cache, or nullptr if
+     * there is no such tile. */
+    std::shared_ptr<const pointcloud_t> tile(const TileIndex& idx);
+
+    /** Returns the contents of (at least) all tiles overlapping the box
+     * [bbMin,bbMax], enlarged by `margin` meters on each side. */
+    std::shared_ptr<const pointcloud_t> mapAround(
+        const mrpt::math::TPoint3D& bbMin, const mrpt::math::TPoint3D& bbMax,
+        const double margin = 0);
+
+    /** Like mapAround(), for the bounding box of the local point cloud
+     * transformed with `localPose` (e.g. the initial guess of ICP). */
+    std::shared_ptr<const pointcloud_t> mapFor(
+        const pointcloud_t& pcLocal, const mrpt::poses::CPose3D& localPose,
+        const double margin = 0);
+
+    /** Starts loading, in a background thread, the tiles that mapFor() would
+     * use for each of the given predicted poses of the local point cloud.
+     * Returns immediately. */
+    void prefetch(
+        const pointcloud_t&                      pcLocal,
+        const std::vector<mrpt::poses::CPose3D>& predictedPoses,
+        const double                             margin = 0);
+
+    /** Number of tiles currently in the cache, including those being
+     * loaded. */
+    std::size_t cachedTileCount() const;
+
+   private:
+    std::string         directory_;
+    double              tileSize_       = 0;
+    std::size_t         maxCachedTiles_ = 0;
+    std::set<TileIndex> tiles_;
+
+    /** LRU cache: `lru_` holds tile indices, most recently used first.
+     * Entries are futures so a tile being loaded by one thread is waited for
+     * by others instead of loaded twice. */
+    struct CacheEntry
+    {
+        std::shared_future<std::shared_ptr<const pointcloud_t>> tile;
+        std::list<TileIndex>::iterator                          lruIt;
+
+        /** Unique per load, to tell apart loads of the same tile */
+        uint64_t loadId = 0;
+    };
+    std::map<TileIndex, CacheEntry> cache_;
+    std::list<TileIndex>            lru_;
+    uint64_t                        nextLoadId_ = 0;
+    mutable std::mutex              cacheMtx_;
+
+    /** The last assembled map, and the tiles it was made of */
+    std::vector<TileIndex>              lastMapTiles_;
+    std::shared_ptr<const pointcloud_t> lastMap_;
+    std::mutex                          lastMapMtx_;
+
+    std::vector<std::future<void>> prefetches_;
+    std::mutex                     prefetchesMtx_;
+
+    std::vector<TileIndex> tilesInBox(
+        const mrpt::math::TPoint3D& bbMin, const mrpt::math::TPoint3D& bbMax,
+        const double margin) const;
+};
+
+/** @} */
+
+}  // namespace mp2p_icp
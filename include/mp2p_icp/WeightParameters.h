@@ -47,7 +47,7 @@ struct WeightParameters : public mrpt::serialization::CSerializable
     struct PairWeights
     {
         /** Weight of point-to-point pairs. Note that finer control of weights
-         * can be achieved with `Pairings::point_weights`. */
+         * can be achieved with `Pairings::weights`. */
         double pt2pt = 1.0;
         double pt2ln = 1.0;  //!< Weight of point-to-line pairs
         double pt2pl = 1.0;  //!< Weight of point-to-plane pairs
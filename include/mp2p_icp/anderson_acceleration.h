@@ -0,0 +1,58 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   anderson_acceleration.h
+ * @brief  Anderson acceleration of fixed-point iterations in R^6
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+
+namespace mp2p_icp
+{
+/** Anderson acceleration (type II) of a fixed-point iteration
+ * \f$ u_{k+1} = G(u_k) \f$ in \f$ \mathbb{R}^6 \f$, e.g. the Lie algebra of
+ * SE(3) poses in the ICP outer loop (Pavlov et al., 2018).
+ *
+ * The next iterate is the combination of the last `historyLength`+1 values
+ * of \f$ G \f$ that minimizes the norm of the combined residual
+ * \f$ f_k = G(u_k) - u_k \f$.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+class AndersonAcceleration
+{
+   public:
+    using vector6_t = Eigen::Matrix<double, 6, 1>;
+
+    explicit AndersonAcceleration(const std::size_t historyLength)
+        : m_(historyLength)
+    {
+    }
+
+    /** Forgets all past iterates: the next call to compute() returns `g`.
+     * Must be called if the sequence of iterates is broken, e.g. when an
+     * extrapolated iterate is rejected. */
+    void reset();
+
+    /** Given the current iterate `u` and the result of the plain fixed-point
+     * step from it, `g=G(u)`, returns the accelerated next iterate.
+     */
+    vector6_t compute(const vector6_t& u, const vector6_t& g);
+
+   private:
+    std::size_t              m_;
+    std::deque<vector6_t>    dG_, dF_;
+    std::optional<vector6_t> prevG_, prevF_;
+};
+
+}  // namespace mp2p_icp
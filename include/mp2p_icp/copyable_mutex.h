@@ -0,0 +1,36 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   copyable_mutex.h
+ * @brief  A std::mutex that can be a member of copyable classes.
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mutex>
+
+namespace mp2p_icp
+{
+/** A std::mutex wrapper with "copy" operations that create a new, unlocked
+ * mutex. Useful to protect mutable caches inside classes that must remain
+ * copyable, e.g. via `mrpt::rtti::CObject::clone()`.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+struct copyable_mutex_t
+{
+    copyable_mutex_t() = default;
+    copyable_mutex_t(const copyable_mutex_t&) {}
+    copyable_mutex_t& operator=(const copyable_mutex_t&) { return *this; }
+
+    void lock() { mtx.lock(); }
+    void unlock() { mtx.unlock(); }
+
+    std::mutex mtx;
+};
+
+}  // namespace mp2p_icp
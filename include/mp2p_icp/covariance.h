@@ -11,6 +11,7 @@
  */
 #pragma once
 
+#include <mp2p_icp/DOFMask.h>
 #include <mp2p_icp/Pairings.h>
 
 namespace mp2p_icp
@@ -20,9 +21,14 @@ struct CovarianceParameters
     // Finite difference deltas:
     double finDif_xyz    = 1e-7;
     double finDif_angles = 1e-7;
+
+    /** Only the free DOFs are estimated. Rows and columns of fixed ones are
+     * left as zeros in the output covariance. */
+    DOFMask dofMask;
 };
 
 /** Covariance estimation methods for an ICP result.
+ * The output is the covariance of (x,y,z,yaw,pitch,roll).
  *
  * \ingroup mp2p_icp_grp
  */
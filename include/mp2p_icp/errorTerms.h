@@ -43,6 +43,18 @@ mrpt::math::CVectorFixedDouble<1> error_point2plane(
     mrpt::optional_ref<mrpt::math::CMatrixFixed<double, 1, 12>> jacobian =
         std::nullopt);
 
+/** Symmetric point-to-plane error: the distance between both points along
+ * the sum of their normals, \f$ (R p + t - q)^\top (R n_p + n_q) \f$, with
+ * `p`, `n_p` the local point and normal, and `q`, `n_q` the global ones.
+ * Normals are expected to be unit vectors consistently oriented, see
+ * Matcher_Point2PlaneSymmetric.
+ */
+mrpt::math::CVectorFixedDouble<1> error_point2plane_sym(
+    const mp2p_icp::point_plane_sym_pair_t&                     pairing,
+    const mrpt::poses::CPose3D&                                 relativePose,
+    mrpt::optional_ref<mrpt::math::CMatrixFixed<double, 1, 12>> jacobian =
+        std::nullopt);
+
 mrpt::math::CVectorFixedDouble<4> error_line2line(
     const mp2p_icp::matched_line_t&            pairing,
     const mrpt::poses::CPose3D&                relativePose,
@@ -0,0 +1,60 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   estimate_normals.h
+ * @brief  Batch estimation of normals for whole point layers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/PointNormals.h>
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/maps/CPointsMap.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** Parameters for estimate_normals() */
+struct NormalEstimationParameters
+{
+    NormalEstimationParameters() = default;
+
+    /** Number of neighbors of each point (including itself) */
+    uint32_t knn = 10;
+
+    /** If >0, neighbors farther than this are ignored [meters] */
+    double maxDistance = 0;
+
+    /** Maximum number of threads, `0` means as many as hardware threads */
+    std::size_t maxThreads = 0;
+};
+
+/** Computes the normal, curvature and eigenvalue ratios of each point of a
+ * layer, from one kNN search per point on the KD-tree of `pts`. Points are
+ * processed in parallel; the KD-tree is built beforehand, in the calling
+ * thread, so the parallel searches only read it.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+PointNormals::Ptr estimate_normals(
+    const mrpt::maps::CPointsMap&     pts,
+    const NormalEstimationParameters& p = NormalEstimationParameters());
+
+/** Runs estimate_normals() on the given point layers of `pc` (all of them,
+ * if `layers` is empty), storing the results in `pc.layer_normals`.
+ *
+ * \ingroup mp2p_icp_grp
+ */
+void estimate_normals(
+    pointcloud_t&                     pc,
+    const NormalEstimationParameters& p      = NormalEstimationParameters(),
+    const std::vector<std::string>&   layers = {});
+
+}  // namespace mp2p_icp
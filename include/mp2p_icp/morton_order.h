@@ -0,0 +1,66 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   morton_order.h
+ * @brief  Z-order (Morton) sorting of points, for cache-coherent KD-tree use
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/maps/CPointsMap.h>
+#include <mrpt/math/TPoint3D.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** \addtogroup mp2p_icp_grp
+ * @{ */
+
+/** Returns the 63-bit Morton (Z-order) code of a point, after quantizing each
+ * coordinate into 21 bits within the bounding box [bbMin, bbMax].
+ * Points outside of the bounding box are clamped to its borders.
+ */
+uint64_t morton_code(
+    const float x, const float y, const float z,
+    const mrpt::math::TPoint3Df& bbMin, const mrpt::math::TPoint3Df& bbMax);
+
+/** Returns the permutation of point indices [0,n-1] that sorts the given
+ * points by their Morton (Z-order) code, such that consecutive points in the
+ * output are spatially close to each other.
+ *
+ * \param[in] xs,ys,zs Point coordinates, `n` elements each.
+ * \param[in] bbMin,bbMax Bounding box of the points.
+ */
+std::vector<std::size_t> morton_sort_indices(
+    const float* xs, const float* ys, const float* zs, const std::size_t n,
+    const mrpt::math::TPoint3Df& bbMin, const mrpt::math::TPoint3Df& bbMax);
+
+/** Reorders, in place, all points (and their extra fields, e.g. color or
+ * intensity) in the map according to their Morton (Z-order) code.
+ *
+ * The result is the same set of points, in an order for which nearby points
+ * are also close in memory, which makes consecutive KD-tree queries much more
+ * cache friendly. Point indices change, so this must be done while preparing a
+ * map, before any `Pairings` refer to its points.
+ */
+void reorder_points_morton(mrpt::maps::CPointsMap& pts);
+
+/** Applies reorder_points_morton() to all point layers in a point cloud,
+ * except pointcloud_t::PT_LAYER_PLANE_CENTROIDS, whose order must match that
+ * of pointcloud_t::planes. Layers are modified through
+ * pointcloud_t::mutableLayer(), so point clouds sharing them are not
+ * affected. Normals in pointcloud_t::layer_normals are reordered along with
+ * their points.
+ */
+void reorder_layers_morton(pointcloud_t& pc);
+
+/** @} */
+
+}  // namespace mp2p_icp
@@ -11,9 +11,12 @@
  */
 #pragma once
 
+#include <mp2p_icp/CompactPairings.h>
+#include <mp2p_icp/DOFMask.h>
 #include <mp2p_icp/OptimalTF_Result.h>
 #include <mp2p_icp/Pairings.h>
 #include <mp2p_icp/WeightParameters.h>
+#include <mp2p_icp/robust_kernels.h>
 
 namespace mp2p_icp
 {
@@ -30,6 +33,18 @@ struct OptimalTF_GN_Parameters
     /** Minimum SE(3) change to stop iterating. */
     double minDelta = 1e-7;
 
+    /** Robust kernel for all error terms, applied via iteratively reweighted
+     * least squares (IRLS). See RobustKernel. */
+    RobustKernel kernel = RobustKernel::None;
+
+    /** Parameter `c` of the robust kernel: residuals (in meters for points,
+     * or the sine of angles for directions) beyond it are down-weighted. */
+    double kernelParam = 0.10;
+
+    /** Degrees of freedom to optimize. Fixed ones keep the value of
+     * `linearizationPoint`. */
+    DOFMask dofMask;
+
     /** The linerization point (the current relative pose guess) */
     std::optional<mrpt::poses::CPose3D> linearizationPoint;
 };
@@ -37,6 +52,14 @@ struct OptimalTF_GN_Parameters
 /** Gauss-Newton non-linear, iterative optimizer to find the SE(3) optimal
  * transformation between a set of correspondences.
  *
+ * The weight \f$ w_i \f$ of each pairing, from
+ * WeightParameters::pair_weights times its individual weight in
+ * Pairings::weights (if any), scales the rows of its Jacobian, but not its
+ * residual. The solution is thus a minimum of \f$ \sum_i w_i |e_i|^2 \f$,
+ * but with non-unit weights the steps towards it are not those of
+ * Gauss-Newton on that cost, and may need more iterations. See
+ * optimal_tf_levenberg_marquardt() for a solver on that exact cost.
+ *
  * This method requires a linearization point in
  * `OptimalTF_GN_Parameters::linearizationPoint`.
  */
@@ -44,6 +67,13 @@ void optimal_tf_gauss_newton(
     const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result,
     const OptimalTF_GN_Parameters& gnParams = OptimalTF_GN_Parameters());
 
+/** \overload For pairings in compact form, read directly from their
+ * coordinate arrays at each iteration. */
+void optimal_tf_gauss_newton(
+    const CompactPairings& in, const WeightParameters& wp,
+    OptimalTF_Result&              result,
+    const OptimalTF_GN_Parameters& gnParams = OptimalTF_GN_Parameters());
+
 /** @} */
 
 }  // namespace mp2p_icp
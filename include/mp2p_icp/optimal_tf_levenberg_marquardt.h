@@ -0,0 +1,86 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_levenberg_marquardt.h
+ * @brief  Damped non-linear optimizer for the SE(3) optimal transformation
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/CompactPairings.h>
+#include <mp2p_icp/DOFMask.h>
+#include <mp2p_icp/OptimalTF_Result.h>
+#include <mp2p_icp/Pairings.h>
+#include <mp2p_icp/WeightParameters.h>
+#include <mp2p_icp/robust_kernels.h>
+
+#include <optional>
+
+namespace mp2p_icp
+{
+/** \addtogroup  mp2p_icp_grp
+ * @{ */
+
+struct OptimalTF_LM_Parameters
+{
+    bool verbose = false;
+
+    /** Maximum number of iterations (accepted or rejected steps) */
+    uint32_t maxInnerLoopIterations = 20;
+
+    /** Minimum SE(3) change to stop iterating. */
+    double minDelta = 1e-7;
+
+    /** Stop if the max. absolute value of the gradient is below this. */
+    double minGradient = 1e-10;
+
+    /** Initial damping, relative to the largest diagonal entry of the
+     * approximate Hessian. */
+    double initialLambdaFactor = 1e-3;
+
+    /** Robust kernel for all error terms, applied via iteratively reweighted
+     * least squares (IRLS). See RobustKernel. */
+    RobustKernel kernel = RobustKernel::None;
+
+    /** Parameter `c` of the robust kernel: residuals (in meters for points,
+     * or the sine of angles for directions) beyond it are down-weighted. */
+    double kernelParam = 0.10;
+
+    /** Degrees of freedom to optimize. Fixed ones keep the value of
+     * `linearizationPoint`. */
+    DOFMask dofMask;
+
+    /** The linerization point (the current relative pose guess) */
+    std::optional<mrpt::poses::CPose3D> linearizationPoint;
+};
+
+/** Levenberg-Marquardt non-linear, iterative optimizer to find the SE(3)
+ * optimal transformation between a set of correspondences.
+ *
+ * Each step solves the damped normal equations \f$ (H+\lambda I)\delta=-g \f$
+ * and is only accepted if it decreases the cost. The damping \f$\lambda\f$ is
+ * adapted from the ratio between the actual and the predicted cost decrease
+ * (Nielsen's strategy), so it behaves like Gauss-Newton near the optimum and
+ * like gradient descent far from it or near degeneracies.
+ *
+ * This method requires a linearization point in
+ * `OptimalTF_LM_Parameters::linearizationPoint`.
+ */
+void optimal_tf_levenberg_marquardt(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result,
+    const OptimalTF_LM_Parameters& lmParams = OptimalTF_LM_Parameters());
+
+/** \overload For pairings in compact form, read directly from their
+ * coordinate arrays at each iteration. */
+void optimal_tf_levenberg_marquardt(
+    const CompactPairings& in, const WeightParameters& wp,
+    OptimalTF_Result&              result,
+    const OptimalTF_LM_Parameters& lmParams = OptimalTF_LM_Parameters());
+
+/** @} */
+
+}  // namespace mp2p_icp
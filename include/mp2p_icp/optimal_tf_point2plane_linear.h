@@ -0,0 +1,52 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_point2plane_linear.h
+ * @brief  Small-angle linearized point-to-plane optimal transformation
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/DOFMask.h>
+#include <mp2p_icp/OptimalTF_Result.h>
+#include <mp2p_icp/Pairings.h>
+#include <mp2p_icp/WeightParameters.h>
+
+namespace mp2p_icp
+{
+/** \addtogroup  mp2p_icp_grp
+ * @{ */
+
+/** Closed-form, one-shot solution of the point-to-plane registration problem
+ * under the small-angle approximation (Low, 2004).
+ *
+ * Local points are first transformed with `linearizationPoint`. Then, the
+ * incremental rotation \f$\omega\f$ and translation \f$t\f$ (in the global
+ * frame) minimizing \f$\sum_i w_i (n_i^\top(p_i + \omega \times p_i + t -
+ * q_i))^2\f$ are found by accumulating the 6x6 normal equations in one pass
+ * and solving them via LDLT. There is no inner iteration: the outer ICP loop
+ * takes care of relinearizing.
+ *
+ * Uses `Pairings::paired_pt2pl`, and `Pairings::paired_pt2pt` as three
+ * point-to-plane pairings each (one per coordinate axis). Symmetric
+ * point-to-plane pairings (`Pairings::paired_pt2pl_sym`) are linearized as in
+ * (Rusinkiewicz, 2019), in which case the increment is applied as two half
+ * rotations around the translation. Other pairing types are ignored.
+ *
+ * Only the DOFs in `dofs` are solved for, as a reduced linear system, while
+ * the rest keep the values of `linearizationPoint`.
+ *
+ * \return false if there are not enough pairings to constrain all free DOFs.
+ */
+bool optimal_tf_point2plane_linear(
+    const Pairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& linearizationPoint, OptimalTF_Result& result,
+    const DOFMask& dofs = DOFMask());
+
+/** @} */
+
+}  // namespace mp2p_icp
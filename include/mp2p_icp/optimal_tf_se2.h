@@ -0,0 +1,72 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_se2.h
+ * @brief  SE(2) optimal transformation for planar point clouds
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/DOFMask.h>
+#include <mp2p_icp/OptimalTF_Result.h>
+#include <mp2p_icp/Pairings.h>
+#include <mp2p_icp/WeightParameters.h>
+#include <mrpt/poses/CPose2D.h>
+
+#include <cstdint>
+#include <optional>
+
+namespace mp2p_icp
+{
+/** \addtogroup  mp2p_icp_grp
+ * @{ */
+
+/** Closed-form SE(2) solution (x, y, yaw) of the weighted point-to-point
+ * registration problem, ignoring the z coordinates. Meant for 2D scans, or
+ * any pair of point clouds on the z=0 plane.
+ *
+ * Uses `Pairings::paired_pt2pt` only, with their individual weights in
+ * `Pairings::weights`, if any.
+ *
+ * \return false if there are less than two pairings.
+ */
+bool optimal_tf_se2_closed_form(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result);
+
+struct OptimalTF_SE2_GN_Parameters
+{
+    /** Maximum number of iterations trying to solve for the optimal pose */
+    uint32_t maxInnerLoopIterations = 6;
+
+    /** Minimum change in (x,y,yaw) to stop iterating. */
+    double minDelta = 1e-7;
+
+    /** The linerization point (the current relative pose guess) */
+    std::optional<mrpt::poses::CPose2D> linearizationPoint;
+
+    /** Only its `x`, `y` and `yaw` fields are used: fixed ones keep the
+     * values of the linearization point. */
+    DOFMask dofMask;
+};
+
+/** Gauss-Newton optimizer of the SE(2) pose (x, y, yaw), for point clouds on
+ * the z=0 plane, with 3x3 normal equations.
+ *
+ * Uses point-to-point pairings (xy error) and point-to-plane pairings (only
+ * planes with a non-horizontal normal, i.e. lines in the XY plane). Other
+ * pairing types are ignored.
+ *
+ * This method requires a linearization point in
+ * `OptimalTF_SE2_GN_Parameters::linearizationPoint`.
+ */
+void optimal_tf_se2_gauss_newton(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result,
+    const OptimalTF_SE2_GN_Parameters& gnParams);
+
+/** @} */
+
+}  // namespace mp2p_icp
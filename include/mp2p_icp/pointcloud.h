@@ -11,6 +11,9 @@
  */
 #pragma once
 
+#include <mp2p_icp/PointNormals.h>
+#include <mp2p_icp/PointsView.h>
+#include <mp2p_icp/QuantizedPoints.h>
 #include <mrpt/img/TColor.h>
 #include <mrpt/maps/CPointsMap.h>
 #include <mrpt/math/TLine3D.h>
@@ -75,11 +78,51 @@ class pointcloud_t : public mrpt::serialization::CSerializable
      * - PT_LAYER_RAW: reserved to the original, full point cloud (if kept)
      * - PT_LAYER_PLANE_CENTROIDS: a point for each plane in `planes` (same
      * order).
+     *
+     * \note Layer objects may be shared with other point clouds: by copies
+     * of this object, and by clouds moved into this one with
+     * mergeWith(pointcloud_t&&). Modifying a layer through these pointers
+     * modifies it in all of them; use mutableLayer() instead.
      */
     std::map<std::string, mrpt::maps::CPointsMap::Ptr> point_layers;
     std::vector<mrpt::math::TLine3D>                   lines;
     std::vector<plane_patch_t>                         planes;
 
+    /** Point layers in caller-owned buffers, e.g. a scan as delivered by a
+     * sensor driver, used without copying them. Matchers and quality
+     * evaluators use them like `point_layers` of the same name when this is
+     * the *local* point cloud; global layers need a KD-tree, so they must be
+     * in `point_layers`. A name must not be used in both containers.
+     *
+     * \note External layers are not serialized. The buffers must outlive
+     * this object.
+     */
+    std::map<std::string, PointsView> external_layers;
+
+    /** Point layers in compressed form, for storing large maps which are
+     * not matched against directly. Matchers ignore them: use
+     * QuantizedPoints::toPointsMap() to decode one into `point_layers`
+     * before using it in an alignment. A name must not be used in both this
+     * and `point_layers`.
+     */
+    std::map<std::string, QuantizedPoints::Ptr> quantized_layers;
+
+    /** Per-point normals of point layers, by layer name, e.g. computed with
+     * estimate_normals(). They are only meaningful while the layer keeps
+     * the same points: mutableLayer() drops them, and normalsOf() ignores
+     * them if their number does not match that of the points.
+     */
+    std::map<std::string, PointNormals::Ptr> layer_normals;
+
+    /** Returns the normals of the given point layer, or nullptr if there are
+     * none, or their number does not match the number of points. */
+    PointNormals::ConstPtr normalsOf(const std::string& layer) const;
+
+    /** Returns a view of the layer with the given name, from either
+     * `point_layers` or `external_layers`, or an empty optional if there is
+     * no such layer. */
+    std::optional<PointsView> layerView(const std::string& name) const;
+
     /** return true if all point cloud layers, feature lists, etc. are empty */
     virtual bool empty() const;
 
@@ -89,6 +132,10 @@ class pointcloud_t : public mrpt::serialization::CSerializable
     /** clear all containers  */
     virtual void clear();
 
+    /** true if all points lie on the z=0 plane (within `zTolerance`) and
+     * there are no lines nor planes, e.g. a 2D laser scan. */
+    virtual bool isPlanar(const double zTolerance = 1e-6) const;
+
     /** Gets a renderizable view of all planes. The target container `o` is not
      * cleared(), clear() it manually if needed before calling. */
     void planesAsRenderizable(
@@ -98,8 +145,22 @@ class pointcloud_t : public mrpt::serialization::CSerializable
     /** Merges all geometric entities from another point cloud into this one,
      * with an optional relative pose transformation.
      *
-     * \note Point layers will be merged for coinciding names, or created if the
-     * layer did not exist in `this`.
+     * Point layers will be merged for coinciding names, or created if the
+     * layer did not exist in `this`. External layers of `otherPc` are copied
+     * into `point_layers`. Quantized layers are merged into
+     * `quantized_layers`, keeping the resolution of existing layers.
+     *
+     * All layers are copied: `otherPc` may be modified afterwards without
+     * affecting `this`, and the other way around.
+     *
+     * \note Whether a layer is shared is decided from the reference count of
+     * its pointer, which is only exact if no other thread is copying (or
+     * destroying) point clouds which hold the same layers at the same time.
+     * Merging into, or calling mutableLayer() on, point clouds which share
+     * layers with others in use from other threads needs external
+     * synchronization.
+     * \note Normals in `layer_normals` are kept (and rotated) for layers
+     * with normals in both point clouds, and dropped otherwise.
      * \note This method is virtual for user-extended point clouds can handle
      * other geometric primitives as needed.
      */
@@ -107,6 +168,50 @@ class pointcloud_t : public mrpt::serialization::CSerializable
         const pointcloud_t&                       otherPc,
         const std::optional<mrpt::math::TPose3D>& otherRelativePose =
             std::nullopt);
+
+    /** Like the other overload, but layers, lines and planes of `otherPc`
+     * not shared with other point clouds are moved instead of copied, and
+     * transformed in place if needed. `otherPc` is left empty.
+     *
+     * Layers of `otherPc` which do not exist in `this` and are shared with
+     * other point clouds are **not copied** either if there is no
+     * `otherRelativePose`: all of them hold the same layer object (and its
+     * normals) afterwards. Modify it only through mutableLayer(), which
+     * makes a private copy of shared layers first.
+     * \note See the note on thread safety of the other overload. */
+    virtual void mergeWith(
+        pointcloud_t&&                            otherPc,
+        const std::optional<mrpt::math::TPose3D>& otherRelativePose =
+            std::nullopt);
+
+    /** Returns a point layer for modification. Copies of a pointcloud_t
+     * share their layers (copy-on-write), so read-only duplicates of large
+     * maps cost no memory. This makes a private copy of the layer first if
+     * it is shared; modify layers only through this method (or mergeWith())
+     * if the point cloud may have been copied, or merged with others.
+     * Normals of the layer in `layer_normals` are dropped, since they may
+     * no longer match its points; recompute them if needed.
+     * \note See the note on thread safety in mergeWith().
+     * \exception std::exception If there is no such layer.
+     */
+    mrpt::maps::CPointsMap::Ptr mutableLayer(const std::string& name);
+
+   protected:
+    void mergeLinesAndPlanes(
+        const std::vector<mrpt::math::TLine3D>&    otherLines,
+        const std::vector<plane_patch_t>&          otherPlanes,
+        const std::optional<mrpt::poses::CPose3D>& pose);
+
+    void mergeQuantized(
+        const std::map<std::string, QuantizedPoints::Ptr>& otherLayers,
+        const std::optional<mrpt::poses::CPose3D>&         pose);
+
+    /** Must be called before merging the point layers of `otherPc`. If
+     * `share`, normals of new layers are shared instead of copied when
+     * there is no `pose`. */
+    void mergeNormals(
+        const pointcloud_t&                        otherPc,
+        const std::optional<mrpt::poses::CPose3D>& pose, const bool share);
 };
 
 /** @} */
@@ -0,0 +1,62 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   robust_kernels.h
+ * @brief  Robust cost functions (M-estimators) for least-squares solvers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mrpt/typemeta/TEnumType.h>
+
+#include <Eigen/Core>
+
+namespace mp2p_icp
+{
+/** Robust kernels (M-estimators) for the iterative least-squares solvers.
+ * All of them behave like a plain squared error for residuals much smaller
+ * than their parameter `c`, and reduce the influence of larger ones.
+ * \ingroup mp2p_icp_grp
+ */
+enum class RobustKernel
+{
+    /** Plain least squares: \f$ \rho(r)=r^2 \f$ */
+    None = 0,
+    /** \f$ \rho(r)=r^2 \f$ if \f$ r \le c \f$, \f$ 2cr-c^2 \f$ otherwise */
+    Huber,
+    /** \f$ \rho(r)=c^2 \log(1+(r/c)^2) \f$ */
+    Cauchy,
+    /** \f$ \rho(r)=\frac{c^2}{3}(1-(1-(r/c)^2)^3) \f$ if \f$ r \le c \f$,
+     * \f$ \frac{c^2}{3} \f$ otherwise (i.e. ignore residuals > c) */
+    Tukey,
+    /** \f$ \rho(r)=\frac{c^2 r^2}{c^2+r^2} \f$ */
+    GemanMcClure
+};
+
+/** Evaluates the IRLS weights \f$ w(r)=\rho'(r)/(2r) \f$ for a whole vector
+ * of (non-negative) residual norms `r` at once.
+ * \ingroup mp2p_icp_grp
+ */
+Eigen::ArrayXd robust_kernel_weights(
+    const RobustKernel kernel, const double c, const Eigen::ArrayXd& r);
+
+/** Evaluates the robust cost \f$ \rho(r) \f$ for a whole vector of
+ * (non-negative) residual norms `r` at once.
+ * \ingroup mp2p_icp_grp
+ */
+Eigen::ArrayXd robust_kernel_cost(
+    const RobustKernel kernel, const double c, const Eigen::ArrayXd& r);
+
+}  // namespace mp2p_icp
+
+MRPT_ENUM_TYPE_BEGIN_NAMESPACE(mp2p_icp, mp2p_icp::RobustKernel)
+MRPT_FILL_ENUM_MEMBER(RobustKernel, None);
+MRPT_FILL_ENUM_MEMBER(RobustKernel, Huber);
+MRPT_FILL_ENUM_MEMBER(RobustKernel, Cauchy);
+MRPT_FILL_ENUM_MEMBER(RobustKernel, Tukey);
+MRPT_FILL_ENUM_MEMBER(RobustKernel, GemanMcClure);
+MRPT_ENUM_TYPE_END()
@@ -0,0 +1,69 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   select_informative_pairings.h
+ * @brief  Selection of the subset of pairings that best constrain the pose
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/Pairings.h>
+#include <mrpt/containers/yaml.h>
+#include <mrpt/poses/CPose3D.h>
+#include <mrpt/serialization/CArchive.h>
+
+#include <cstdint>
+
+namespace mp2p_icp
+{
+/** \addtogroup  mp2p_icp_grp
+ * @{ */
+
+/** Parameters for select_informative_pairings() */
+struct PairingsSelectionParameters
+{
+    /** If false (default), all pairings are passed to the solvers. */
+    bool enabled = false;
+
+    /** Fraction [0,1] of point-to-point and point-to-plane pairings to keep.
+     */
+    double keepRatio = 0.2;
+
+    /** Never reduce the number of point-to-point and point-to-plane pairings
+     * below this count. */
+    uint32_t minPairings = 100;
+
+    void load_from(const mrpt::containers::yaml& p);
+    void save_to(mrpt::containers::yaml& p) const;
+    void serializeTo(mrpt::serialization::CArchive& out) const;
+    void serializeFrom(mrpt::serialization::CArchive& in);
+};
+
+/** Returns a subset of the point-to-point and point-to-plane pairings in `in`
+ * that preserves, as much as possible, the eigen-spectrum of the 6x6
+ * information matrix of the SE(3) registration problem.
+ *
+ * Each candidate pairing is scored by its contribution to each eigenvector
+ * direction of the information matrix (through the point-to-plane normal, or
+ * the three point-to-point coordinate axes), and pairings are greedily picked
+ * for the direction that is least constrained so far ("covariance sampling",
+ * Gelfand et al. 3DIM 2003). This keeps degenerate directions, e.g. along a
+ * corridor, as well constrained as possible with a fraction of the pairings.
+ *
+ * All other pairing types are copied unmodified. Individual weights in
+ * `Pairings::weights` are kept for the selected pairings.
+ *
+ * \param[in] relativePose The current guess of the relative pose of the local
+ * point cloud wrt the global one, used to evaluate the geometry of pairings.
+ */
+Pairings select_informative_pairings(
+    const Pairings& in, const PairingsSelectionParameters& p,
+    const mrpt::poses::CPose3D& relativePose);
+
+/** @} */
+
+}  // namespace mp2p_icp
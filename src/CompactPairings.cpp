@@ -0,0 +1,216 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   CompactPairings.cpp
+ * @brief  Compact, structure-of-arrays storage of pairings
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/CompactPairings.h>
+#include <mrpt/core/exceptions.h>
+
+#include <array>
+#include <map>
+#include <mutex>
+
+using namespace mp2p_icp;
+
+CompactPairings::PointPairs::PointPairs(
+    const mrpt::tfest::TMatchingPairList& pairs)
+{
+    reserve(pairs.size());
+    for (const auto& p : pairs) push_back(p);
+}
+
+void CompactPairings::PointPairs::reserve(const std::size_t n)
+{
+    for (auto* v : {&this_x, &this_y, &this_z, &other_x, &other_y, &other_z})
+        v->reserve(n);
+    this_idx.reserve(n);
+    other_idx.reserve(n);
+}
+
+void CompactPairings::PointPairs::push_back(const mrpt::tfest::TMatchingPair& p)
+{
+    this_x.push_back(p.this_x);
+    this_y.push_back(p.this_y);
+    this_z.push_back(p.this_z);
+    other_x.push_back(p.other_x);
+    other_y.push_back(p.other_y);
+    other_z.push_back(p.other_z);
+    this_idx.push_back(p.this_idx);
+    other_idx.push_back(p.other_idx);
+}
+
+mrpt::tfest::TMatchingPair CompactPairings::PointPairs::at(
+    const std::size_t i) const
+{
+    mrpt::tfest::TMatchingPair p;
+    p.this_idx  = this_idx.at(i);
+    p.other_idx = other_idx[i];
+    p.this_x    = this_x[i];
+    p.this_y    = this_y[i];
+    p.this_z    = this_z[i];
+    p.other_x   = other_x[i];
+    p.other_y   = other_y[i];
+    p.other_z   = other_z[i];
+    return p;
+}
+
+uint32_t CompactPairings::PlaneTable::push_back(const plane_patch_t& p)
+{
+    const auto& c = p.plane.coefs;
+    nx.push_back(c[0]);
+    ny.push_back(c[1]);
+    nz.push_back(c[2]);
+    d.push_back(c[3]);
+    cx.push_back(p.centroid.x);
+    cy.push_back(p.centroid.y);
+    cz.push_back(p.centroid.z);
+    return static_cast<uint32_t>(nx.size() - 1);
+}
+
+plane_patch_t CompactPairings::PlaneTable::at(const std::size_t i) const
+{
+    plane_patch_t p;
+    p.plane.coefs[0] = nx.at(i);
+    p.plane.coefs[1] = ny[i];
+    p.plane.coefs[2] = nz[i];
+    p.plane.coefs[3] = d[i];
+    p.centroid       = mrpt::math::TPoint3D(cx[i], cy[i], cz[i]);
+    return p;
+}
+
+void CompactPairings::PointPlanePairs::push_back(
+    const mrpt::math::TPoint3Df& pt, const uint32_t plane)
+{
+    other_x.push_back(pt.x);
+    other_y.push_back(pt.y);
+    other_z.push_back(pt.z);
+    plane_idx.push_back(plane);
+}
+
+void CompactPairings::PointPlaneSymPairs::push_back(
+    const point_plane_sym_pair_t& p)
+{
+    this_x.push_back(p.pt_this.x);
+    this_y.push_back(p.pt_this.y);
+    this_z.push_back(p.pt_this.z);
+    n_this_x.push_back(p.n_this.x);
+    n_this_y.push_back(p.n_this.y);
+    n_this_z.push_back(p.n_this.z);
+    other_x.push_back(p.pt_other.x);
+    other_y.push_back(p.pt_other.y);
+    other_z.push_back(p.pt_other.z);
+    n_other_x.push_back(p.n_other.x);
+    n_other_y.push_back(p.n_other.y);
+    n_other_z.push_back(p.n_other.z);
+}
+
+point_plane_sym_pair_t CompactPairings::PointPlaneSymPairs::at(
+    const std::size_t i) const
+{
+    return point_plane_sym_pair_t(
+        {this_x.at(i), this_y[i], this_z[i]},
+        {n_this_x[i], n_this_y[i], n_this_z[i]},
+        {other_x[i], other_y[i], other_z[i]},
+        {n_other_x[i], n_other_y[i], n_other_z[i]});
+}
+
+CompactPairings CompactPairings::FromPairings(const Pairings& p)
+{
+    MRPT_START
+
+    CompactPairings c;
+
+    c.pt2pt = PointPairs(p.paired_pt2pt);
+
+    // Matchers pair many points against the same plane, so store each
+    // distinct plane only once:
+    std::map<std::array<double, 7>, uint32_t> planeIndices;
+    for (const auto& pp : p.paired_pt2pl)
+    {
+        const auto& pl  = pp.pl_this;
+        const auto& cf  = pl.plane.coefs;
+        const auto  key = std::array<double, 7>{
+            cf[0],         cf[1],         cf[2],        cf[3],
+            pl.centroid.x, pl.centroid.y, pl.centroid.z};
+
+        auto it = planeIndices.find(key);
+        if (it == planeIndices.end())
+            it = planeIndices.emplace(key, c.planes.push_back(pl)).first;
+
+        c.pt2pl.push_back(pp.pt_other, it->second);
+    }
+
+    for (const auto& ps : p.paired_pt2pl_sym) c.pt2pl_sym.push_back(ps);
+
+    c.paired_pt2ln = p.paired_pt2ln;
+    c.paired_ln2ln = p.paired_ln2ln;
+    c.paired_pl2pl = p.paired_pl2pl;
+    c.weights      = p.weights;
+
+    return c;
+
+    MRPT_END
+}
+
+bool CompactPairings::empty() const
+{
+    return pt2pt.empty() && pt2pl.empty() && pt2pl_sym.empty() &&
+           paired_pt2ln.empty() && paired_ln2ln.empty() &&
+           paired_pl2pl.empty();
+}
+
+std::size_t CompactPairings::size() const
+{
+    return pt2pt.size() + pt2pl.size() + pt2pl_sym.size() +
+           paired_pt2ln.size() + paired_ln2ln.size() + paired_pl2pl.size();
+}
+
+const Pairings& CompactPairings::asPairings() const
+{
+    MRPT_START
+
+    std::lock_guard<copyable_mutex_t> lck(legacyMtx_);
+    if (legacy_) return *legacy_;
+
+    Pairings p;
+
+    p.paired_pt2pt.reserve(pt2pt.size());
+    for (std::size_t i = 0; i < pt2pt.size(); i++)
+        p.paired_pt2pt.push_back(pt2pt.at(i));
+
+    p.paired_pt2pl.reserve(pt2pl.size());
+    for (std::size_t i = 0; i < pt2pl.size(); i++)
+    {
+        p.paired_pt2pl.emplace_back(
+            planes.at(pt2pl.plane_idx[i]),
+            mrpt::math::TPoint3Df(
+                pt2pl.other_x[i], pt2pl.other_y[i], pt2pl.other_z[i]));
+    }
+
+    p.paired_pt2pl_sym.reserve(pt2pl_sym.size());
+    for (std::size_t i = 0; i < pt2pl_sym.size(); i++)
+        p.paired_pt2pl_sym.push_back(pt2pl_sym.at(i));
+
+    p.paired_pt2ln = paired_pt2ln;
+    p.paired_ln2ln = paired_ln2ln;
+    p.paired_pl2pl = paired_pl2pl;
+    p.weights      = weights;
+
+    legacy_ = std::move(p);
+    return *legacy_;
+
+    MRPT_END
+}
+
+void CompactPairings::invalidateCache()
+{
+    std::lock_guard<copyable_mutex_t> lck(legacyMtx_);
+    legacy_.reset();
+}
@@ -0,0 +1,85 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   DOFMask.cpp
+ * @brief  Selection of the degrees of freedom of the pose to be estimated
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/DOFMask.h>
+
+using namespace mp2p_icp;
+
+DOFMask DOFMask::Planar()
+{
+    DOFMask m;
+    m.z     = false;
+    m.pitch = false;
+    m.roll  = false;
+    return m;
+}
+
+DOFMask DOFMask::XYZYaw()
+{
+    DOFMask m;
+    m.pitch = false;
+    m.roll  = false;
+    return m;
+}
+
+std::vector<int> DOFMask::freeIncrementIndices() const
+{
+    std::vector<int> idxs;
+    if (x) idxs.push_back(0);
+    if (y) idxs.push_back(1);
+    if (z) idxs.push_back(2);
+    if (roll) idxs.push_back(3);
+    if (pitch) idxs.push_back(4);
+    if (yaw) idxs.push_back(5);
+    return idxs;
+}
+
+mrpt::poses::CPose3D DOFMask::project(
+    const mrpt::poses::CPose3D& p, const mrpt::poses::CPose3D& ref) const
+{
+    if (allFree()) return p;
+
+    return mrpt::poses::CPose3D(
+        x ? p.x() : ref.x(), y ? p.y() : ref.y(), z ? p.z() : ref.z(),
+        yaw ? p.yaw() : ref.yaw(), pitch ? p.pitch() : ref.pitch(),
+        roll ? p.roll() : ref.roll());
+}
+
+void DOFMask::load_from(const mrpt::containers::yaml& p)
+{
+    MCP_LOAD_OPT(p, x);
+    MCP_LOAD_OPT(p, y);
+    MCP_LOAD_OPT(p, z);
+    MCP_LOAD_OPT(p, yaw);
+    MCP_LOAD_OPT(p, pitch);
+    MCP_LOAD_OPT(p, roll);
+}
+
+void DOFMask::save_to(mrpt::containers::yaml& p) const
+{
+    MCP_SAVE(p, x);
+    MCP_SAVE(p, y);
+    MCP_SAVE(p, z);
+    MCP_SAVE(p, yaw);
+    MCP_SAVE(p, pitch);
+    MCP_SAVE(p, roll);
+}
+
+void DOFMask::serializeTo(mrpt::serialization::CArchive& out) const
+{
+    out << x << y << z << yaw << pitch << roll;
+}
+
+void DOFMask::serializeFrom(mrpt::serialization::CArchive& in)
+{
+    in >> x >> y >> z >> yaw >> pitch >> roll;
+}
@@ -11,11 +11,22 @@
  */
 
 #include <mp2p_icp/ICP.h>
+#include <mp2p_icp/anderson_acceleration.h>
 #include <mp2p_icp/covariance.h>
+#include <mp2p_icp/select_informative_pairings.h>
 #include <mrpt/core/exceptions.h>
-#include <mrpt/poses/Lie/SE.h>
 #include <mrpt/tfest/se3.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "RigidTransform3.h"
+#include "build_kdtrees.h"
+#include "linearize_pairings.h"
+#include "run_in_parallel.h"
+
 IMPLEMENTS_MRPT_OBJECT(ICP, mrpt::rtti::CObject, mp2p_icp)
 
 using namespace mp2p_icp;
@@ -39,6 +50,23 @@ void ICP::align(
     // Reset output:
     result = Results();
 
+    // SE(2) mode for planar point clouds, e.g. 2D laser scans:
+    const double planarTol = 1e-6;
+    const auto&  g         = initialGuessM2wrtM1;
+
+    result.se2Mode = p.autoSE2Mode && std::abs(g.z) < planarTol &&
+                     std::abs(g.pitch) < planarTol &&
+                     std::abs(g.roll) < planarTol && pcs1.isPlanar(planarTol) &&
+                     pcs2.isPlanar(planarTol);
+
+    DOFMask dofMask = p.dofMask;
+    if (result.se2Mode)
+    {
+        dofMask.z     = false;
+        dofMask.pitch = false;
+        dofMask.roll  = false;
+    }
+
     // ------------------------------------------------------
     // Main ICP loop
     // ------------------------------------------------------
@@ -46,21 +74,39 @@ void ICP::align(
 
     state.currentSolution.optimalPose =
         mrpt::poses::CPose3D(initialGuessM2wrtM1);
-    auto prev_solution = state.currentSolution.optimalPose;
+
+    // Anderson acceleration, in the Lie algebra of poses relative to the
+    // initial guess (to stay far from the log() singularity):
+    const bool             useAnderson = p.andersonHistory > 0;
+    const RigidTransform3d initialTf(state.currentSolution.optimalPose);
+    const RigidTransform3d initialTfInv = initialTf.inverse();
+    AndersonAcceleration   anderson(p.andersonHistory);
+
+    // Last non-extrapolated iterate, the mean error at the last accepted
+    // pose, whether the current pose is an extrapolated one, and whether the
+    // current pairings were matched at a rejected one:
+    auto   lastPlainPose     = state.currentSolution.optimalPose;
+    double lastAcceptedError = std::numeric_limits<double>::max();
+    bool   isExtrapolated    = false;
+    bool   stalePairings     = false;
 
     for (result.nIterations = 0; result.nIterations < p.maxIterations;
          result.nIterations++)
     {
         state.currentIteration = result.nIterations;
 
+        const auto prev_solution = state.currentSolution.optimalPose;
+
         // Matchings
         // ---------------------------------------
         MatchContext mc;
         mc.icpIteration = state.currentIteration;
+        mc.se2          = result.se2Mode;
 
         state.currentPairings = run_matchers(
             matchers_, state.pc1, state.pc2, state.currentSolution.optimalPose,
-            mc);
+            mc, p.maxParallelMatchers);
+        stalePairings = false;
 
         if (state.currentPairings.empty())
         {
@@ -68,31 +114,75 @@ void ICP::align(
             break;
         }
 
+        // Safeguard: only keep an extrapolated pose if it does not increase
+        // the mean squared error. Otherwise, go back to the plain iterate.
+        if (useAnderson)
+        {
+            const double err = linearize_pairings(
+                                   state.currentPairings,
+                                   p.pairingsWeightParameters, prev_solution,
+                                   false /*cost only*/)
+                                   .cost /
+                               state.currentPairings.size();
+
+            if (isExtrapolated && err > lastAcceptedError)
+            {
+                anderson.reset();
+                isExtrapolated                    = false;
+                stalePairings                     = true;
+                state.currentSolution.optimalPose = lastPlainPose;
+                continue;
+            }
+            lastAcceptedError = err;
+        }
+
         // Optimal relative pose:
         // ---------------------------------------
         SolverContext sc;
         sc.icpIteration = state.currentIteration;
         sc.guessRelativePose.emplace(state.currentSolution.optimalPose);
+        sc.dofMask = dofMask;
+        sc.se2     = result.se2Mode;
+
+        // Optionally, only feed the solvers with the pairings that best
+        // constrain the pose. The whole set is kept in the state, for the
+        // quality evaluators and the covariance estimation.
+        Pairings selectedPairings;
+        if (p.pairingsSelection.enabled)
+        {
+            selectedPairings = select_informative_pairings(
+                state.currentPairings, p.pairingsSelection,
+                state.currentSolution.optimalPose);
+        }
+        const Pairings& solverPairings = p.pairingsSelection.enabled
+                                             ? selectedPairings
+                                             : state.currentPairings;
 
         // Compute the optimal pose:
-        const bool solvedOk = run_solvers(
-            solvers_, state.currentPairings, state.currentSolution,
-            p.pairingsWeightParameters, sc);
+        const bool solvedOk =
+            p.compactPairings
+                ? run_solvers(
+                      solvers_, CompactPairings::FromPairings(solverPairings),
+                      state.currentSolution, p.pairingsWeightParameters, sc)
+                : run_solvers(
+                      solvers_, solverPairings, state.currentSolution,
+                      p.pairingsWeightParameters, sc);
 
         if (!solvedOk)
         {
             result.terminationReason = IterTermReason::SolverError;
             break;
         }
+        isExtrapolated = false;
 
         // Updated solution is already in "state.currentSolution".
 
         // Termination criterion: small delta:
-        const auto deltaSol = state.currentSolution.optimalPose - prev_solution;
-        const mrpt::math::CVectorFixed<double, 6> dSol =
-            mrpt::poses::Lie::SE<3>::log(deltaSol);
-        const double delta_xyz = dSol.blockCopy<3, 1>(0, 0).norm();
-        const double delta_rot = dSol.blockCopy<3, 1>(3, 0).norm();
+        const RigidTransform3d curTf(state.currentSolution.optimalPose);
+        const auto             dSol =
+            (RigidTransform3d(prev_solution).inverse() * curTf).log();
+        const double delta_xyz = dSol.head<3>().norm();
+        const double delta_rot = dSol.tail<3>().norm();
 
 #if 0
         std::cout << "Dxyz: " << std::abs(delta_xyz)
@@ -107,12 +197,44 @@ void ICP::align(
             break;
         }
 
-        prev_solution = state.currentSolution.optimalPose;
+        if (useAnderson)
+        {
+            lastPlainPose = state.currentSolution.optimalPose;
+
+            const auto u =
+                (initialTfInv * RigidTransform3d(prev_solution)).log();
+            const auto g = (initialTfInv * curTf).log();
+
+            const auto next = anderson.compute(u, g);
+
+            state.currentSolution.optimalPose = dofMask.project(
+                (initialTf * RigidTransform3d::exp(next)).asCPose3D(),
+                lastPlainPose);
+            isExtrapolated = true;
+        }
     }
 
     if (result.nIterations >= p.maxIterations)
         result.terminationReason = IterTermReason::MaxIterations;
 
+    // Whatever the termination reason, do not return an extrapolated pose
+    // that was never evaluated, nor pairings matched at a rejected one:
+    if (isExtrapolated)
+    {
+        state.currentSolution.optimalPose = lastPlainPose;
+        stalePairings                     = true;
+    }
+    if (stalePairings)
+    {
+        MatchContext mc;
+        mc.icpIteration = result.nIterations;
+        mc.se2          = result.se2Mode;
+
+        state.currentPairings = run_matchers(
+            matchers_, state.pc1, state.pc2, state.currentSolution.optimalPose,
+            mc, p.maxParallelMatchers);
+    }
+
     // Quality:
     result.quality = evaluate_quality(
         quality_evaluators_, pcs1, pcs2, state.currentSolution.optimalPose,
@@ -125,6 +247,7 @@ void ICP::align(
 
     // Covariance:
     mp2p_icp::CovarianceParameters covParams;
+    covParams.dofMask = dofMask;
 
     result.optimal_tf.cov = mp2p_icp::covariance(
         result.finalPairings, result.optimal_tf.mean, covParams);
@@ -132,24 +255,72 @@ void ICP::align(
     MRPT_END
 }
 
+void ICP::align(
+    const pointcloud_t& pc1, const pointcloud_t& pc2,
+    const mrpt::math::TPose2D& initialGuessM2wrtM1, const Parameters& p,
+    Results& result)
+{
+    align(
+        pc1, pc2,
+        mrpt::math::TPose3D(
+            initialGuessM2wrtM1.x, initialGuessM2wrtM1.y, 0,
+            initialGuessM2wrtM1.phi, 0, 0),
+        p, result);
+}
+
 Pairings ICP::run_matchers(
     const matcher_list_t& matchers, const pointcloud_t& pc1,
     const pointcloud_t& pc2, const mrpt::poses::CPose3D& pc2_wrt_pc1,
-    const MatchContext& mc)
+    const MatchContext& mc, const std::size_t maxThreads)
 {
-    Pairings pairings;
-    for (const auto& matcher : matchers)
+    for (const auto& matcher : matchers) ASSERT_(matcher);
+
+    const std::size_t hwThreads =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+    std::size_t nThreads = maxThreads != 0 ? maxThreads : hwThreads;
+    nThreads             = std::min(nThreads, matchers.size());
+
+    // KD-trees and bounding boxes of global layers are built lazily on their
+    // first query, which is not thread-safe, and layers may be matched from
+    // several threads (concurrent matchers, or matchers sharing a layer
+    // across layer names): build them all before dispatching the matchers.
+    // Matchers would build them anyway, for the layers they match.
+    build_kdtrees(pc1, mc.se2);
+
+    MatchContext matcherContext = mc;
+    if (nThreads > 1)
     {
-        ASSERT_(matcher);
-        Pairings pc;
-        matcher->match(pc1, pc2, pc2_wrt_pc1, mc, pc);
-        pairings.push_back(pc);
+        // Some matchers also query local layers:
+        build_kdtrees(pc2, mc.se2);
+
+        // Share the hardware threads among the concurrent matchers:
+        const auto perMatcher = static_cast<uint32_t>(
+            std::max<std::size_t>(1, hwThreads / nThreads));
+        if (matcherContext.maxThreads == 0 ||
+            matcherContext.maxThreads > perMatcher)
+            matcherContext.maxThreads = perMatcher;
     }
+
+    // Each matcher writes to its own output:
+    std::vector<Pairings> results(matchers.size());
+
+    run_in_parallel(matchers.size(), nThreads, [&](const std::size_t i) {
+        matchers[i]->match(pc1, pc2, pc2_wrt_pc1, matcherContext, results[i]);
+    });
+
+    // Merge in configuration order:
+    Pairings pairings;
+    for (auto& r : results) pairings.push_back(std::move(r));
+
     return pairings;
 }
 
-bool ICP::run_solvers(
-    const solver_list_t& solvers, const Pairings& pairings,
+namespace
+{
+template <class PAIRINGS>
+bool run_solvers_impl(
+    const ICP::solver_list_t& solvers, const PAIRINGS& pairings,
     OptimalTF_Result& out, const WeightParameters& wp, const SolverContext& sc)
 {
     for (const auto& solver : solvers)
@@ -159,6 +330,21 @@ bool ICP::run_solvers(
     }
     return false;
 }
+}  // namespace
+
+bool ICP::run_solvers(
+    const solver_list_t& solvers, const Pairings& pairings,
+    OptimalTF_Result& out, const WeightParameters& wp, const SolverContext& sc)
+{
+    return run_solvers_impl(solvers, pairings, out, wp, sc);
+}
+
+bool ICP::run_solvers(
+    const solver_list_t& solvers, const CompactPairings& pairings,
+    OptimalTF_Result& out, const WeightParameters& wp, const SolverContext& sc)
+{
+    return run_solvers_impl(solvers, pairings, out, wp, sc);
+}
 
 void ICP::initialize_solvers(const mrpt::containers::yaml& params)
 {
@@ -0,0 +1,388 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   MappedPointCloud.cpp
+ * @brief  Memory-mapped, columnar on-disk format for pointcloud_t
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/MappedPointCloud.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/rtti/CObject.h>
+
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#define MP2P_HAS_MMAP 0
+#else
+#define MP2P_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace mp2p_icp;
+
+namespace
+{
+constexpr uint64_t kBlockAlignment = 4096;
+constexpr uint32_t kFormatVersion  = 1;
+constexpr uint32_t kEndiannessMark = 0x01020304;
+constexpr char     kMagic[8]       = {'M', 'P', '2', 'P', 'C', 'O', 'L', '\0'};
+
+constexpr std::size_t kNameLength   = 64;
+constexpr std::size_t kPlaneDoubles = 7;
+constexpr std::size_t kLineDoubles  = 6;
+
+struct FileHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endiannessMark;
+    uint64_t fileSize;
+    uint64_t nLayers, nPlanes, nLines;
+    uint64_t planesOffset, linesOffset;
+};
+
+struct LayerEntry
+{
+    char     name[kNameLength];
+    char     className[kNameLength];
+    uint64_t nPoints;
+    uint64_t offsetX, offsetY, offsetZ;
+};
+
+static_assert(sizeof(FileHeader) == 64, "Unexpected padding in FileHeader");
+static_assert(sizeof(LayerEntry) == 160, "Unexpected padding in LayerEntry");
+
+uint64_t align_block(const uint64_t offset)
+{
+    return (offset + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+}
+
+void copy_name(const std::string& s, char (&out)[kNameLength])
+{
+    ASSERTMSG_(
+        s.size() < kNameLength,
+        mrpt::format("Name too long for the columnar format: '%s'", s.c_str()));
+    std::memset(out, 0, kNameLength);
+    std::memcpy(out, s.data(), s.size());
+}
+
+std::string read_name(const char (&in)[kNameLength])
+{
+    ASSERTMSG_(
+        std::memchr(in, '\0', kNameLength) != nullptr,
+        "Corrupted columnar file: unterminated name");
+    return std::string(in);
+}
+
+// Writes `n` bytes at `offset`, zero-padding the gap from the current
+// position:
+void write_at(
+    std::ofstream& f, const uint64_t offset, const void* data,
+    const std::size_t n)
+{
+    const auto pos = static_cast<uint64_t>(f.tellp());
+    ASSERT_LE_(pos, offset);
+    const std::vector<char> padding(offset - pos, 0);
+    f.write(padding.data(), padding.size());
+    f.write(reinterpret_cast<const char*>(data), n);
+}
+
+}  // namespace
+
+void mp2p_icp::save_columnar(
+    const pointcloud_t& pc, const std::string& fileName)
+{
+    MRPT_START
+
+    // Refuse, rather than silently drop, what the format cannot represent:
+    ASSERTMSG_(
+        pc.external_layers.empty(),
+        "save_columnar(): external layers are not supported. Copy them into "
+        "`point_layers` first.");
+    ASSERTMSG_(
+        pc.quantized_layers.empty(),
+        "save_columnar(): quantized layers are not supported. Decode them "
+        "into `point_layers` first.");
+    ASSERTMSG_(
+        pc.layer_normals.empty(),
+        "save_columnar(): layer normals are not supported.");
+
+    // Layout:
+    FileHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version        = kFormatVersion;
+    header.endiannessMark = kEndiannessMark;
+    header.nLayers        = pc.point_layers.size();
+    header.nPlanes        = pc.planes.size();
+    header.nLines         = pc.lines.size();
+
+    std::vector<LayerEntry> entries;
+    uint64_t offset = sizeof(FileHeader) + header.nLayers * sizeof(LayerEntry);
+
+    const auto addBlock = [&offset](const uint64_t bytes) {
+        offset             = align_block(offset);
+        const uint64_t ret = offset;
+        offset += bytes;
+        return ret;
+    };
+
+    for (const auto& [name, pts] : pc.point_layers)
+    {
+        ASSERT_(pts);
+        LayerEntry& e = entries.emplace_back();
+        copy_name(name, e.name);
+        copy_name(pts->GetRuntimeClass()->className, e.className);
+
+        const uint64_t bytes = pts->size() * sizeof(float);
+        e.nPoints            = pts->size();
+        e.offsetX            = addBlock(bytes);
+        e.offsetY            = addBlock(bytes);
+        e.offsetZ            = addBlock(bytes);
+    }
+    header.planesOffset =
+        addBlock(header.nPlanes * kPlaneDoubles * sizeof(double));
+    header.linesOffset =
+        addBlock(header.nLines * kLineDoubles * sizeof(double));
+    header.fileSize = offset;
+
+    // Contents:
+    std::vector<double> planes;
+    planes.reserve(header.nPlanes * kPlaneDoubles);
+    for (const auto& p : pc.planes)
+    {
+        planes.insert(planes.end(), p.plane.coefs.begin(), p.plane.coefs.end());
+        planes.insert(planes.end(), {p.centroid.x, p.centroid.y, p.centroid.z});
+    }
+
+    std::vector<double> lines;
+    lines.reserve(header.nLines * kLineDoubles);
+    for (const auto& l : pc.lines)
+    {
+        lines.insert(lines.end(), {l.pBase.x, l.pBase.y, l.pBase.z});
+        lines.insert(lines.end(), l.director.begin(), l.director.end());
+    }
+
+    std::ofstream f(fileName, std::ios::binary | std::ios::trunc);
+    ASSERTMSG_(
+        f.is_open(),
+        mrpt::format("Cannot create file: '%s'", fileName.c_str()));
+
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(
+        reinterpret_cast<const char*>(entries.data()),
+        entries.size() * sizeof(LayerEntry));
+
+    std::size_t i = 0;
+    for (const auto& layer : pc.point_layers)
+    {
+        const auto& pts = *layer.second;
+        const auto& e   = entries[i++];
+        const auto  n   = e.nPoints * sizeof(float);
+        write_at(f, e.offsetX, pts.getPointsBufferRef_x().data(), n);
+        write_at(f, e.offsetY, pts.getPointsBufferRef_y().data(), n);
+        write_at(f, e.offsetZ, pts.getPointsBufferRef_z().data(), n);
+    }
+    write_at(
+        f, header.planesOffset, planes.data(), planes.size() * sizeof(double));
+    write_at(
+        f, header.linesOffset, lines.data(), lines.size() * sizeof(double));
+
+    ASSERTMSG_(
+        f.good() && static_cast<uint64_t>(f.tellp()) == header.fileSize,
+        mrpt::format("Error writing to file: '%s'", fileName.c_str()));
+
+    MRPT_END
+}
+
+MappedPointCloud::MappedPointCloud(const std::string& fileName)
+{
+    MRPT_START
+
+#if MP2P_HAS_MMAP
+    const int fd = ::open(fileName.c_str(), O_RDONLY);
+    ASSERTMSG_(
+        fd >= 0, mrpt::format("Cannot open file: '%s'", fileName.c_str()));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(FileHeader))
+    {
+        ::close(fd);
+        THROW_EXCEPTION_FMT(
+            "Not a columnar point cloud file: '%s'", fileName.c_str());
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    ASSERTMSG_(
+        addr != MAP_FAILED,
+        mrpt::format("Cannot map file: '%s'", fileName.c_str()));
+    data_ = static_cast<const uint8_t*>(addr);
+#else
+    std::ifstream f(fileName, std::ios::binary | std::ios::ate);
+    ASSERTMSG_(
+        f.is_open(), mrpt::format("Cannot open file: '%s'", fileName.c_str()));
+    buffer_.resize(static_cast<std::size_t>(f.tellg()));
+    f.seekg(0);
+    f.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size());
+    ASSERTMSG_(
+        buffer_.size() >= sizeof(FileHeader),
+        mrpt::format(
+            "Not a columnar point cloud file: '%s'", fileName.c_str()));
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+
+    try
+    {
+        FileHeader header;
+        std::memcpy(&header, data_, sizeof(header));
+
+        ASSERTMSG_(
+            std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0,
+            "Not a columnar point cloud file");
+        ASSERTMSG_(
+            header.endiannessMark == kEndiannessMark,
+            "Columnar file saved with a different byte order");
+        ASSERTMSG_(
+            header.version >= 1 && header.version <= kFormatVersion,
+            mrpt::format(
+                "Unsupported columnar file version: %u",
+                static_cast<unsigned>(header.version)));
+        ASSERT_EQUAL_(header.fileSize, size_);
+
+        // Checks that a block of `count` elements lies within the file:
+        const auto block = [this](
+                               const uint64_t offset, const uint64_t count,
+                               const std::size_t elementSize) {
+            ASSERT_EQUAL_(offset % kBlockAlignment, 0U);
+            ASSERT_LE_(offset, size_);
+            ASSERT_LE_(count, (size_ - offset) / elementSize);
+            return data_ + offset;
+        };
+
+        ASSERT_LE_(
+            header.nLayers,
+            (size_ - sizeof(FileHeader)) / sizeof(LayerEntry));
+        const auto* entries = data_ + sizeof(FileHeader);
+
+        for (uint64_t i = 0; i < header.nLayers; i++)
+        {
+            LayerEntry e;
+            std::memcpy(&e, entries + i * sizeof(LayerEntry), sizeof(e));
+
+            Layer& l    = layers_.emplace_back();
+            l.name      = read_name(e.name);
+            l.className = read_name(e.className);
+            l.size      = e.nPoints;
+            l.x = reinterpret_cast<const float*>(
+                block(e.offsetX, e.nPoints, sizeof(float)));
+            l.y = reinterpret_cast<const float*>(
+                block(e.offsetY, e.nPoints, sizeof(float)));
+            l.z = reinterpret_cast<const float*>(
+                block(e.offsetZ, e.nPoints, sizeof(float)));
+        }
+
+        nPlanes_ = header.nPlanes;
+        planes_  = reinterpret_cast<const double*>(block(
+            header.planesOffset, header.nPlanes,
+            kPlaneDoubles * sizeof(double)));
+        nLines_  = header.nLines;
+        lines_   = reinterpret_cast<const double*>(block(
+            header.linesOffset, header.nLines, kLineDoubles * sizeof(double)));
+    }
+    catch (const std::exception& e)
+    {
+#if MP2P_HAS_MMAP
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+        THROW_EXCEPTION_FMT(
+            "Error opening columnar file '%s':\n%s", fileName.c_str(),
+            mrpt::exception_to_str(e).c_str());
+    }
+
+    MRPT_END
+}
+
+MappedPointCloud::~MappedPointCloud()
+{
+#if MP2P_HAS_MMAP
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+}
+
+const MappedPointCloud::Layer* MappedPointCloud::layer(
+    const std::string& name) const
+{
+    for (const auto& l : layers_)
+        if (l.name == name) return &l;
+    return nullptr;
+}
+
+plane_patch_t MappedPointCloud::plane(const std::size_t i) const
+{
+    ASSERT_LT_(i, nPlanes_);
+    const double* d = planes_ + i * kPlaneDoubles;
+
+    plane_patch_t p;
+    for (int k = 0; k < 4; k++) p.plane.coefs[k] = d[k];
+    p.centroid = mrpt::math::TPoint3D(d[4], d[5], d[6]);
+    return p;
+}
+
+mrpt::math::TLine3D MappedPointCloud::line(const std::size_t i) const
+{
+    ASSERT_LT_(i, nLines_);
+    const double* d = lines_ + i * kLineDoubles;
+
+    mrpt::math::TLine3D l;
+    l.pBase = mrpt::math::TPoint3D(d[0], d[1], d[2]);
+    for (int k = 0; k < 3; k++) l.director[k] = d[3 + k];
+    return l;
+}
+
+pointcloud_t MappedPointCloud::toPointCloud() const
+{
+    MRPT_START
+
+    pointcloud_t pc;
+
+    for (const auto& l : layers_)
+    {
+        mrpt::maps::CPointsMap::Ptr pts;
+        if (mrpt::rtti::findRegisteredClass(l.className))
+        {
+            pts = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+                mrpt::rtti::classFactory(l.className));
+        }
+        if (!pts) pts = mrpt::maps::CSimplePointsMap::Create();
+
+        pts->reserve(l.size);
+        for (std::size_t i = 0; i < l.size; i++)
+            pts->insertPointFast(l.x[i], l.y[i], l.z[i]);
+        pts->mark_as_modified();
+
+        pc.point_layers[l.name] = pts;
+    }
+
+    pc.planes.reserve(nPlanes_);
+    for (std::size_t i = 0; i < nPlanes_; i++) pc.planes.push_back(plane(i));
+
+    pc.lines.reserve(nLines_);
+    for (std::size_t i = 0; i < nLines_; i++) pc.lines.push_back(line(i));
+
+    return pc;
+
+    MRPT_END
+}
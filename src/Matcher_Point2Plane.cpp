@@ -34,9 +34,9 @@ void Matcher_Point2Plane::initialize(const mrpt::containers::yaml& params)
 }
 
 void Matcher_Point2Plane::implMatchOneLayer(
-    const mrpt::maps::CPointsMap& pcGlobal,
-    const mrpt::maps::CPointsMap& pcLocal,
-    const mrpt::poses::CPose3D& localPose, Pairings& out) const
+    const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+    const mrpt::poses::CPose3D& localPose,
+    [[maybe_unused]] const MatchContext& mc, Pairings& out) const
 {
     MRPT_START
 
@@ -49,8 +49,8 @@ void Matcher_Point2Plane::implMatchOneLayer(
         globalMin.x, globalMax.x, globalMin.y, globalMax.y, globalMin.z,
         globalMax.z);
 
-    const TransformedLocalPointCloud tl = transform_local_to_global(
-        pcLocal, localPose, maxLocalPointsPerLayer_, localPointsSampleSeed_);
+    const TransformedLocalPointCloud tl =
+        sampleAndTransformLocal(pcLocal, localPose);
 
     // No need to compute: Is matching = null?
     if (tl.localMin.x > globalMax.x || tl.localMax.x < globalMin.x ||
@@ -69,10 +69,6 @@ void Matcher_Point2Plane::implMatchOneLayer(
     const auto& gys = pcGlobal.getPointsBufferRef_y();
     const auto& gzs = pcGlobal.getPointsBufferRef_z();
 
-    const auto& lxs = pcLocal.getPointsBufferRef_x();
-    const auto& lys = pcLocal.getPointsBufferRef_y();
-    const auto& lzs = pcLocal.getPointsBufferRef_z();
-
     std::vector<float>  kddSqrDist;
     std::vector<size_t> kddIdxs;
 
@@ -133,7 +129,8 @@ void Matcher_Point2Plane::implMatchOneLayer(
         if (eig.eigVals[0] > planeEigenThreshold * eig.eigVals[2]) continue;
 
         auto& p            = out.paired_pt2pl.emplace_back();
-        p.pt_other         = {lxs[localIdx], lys[localIdx], lzs[localIdx]};
+        p.pt_other         = {
+            pcLocal.x(localIdx), pcLocal.y(localIdx), pcLocal.z(localIdx)};
         p.pl_this.centroid = {eig.meanCov.mean.x(), eig.meanCov.mean.y(),
                               eig.meanCov.mean.z()};
 
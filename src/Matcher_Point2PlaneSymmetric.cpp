@@ -0,0 +1,298 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Matcher_Point2PlaneSymmetric.cpp
+ * @brief  Pointcloud matcher: nearest points, with normals on both clouds
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/Matcher_Point2PlaneSymmetric.h>
+#include <mp2p_icp/estimate_points_eigen.h>
+#include <mrpt/core/exceptions.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "build_kdtrees.h"
+
+IMPLEMENTS_MRPT_OBJECT(Matcher_Point2PlaneSymmetric, Matcher, mp2p_icp)
+
+using namespace mp2p_icp;
+
+Matcher_Point2PlaneSymmetric::Matcher_Point2PlaneSymmetric()
+{
+    mrpt::system::COutputLogger::setLoggerName("Matcher_Point2PlaneSymmetric");
+}
+
+void Matcher_Point2PlaneSymmetric::initialize(
+    const mrpt::containers::yaml& params)
+{
+    Matcher_Points_Base::initialize(params);
+
+    MCP_LOAD_REQ(params, distanceThreshold);
+    MCP_LOAD_REQ(params, knn);
+    MCP_LOAD_REQ(params, planeEigenThreshold);
+}
+
+void Matcher_Point2PlaneSymmetric::match(
+    const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal,
+    const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+    Pairings& out) const
+{
+    // A new alignment starts: the point clouds may have changed.
+    if (mc.icpIteration == 0)
+    {
+        std::lock_guard<copyable_mutex_t> lck(normalsMtx_);
+        normals_.clear();
+        precomputedNormals_.clear();
+        externalLocalCopies_.clear();
+
+        // Reuse normals precomputed with estimate_normals(), if any. They are
+        // only referenced here, and read in place while matching:
+        for (const auto* pc : {&pcGlobal, &pcLocal})
+        {
+            for (const auto& [name, pts] : pc->point_layers)
+            {
+                if (auto pn = pc->normalsOf(name); pn)
+                    precomputedNormals_[pts.get()] = std::move(pn);
+            }
+        }
+    }
+
+    // Local layers may be matched against several global layers, from
+    // different threads, and may even be global layers themselves: build
+    // their KD-trees beforehand.
+    if (maxLayerMatchingThreads_ != 1 && mc.maxThreads != 1)
+    {
+        build_kdtrees(pcGlobal, false);
+        build_kdtrees(pcLocal, false);
+    }
+
+    Matcher_Points_Base::match(pcGlobal, pcLocal, localPose, mc, out);
+}
+
+const mrpt::maps::CPointsMap& Matcher_Point2PlaneSymmetric::localPointsMap(
+    const PointsView& pcLocal) const
+{
+    if (pcLocal.pointsMap()) return *pcLocal.pointsMap();
+
+    std::lock_guard<copyable_mutex_t> lck(normalsMtx_);
+
+    auto& pts = externalLocalCopies_[pcLocal.xs()];
+    if (!pts || pts->size() != pcLocal.size())
+    {
+        if (pts) normals_.erase(pts.get());
+        pts = pcLocal.toPointsMap();
+        build_kdtree(*pts, false);
+    }
+    return *pts;
+}
+
+Matcher_Point2PlaneSymmetric::LayerNormals&
+    Matcher_Point2PlaneSymmetric::layerNormals(
+        const mrpt::maps::CPointsMap& pc) const
+{
+    std::lock_guard<copyable_mutex_t> lck(normalsMtx_);
+
+    auto& ln = normals_[&pc];
+    if (ln.nPoints != pc.size())
+    {
+        ln.nPoints = pc.size();
+        ln.state.assign(ln.nPoints, LayerNormals::AtomicState());
+        ln.normals.resize(ln.nPoints);
+    }
+    return ln;
+}
+
+bool Matcher_Point2PlaneSymmetric::fitNormal(
+    const mrpt::maps::CPointsMap& pc, const std::size_t idx,
+    mrpt::math::TVector3Df& normal) const
+{
+    const auto& xs = pc.getPointsBufferRef_x();
+    const auto& ys = pc.getPointsBufferRef_y();
+    const auto& zs = pc.getPointsBufferRef_z();
+
+    std::vector<float>  kddSqrDist;
+    std::vector<size_t> kddIdxs;
+    pc.kdTreeNClosestPoint3DIdx(
+        xs[idx], ys[idx], zs[idx], knn, kddIdxs, kddSqrDist);
+
+    // Filter the list of neighbors by maximum distance threshold:
+    const float maxDistSqr = mrpt::square(distanceThreshold);
+    for (size_t j = 0; j < kddSqrDist.size(); j++)
+    {
+        if (kddSqrDist[j] > maxDistSqr)
+        {
+            kddIdxs.resize(j);
+            break;
+        }
+    }
+
+    // minimum: 3 points to be able to fit a plane
+    if (kddIdxs.size() < 3) return false;
+
+    const PointCloudEigen& eig = mp2p_icp::estimate_points_eigen(
+        xs.data(), ys.data(), zs.data(), kddIdxs);
+
+    // e0/e2 must be < planeEigenThreshold:
+    if (eig.eigVals[0] > planeEigenThreshold * eig.eigVals[2]) return false;
+
+    const auto& n = eig.eigVectors[0];
+    normal        = {static_cast<float>(n.x), static_cast<float>(n.y),
+              static_cast<float>(n.z)};
+    return true;
+}
+
+bool Matcher_Point2PlaneSymmetric::pointNormal(
+    const mrpt::maps::CPointsMap& pc, LayerNormals& ln, const std::size_t idx,
+    mrpt::math::TVector3Df& normal) const
+{
+    using State = LayerNormals::State;
+
+    auto&       st = ln.state.at(idx).value;
+    const State s  = st.load(std::memory_order_acquire);
+    if (s == State::Valid)
+    {
+        normal = ln.normals[idx];
+        return true;
+    }
+    if (s == State::NotPlanar) return false;
+
+    // Not known yet. The first thread to get here stores the result; any
+    // other one doing so meanwhile fits the normal too, without storing it:
+    State      expected = State::Unknown;
+    const bool store =
+        s == State::Unknown &&
+        st.compare_exchange_strong(expected, State::Computing);
+
+    const bool planar = fitNormal(pc, idx, normal);
+    if (store)
+    {
+        if (planar) ln.normals[idx] = normal;
+        st.store(
+            planar ? State::Valid : State::NotPlanar,
+            std::memory_order_release);
+    }
+    return planar;
+}
+
+bool Matcher_Point2PlaneSymmetric::precomputedNormal(
+    const PointNormals& pn, const std::size_t idx,
+    mrpt::math::TVector3Df& normal) const
+{
+    if (!pn.valid[idx] || pn.ratio02[idx] > planeEigenThreshold) return false;
+    normal = {pn.nx[idx], pn.ny[idx], pn.nz[idx]};
+    return true;
+}
+
+PointNormals::ConstPtr Matcher_Point2PlaneSymmetric::findPrecomputedNormals(
+    const mrpt::maps::CPointsMap* pts, const std::size_t nPoints) const
+{
+    std::lock_guard<copyable_mutex_t> lck(normalsMtx_);
+
+    const auto it = precomputedNormals_.find(pts);
+    if (it == precomputedNormals_.end() || it->second->size() != nPoints)
+        return {};
+    return it->second;
+}
+
+void Matcher_Point2PlaneSymmetric::implMatchOneLayer(
+    const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+    const mrpt::poses::CPose3D& localPose,
+    [[maybe_unused]] const MatchContext& mc, Pairings& out) const
+{
+    MRPT_START
+
+    // Empty maps?  Nothing to do
+    if (pcGlobal.empty() || pcLocal.empty()) return;
+
+    // Try to do matching only if the bounding boxes have some overlap:
+    mrpt::math::TPoint3Df globalMin, globalMax;
+    pcGlobal.boundingBox(
+        globalMin.x, globalMax.x, globalMin.y, globalMax.y, globalMin.z,
+        globalMax.z);
+
+    const TransformedLocalPointCloud tl =
+        sampleAndTransformLocal(pcLocal, localPose);
+
+    // No need to compute: Is matching = null?
+    if (tl.localMin.x > globalMax.x || tl.localMax.x < globalMin.x ||
+        tl.localMin.y > globalMax.y || tl.localMax.y < globalMin.y)
+        return;
+
+    // Prepare output: no correspondences initially:
+    out.paired_pt2pl_sym.reserve(
+        out.paired_pt2pl_sym.size() + tl.x_locals.size() / 2);
+
+    // Loop for each point in local map:
+    // --------------------------------------------------
+    const float maxDistForCorrespondenceSquared =
+        mrpt::square(distanceThreshold);
+
+    // Local normals are fit with a KD-tree, so external layers need a copy:
+    const mrpt::maps::CPointsMap& localPts = localPointsMap(pcLocal);
+
+    // Normals of both layers: precomputed ones, or cached, per layer, as
+    // they are fit. A local layer matched against several global layers
+    // shares its cache among them.
+    const PointNormals::ConstPtr glPrecomputed =
+        findPrecomputedNormals(&pcGlobal, pcGlobal.size());
+    LayerNormals* glNormals = nullptr;
+    if (!glPrecomputed) glNormals = &layerNormals(pcGlobal);
+
+    const PointNormals::ConstPtr lcPrecomputed =
+        findPrecomputedNormals(&localPts, localPts.size());
+    LayerNormals* lcNormals = nullptr;
+    if (!lcPrecomputed) lcNormals = &layerNormals(localPts);
+
+    const auto& gxs = pcGlobal.getPointsBufferRef_x();
+    const auto& gys = pcGlobal.getPointsBufferRef_y();
+    const auto& gzs = pcGlobal.getPointsBufferRef_z();
+
+    for (size_t i = 0; i < tl.x_locals.size(); i++)
+    {
+        size_t localIdx = tl.idxs.has_value() ? (*tl.idxs)[i] : i;
+
+        // For speed-up:
+        const float lx = tl.x_locals[i], ly = tl.y_locals[i],
+                    lz = tl.z_locals[i];
+
+        float        sqrDist;
+        const size_t globalIdx =
+            pcGlobal.kdTreeClosestPoint3D(lx, ly, lz, sqrDist);
+        if (sqrDist > maxDistForCorrespondenceSquared) continue;
+
+        mrpt::math::TVector3Df nGlobal, nLocal;
+        if (glPrecomputed
+                ? !precomputedNormal(*glPrecomputed, globalIdx, nGlobal)
+                : !pointNormal(pcGlobal, *glNormals, globalIdx, nGlobal))
+            continue;
+        if (lcPrecomputed
+                ? !precomputedNormal(*lcPrecomputed, localIdx, nLocal)
+                : !pointNormal(localPts, *lcNormals, localIdx, nLocal))
+            continue;
+
+        // Normals are only defined up to their sign: orient the local one
+        // like the global one, at the current relative pose, so they add up:
+        const auto nLocalRot =
+            localPose.rotateVector(mrpt::math::TVector3D(nLocal));
+        const double dot = nLocalRot.x * nGlobal.x + nLocalRot.y * nGlobal.y +
+                           nLocalRot.z * nGlobal.z;
+        if (dot < 0) nLocal *= -1.0f;
+
+        out.paired_pt2pl_sym.emplace_back(
+            mrpt::math::TPoint3Df(gxs[globalIdx], gys[globalIdx],
+                                  gzs[globalIdx]),
+            nGlobal,
+            mrpt::math::TPoint3Df(
+                pcLocal.x(localIdx), pcLocal.y(localIdx), pcLocal.z(localIdx)),
+            nLocal);
+
+    }  // For each local point
+
+    MRPT_END
+}
@@ -11,23 +11,152 @@
  */
 
 #include <mp2p_icp/Matcher_Points_Base.h>
+#include <mp2p_icp/morton_order.h>
+
+#include "RigidTransform3.h"
+#include "run_in_parallel.h"
 
 #include <chrono>
+#include <cmath>
 #include <numeric>  // iota
 #include <random>
+#include <unordered_map>
 
 using namespace mp2p_icp;
 
 void Matcher_Points_Base::impl_match(
     const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal,
-    const mrpt::poses::CPose3D&          localPose,
-    [[maybe_unused]] const MatchContext& mc, Pairings& out) const
+    const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+    Pairings& out) const
 {
     MRPT_START
 
     out = Pairings();
 
-    // Analyze point cloud layers, one by one:
+    // A new alignment starts: drop local point samples from the former one,
+    // and resolve the layers to match:
+    std::shared_ptr<const LayerPairingPlan> plan;
+    if (mc.icpIteration == 0)
+    {
+        {
+            std::lock_guard<copyable_mutex_t> lck(cachedLocalSamplesMtx_);
+            cachedLocalSamples_.clear();
+        }
+        plan = buildLayerPairingPlan(pcGlobal, pcLocal);
+
+        std::lock_guard<copyable_mutex_t> lck(planMtx_);
+        plan_ = plan;
+    }
+    else
+    {
+        {
+            std::lock_guard<copyable_mutex_t> lck(planMtx_);
+            plan = plan_;
+        }
+        // Not called from ICP, or with other point clouds or layers:
+        if (!plan || !plan->isValidFor(pcGlobal, pcLocal))
+            plan = buildLayerPairingPlan(pcGlobal, pcLocal);
+    }
+
+    const auto& tasks  = plan->tasks;
+    const auto& groups = plan->groups;
+
+    // Each task writes to its own output:
+    std::vector<Pairings> results(tasks.size());
+
+    // Capped by the caller, if other matchers run concurrently:
+    std::size_t nThreads = maxLayerMatchingThreads_;
+    if (mc.maxThreads != 0 && (nThreads == 0 || nThreads > mc.maxThreads))
+        nThreads = mc.maxThreads;
+
+    run_in_parallel(groups.size(), nThreads, [&](const std::size_t g) {
+        for (const std::size_t i : groups[g])
+        {
+            const auto& t   = tasks[i];
+            auto&       res = results[i];
+
+            implMatchOneLayer(*t.glLayer, t.lcLayer, localPose, mc, res);
+
+            if (t.weight)
+            {
+                res.weights.pt2pt.assign(
+                    res.paired_pt2pt.size(), t.weight.value());
+            }
+        }
+    });
+
+    // Merge in deterministic layer order. Pairings::push_back() also merges
+    // the individual point weights:
+    for (auto& res : results) out.push_back(std::move(res));
+
+    MRPT_END
+}
+
+namespace
+{
+// Invokes `f(name, view)` for all point layers of `pc`, then for all its
+// external layers. Returns false as soon as `f` does.
+template <class FUNCTOR>
+bool forEachLayer(const pointcloud_t& pc, FUNCTOR f)
+{
+    for (const auto& kv : pc.point_layers)
+    {
+        if (!kv.second) return false;
+        if (!f(kv.first, PointsView::FromPointsMap(*kv.second))) return false;
+    }
+    for (const auto& kv : pc.external_layers)
+        if (!f(kv.first, kv.second)) return false;
+    return true;
+}
+
+// Fills `ids` (a vector of LayerPairingPlan::LayerId) with the identity of
+// all layers of `pc`:
+template <class LAYER_IDS>
+void fillLayerIds(const pointcloud_t& pc, LAYER_IDS& ids)
+{
+    ids.clear();
+    forEachLayer(pc, [&](const std::string& name, const PointsView& v) {
+        ids.push_back({&name, v.xs(), v.size()});
+        return true;
+    });
+}
+
+// Only compares addresses and sizes, since it runs at each ICP iteration.
+// A renamed layer is a new map entry, hence its name has a new address.
+template <class LAYER_IDS>
+bool sameLayers(const LAYER_IDS& ids, const pointcloud_t& pc)
+{
+    if (ids.size() != pc.point_layers.size() + pc.external_layers.size())
+        return false;
+
+    auto it = ids.begin();
+    return forEachLayer(pc, [&](const std::string& name, const PointsView& v) {
+        const auto& id = *(it++);
+        return id.name == &name && id.xs == v.xs() && id.size == v.size();
+    });
+}
+}  // namespace
+
+bool Matcher_Points_Base::LayerPairingPlan::isValidFor(
+    const pointcloud_t& pcGlobal_, const pointcloud_t& pcLocal_) const
+{
+    return pcGlobal == &pcGlobal_ && pcLocal == &pcLocal_ &&
+           sameLayers(globalLayers, pcGlobal_) &&
+           sameLayers(localLayers, pcLocal_);
+}
+
+std::shared_ptr<const Matcher_Points_Base::LayerPairingPlan>
+    Matcher_Points_Base::buildLayerPairingPlan(
+        const pointcloud_t& pcGlobal, const pointcloud_t& pcLocal) const
+{
+    MRPT_START
+
+    auto plan      = std::make_shared<LayerPairingPlan>();
+    plan->pcGlobal = &pcGlobal;
+    plan->pcLocal  = &pcLocal;
+    fillLayerIds(pcGlobal, plan->globalLayers);
+    fillLayerIds(pcLocal, plan->localLayers);
+
     for (const auto& glLayerKV : pcGlobal.point_layers)
     {
         const auto& glLayerName = glLayerKV.first;
@@ -56,8 +185,8 @@ void Matcher_Points_Base::impl_match(
             const bool  hasWeight      = localWeight.second.has_value();
 
             // Look for a matching layer in "local":
-            auto itLocal = pcLocal.point_layers.find(localLayerName);
-            if (itLocal == pcLocal.point_layers.end())
+            const auto lcLayer = pcLocal.layerView(localLayerName);
+            if (!lcLayer)
             {
                 // Silently ignore it:
                 if (!hasWeight)
@@ -70,24 +199,32 @@ void Matcher_Points_Base::impl_match(
             }
 
             const mrpt::maps::CPointsMap::Ptr& glLayer = glLayerKV.second;
-            const mrpt::maps::CPointsMap::Ptr& lcLayer = itLocal->second;
-
             ASSERT_(glLayer);
-            ASSERT_(lcLayer);
-
-            const size_t nBefore = out.paired_pt2pt.size();
 
-            implMatchOneLayer(*glLayer, *lcLayer, localPose, out);
-
-            const size_t nAfter = out.paired_pt2pt.size();
+            plan->tasks.push_back(
+                {glLayer.get(), *lcLayer, localWeight.second});
+        }
+    }
 
-            if (hasWeight && nAfter != nBefore)
-            {
-                const double w = localWeight.second.value();
-                out.point_weights.emplace_back(nAfter - nBefore, w);
-            }
+    // KD-tree queries on one map are not thread-safe, so all tasks against
+    // the same global layer (the same layer may even be shared by several
+    // layer names) go into one group, run serially by a single thread:
+    std::map<const mrpt::maps::CPointsMap*, std::size_t> groupOfLayer;
+    for (std::size_t i = 0; i < plan->tasks.size(); i++)
+    {
+        const auto* glLayer = plan->tasks[i].glLayer;
+        const auto  it      = groupOfLayer.find(glLayer);
+        if (it != groupOfLayer.end())
+        {
+            plan->groups[it->second].push_back(i);
+            continue;
         }
+        groupOfLayer[glLayer] = plan->groups.size();
+        plan->groups.push_back({i});
     }
+
+    return plan;
+
     MRPT_END
 }
 
@@ -121,13 +258,45 @@ void Matcher_Points_Base::initialize(const mrpt::containers::yaml& params)
         params.getOrDefault("maxLocalPointsPerLayer", maxLocalPointsPerLayer_);
     localPointsSampleSeed_ =
         params.getOrDefault("localPointsSampleSeed", localPointsSampleSeed_);
+    mortonOrderLocalPoints_ =
+        params.getOrDefault("mortonOrderLocalPoints", mortonOrderLocalPoints_);
+    localPointsVoxelSize_ =
+        params.getOrDefault("localPointsVoxelSize", localPointsVoxelSize_);
+    maxLocalPointsPerVoxel_ =
+        params.getOrDefault("maxLocalPointsPerVoxel", maxLocalPointsPerVoxel_);
+    localPointsReservoirSampling_ = params.getOrDefault(
+        "localPointsReservoirSampling", localPointsReservoirSampling_);
+    cacheLocalPointsSample_ =
+        params.getOrDefault("cacheLocalPointsSample", cacheLocalPointsSample_);
+    maxLayerMatchingThreads_ = params.getOrDefault(
+        "maxLayerMatchingThreads", maxLayerMatchingThreads_);
+}
+
+Matcher_Points_Base::TransformedLocalPointCloud
+    Matcher_Points_Base::transform_local_to_global(
+        const PointsView& pcLocal, const mrpt::poses::CPose3D& localPose,
+        const std::size_t maxLocalPoints, const uint64_t localPointsSampleSeed,
+        const bool sortByMortonCode)
+{
+    MRPT_START
+
+    LocalSamplingParameters sp;
+    sp.maxLocalPoints = maxLocalPoints;
+    sp.seed           = localPointsSampleSeed;
+
+    return transform_local_to_global(
+        pcLocal, localPose, sample_local_points(pcLocal, sp),
+        sortByMortonCode);
+
+    MRPT_END
 }
 
 Matcher_Points_Base::TransformedLocalPointCloud
     Matcher_Points_Base::transform_local_to_global(
-        const mrpt::maps::CPointsMap& pcLocal,
-        const mrpt::poses::CPose3D& localPose, const std::size_t maxLocalPoints,
-        const uint64_t localPointsSampleSeed)
+        const PointsView&                       pcLocal,
+        const mrpt::poses::CPose3D&             localPose,
+        std::optional<std::vector<std::size_t>> sampleIdxs,
+        const bool                              sortByMortonCode)
 {
     MRPT_START
     TransformedLocalPointCloud r;
@@ -142,56 +311,217 @@ Matcher_Points_Base::TransformedLocalPointCloud
         mrpt::keep_min(r.localMin.z, z);
     };
 
-    const auto& lxs = pcLocal.getPointsBufferRef_x();
-    const auto& lys = pcLocal.getPointsBufferRef_y();
-    const auto& lzs = pcLocal.getPointsBufferRef_z();
-
     const size_t nLocalPoints = pcLocal.size();
 
-    if (maxLocalPoints == 0 || nLocalPoints <= maxLocalPoints)
+    // In double precision, so large translations only round the output:
+    const RigidTransform3d localTf(localPose);
+
+    if (!sampleIdxs.has_value())
     {
         // All points:
         r.x_locals.resize(nLocalPoints);
         r.y_locals.resize(nLocalPoints);
         r.z_locals.resize(nLocalPoints);
 
-        for (size_t i = 0; i < nLocalPoints; i++)
+        if (pcLocal.contiguous())
         {
-            localPose.composePoint(
-                lxs[i], lys[i], lzs[i], r.x_locals[i], r.y_locals[i],
-                r.z_locals[i]);
-            lambdaKeepBBox(r.x_locals[i], r.y_locals[i], r.z_locals[i]);
+            localTf.composePoints(
+                nLocalPoints, pcLocal.xs(), pcLocal.ys(), pcLocal.zs(),
+                r.x_locals.data(), r.y_locals.data(), r.z_locals.data());
         }
+        else
+        {
+            for (size_t i = 0; i < nLocalPoints; i++)
+                localTf.composePoint(
+                    pcLocal.x(i), pcLocal.y(i), pcLocal.z(i), r.x_locals[i],
+                    r.y_locals[i], r.z_locals[i]);
+        }
+
+        for (size_t i = 0; i < nLocalPoints; i++)
+            lambdaKeepBBox(r.x_locals[i], r.y_locals[i], r.z_locals[i]);
     }
     else
     {
-        // random subset:
-        r.idxs.emplace(maxLocalPoints);
-        std::iota(r.idxs->begin(), r.idxs->end(), 0);
+        // A subset:
+        r.idxs = std::move(sampleIdxs);
 
-        const unsigned int seed =
-            localPointsSampleSeed != 0
-                ? localPointsSampleSeed
-                : std::chrono::system_clock::now().time_since_epoch().count();
+        const size_t nSample = r.idxs->size();
+        r.x_locals.resize(nSample);
+        r.y_locals.resize(nSample);
+        r.z_locals.resize(nSample);
 
-        MRPT_TODO("Partial shuffle only?");
-        std::shuffle(
-            r.idxs->begin(), r.idxs->end(), std::default_random_engine(seed));
-
-        r.x_locals.resize(maxLocalPoints);
-        r.y_locals.resize(maxLocalPoints);
-        r.z_locals.resize(maxLocalPoints);
-
-        for (size_t ri = 0; ri < maxLocalPoints; ri++)
+        for (size_t ri = 0; ri < nSample; ri++)
         {
             const auto i = (*r.idxs)[ri];
-            localPose.composePoint(
-                lxs[i], lys[i], lzs[i], r.x_locals[ri], r.y_locals[ri],
-                r.z_locals[ri]);
+            ASSERTDEB_LT_(i, nLocalPoints);
+            localTf.composePoint(
+                pcLocal.x(i), pcLocal.y(i), pcLocal.z(i), r.x_locals[ri],
+                r.y_locals[ri], r.z_locals[ri]);
             lambdaKeepBBox(r.x_locals[ri], r.y_locals[ri], r.z_locals[ri]);
         }
     }
 
+    if (sortByMortonCode && r.x_locals.size() > 1)
+    {
+        const std::size_t              n    = r.x_locals.size();
+        const std::vector<std::size_t> perm = morton_sort_indices(
+            r.x_locals.data(), r.y_locals.data(), r.z_locals.data(), n,
+            r.localMin, r.localMax);
+
+        // Keep the mapping to the original local point indices:
+        std::vector<std::size_t> newIdxs(n);
+        for (size_t i = 0; i < n; i++)
+            newIdxs[i] = r.idxs.has_value() ? (*r.idxs)[perm[i]] : perm[i];
+        r.idxs = std::move(newIdxs);
+
+        const auto lambdaPermute = [&](mrpt::aligned_std_vector<float>& v) {
+            mrpt::aligned_std_vector<float> sorted(n);
+            for (size_t i = 0; i < n; i++) sorted[i] = v[perm[i]];
+            v = std::move(sorted);
+        };
+        lambdaPermute(r.x_locals);
+        lambdaPermute(r.y_locals);
+        lambdaPermute(r.z_locals);
+    }
+
     return r;
     MRPT_END
 }
+
+std::optional<std::vector<std::size_t>>
+    Matcher_Points_Base::sample_local_points(
+        const PointsView& pcLocal, const LocalSamplingParameters& p)
+{
+    MRPT_START
+
+    const size_t nLocalPoints = pcLocal.size();
+    const size_t maxPts       = p.maxLocalPoints;
+
+    const bool useVoxels = p.voxelSize > 0;
+
+    // All points?
+    if (!useVoxels && (maxPts == 0 || nLocalPoints <= maxPts)) return {};
+
+    const unsigned int seed =
+        p.seed != 0
+            ? p.seed
+            : std::chrono::system_clock::now().time_since_epoch().count();
+    std::default_random_engine rng(seed);
+
+    std::vector<std::size_t> idxs;
+
+    if (useVoxels)
+    {
+        // Voxel-stratified sampling: keep the first `maxPointsPerVoxel`
+        // points falling into each voxel, in one linear pass:
+        ASSERT_GT_(p.maxPointsPerVoxel, 0U);
+
+        const double invVoxelSize = 1.0 / p.voxelSize;
+
+        // 21 bits per voxel coordinate are enough for any practical scan
+        // size. Wrapped-around collisions only make the sample sparser.
+        const auto lambdaVoxelKey = [invVoxelSize](float x, float y, float z) {
+            const auto ix = static_cast<int64_t>(std::floor(x * invVoxelSize));
+            const auto iy = static_cast<int64_t>(std::floor(y * invVoxelSize));
+            const auto iz = static_cast<int64_t>(std::floor(z * invVoxelSize));
+            return (static_cast<uint64_t>(ix) & 0x1fffff) |
+                   ((static_cast<uint64_t>(iy) & 0x1fffff) << 21) |
+                   ((static_cast<uint64_t>(iz) & 0x1fffff) << 42);
+        };
+
+        std::unordered_map<uint64_t, uint32_t> voxelCounts;
+        voxelCounts.reserve(
+            maxPts != 0 ? std::min<size_t>(2 * maxPts, nLocalPoints)
+                        : nLocalPoints / 4);
+
+        for (size_t i = 0; i < nLocalPoints; i++)
+        {
+            auto& cnt = voxelCounts[lambdaVoxelKey(
+                pcLocal.x(i), pcLocal.y(i), pcLocal.z(i))];
+            if (cnt >= p.maxPointsPerVoxel) continue;
+            cnt++;
+            idxs.push_back(i);
+        }
+
+        // Still over budget? Uniform decimation of the stratified sample:
+        if (maxPts != 0 && idxs.size() > maxPts)
+        {
+            const double step = double(idxs.size()) / maxPts;
+            for (size_t i = 0; i < maxPts; i++)
+                idxs[i] = idxs[static_cast<size_t>(i * step)];
+            idxs.resize(maxPts);
+        }
+    }
+    else if (p.reservoir)
+    {
+        // Reservoir sampling ("algorithm R"): O(maxPts) memory.
+        idxs.resize(maxPts);
+        std::iota(idxs.begin(), idxs.end(), 0);
+
+        for (size_t i = maxPts; i < nLocalPoints; i++)
+        {
+            std::uniform_int_distribution<size_t> dist(0, i);
+            const size_t                          j = dist(rng);
+            if (j < maxPts) idxs[j] = i;
+        }
+    }
+    else
+    {
+        // Random subset via a partial Fisher-Yates shuffle: only the first
+        // maxPts positions need to be shuffled.
+        idxs.resize(nLocalPoints);
+        std::iota(idxs.begin(), idxs.end(), 0);
+
+        for (size_t i = 0; i < maxPts; i++)
+        {
+            std::uniform_int_distribution<size_t> dist(i, nLocalPoints - 1);
+            std::swap(idxs[i], idxs[dist(rng)]);
+        }
+        idxs.resize(maxPts);
+    }
+
+    return idxs;
+
+    MRPT_END
+}
+
+Matcher_Points_Base::TransformedLocalPointCloud
+    Matcher_Points_Base::sampleAndTransformLocal(
+        const PointsView&           pcLocal,
+        const mrpt::poses::CPose3D& localPose) const
+{
+    MRPT_START
+
+    LocalSamplingParameters sp;
+    sp.maxLocalPoints    = maxLocalPointsPerLayer_;
+    sp.seed              = localPointsSampleSeed_;
+    sp.voxelSize         = localPointsVoxelSize_;
+    sp.maxPointsPerVoxel = maxLocalPointsPerVoxel_;
+    sp.reservoir         = localPointsReservoirSampling_;
+
+    if (!cacheLocalPointsSample_)
+    {
+        return transform_local_to_global(
+            pcLocal, localPose, sample_local_points(pcLocal, sp),
+            mortonOrderLocalPoints_);
+    }
+
+    std::optional<std::vector<std::size_t>> idxs;
+    {
+        std::lock_guard<copyable_mutex_t> lck(cachedLocalSamplesMtx_);
+
+        auto& entry = cachedLocalSamples_[pcLocal.xs()];
+        if (entry.nLocalPoints != pcLocal.size())
+        {
+            // Not cached yet, or the layer has changed:
+            entry.nLocalPoints = pcLocal.size();
+            entry.idxs         = sample_local_points(pcLocal, sp);
+        }
+        idxs = entry.idxs;
+    }
+
+    return transform_local_to_global(
+        pcLocal, localPose, std::move(idxs), mortonOrderLocalPoints_);
+
+    MRPT_END
+}
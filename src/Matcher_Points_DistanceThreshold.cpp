@@ -33,9 +33,9 @@ void Matcher_Points_DistanceThreshold::initialize(
 }
 
 void Matcher_Points_DistanceThreshold::implMatchOneLayer(
-    const mrpt::maps::CPointsMap& pcGlobal,
-    const mrpt::maps::CPointsMap& pcLocal,
-    const mrpt::poses::CPose3D& localPose, Pairings& out) const
+    const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+    const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+    Pairings& out) const
 {
     MRPT_START
 
@@ -48,8 +48,8 @@ void Matcher_Points_DistanceThreshold::implMatchOneLayer(
         globalMin.x, globalMax.x, globalMin.y, globalMax.y, globalMin.z,
         globalMax.z);
 
-    const TransformedLocalPointCloud tl = transform_local_to_global(
-        pcLocal, localPose, maxLocalPointsPerLayer_, localPointsSampleSeed_);
+    const TransformedLocalPointCloud tl =
+        sampleAndTransformLocal(pcLocal, localPose);
 
     // No need to compute: Is matching = null?
     if (tl.localMin.x > globalMax.x || tl.localMax.x < globalMin.x ||
@@ -67,10 +67,6 @@ void Matcher_Points_DistanceThreshold::implMatchOneLayer(
     const auto& gys = pcGlobal.getPointsBufferRef_y();
     const auto& gzs = pcGlobal.getPointsBufferRef_z();
 
-    const auto& lxs = pcLocal.getPointsBufferRef_x();
-    const auto& lys = pcLocal.getPointsBufferRef_y();
-    const auto& lzs = pcLocal.getPointsBufferRef_z();
-
     for (size_t i = 0; i < tl.x_locals.size(); i++)
     {
         size_t localIdx = tl.idxs.has_value() ? (*tl.idxs)[i] : i;
@@ -84,11 +80,21 @@ void Matcher_Points_DistanceThreshold::implMatchOneLayer(
             //   (x_local, y_local, z_local)
             // In "this" (global/reference) points map.
 
-            float        tentativeErrSqr;
-            const size_t tentativeGlobalIdx = pcGlobal.kdTreeClosestPoint3D(
-                lx, ly, lz,  // Look closest to this guy
-                tentativeErrSqr  // save here the min. distance squared
-            );
+            float  tentativeErrSqr;
+            size_t tentativeGlobalIdx;
+            if (mc.se2)
+            {
+                // Planar clouds: the cheaper 2D KD-tree is enough.
+                tentativeGlobalIdx =
+                    pcGlobal.kdTreeClosestPoint2D(lx, ly, tentativeErrSqr);
+            }
+            else
+            {
+                tentativeGlobalIdx = pcGlobal.kdTreeClosestPoint3D(
+                    lx, ly, lz,  // Look closest to this guy
+                    tentativeErrSqr  // save here the min. distance squared
+                );
+            }
 
             // Distance below the threshold??
             if (tentativeErrSqr < maxDistForCorrespondenceSquared)
@@ -102,9 +108,9 @@ void Matcher_Points_DistanceThreshold::implMatchOneLayer(
                 p.this_z   = gzs[tentativeGlobalIdx];
 
                 p.other_idx = localIdx;
-                p.other_x   = lxs[localIdx];
-                p.other_y   = lys[localIdx];
-                p.other_z   = lzs[localIdx];
+                p.other_x   = pcLocal.x(localIdx);
+                p.other_y   = pcLocal.y(localIdx);
+                p.other_z   = pcLocal.z(localIdx);
 
                 p.errorSquareAfterTransformation = tentativeErrSqr;
             }
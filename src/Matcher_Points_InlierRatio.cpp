@@ -32,9 +32,9 @@ void Matcher_Points_InlierRatio::initialize(
 }
 
 void Matcher_Points_InlierRatio::implMatchOneLayer(
-    const mrpt::maps::CPointsMap& pcGlobal,
-    const mrpt::maps::CPointsMap& pcLocal,
-    const mrpt::poses::CPose3D& localPose, Pairings& out) const
+    const mrpt::maps::CPointsMap& pcGlobal, const PointsView& pcLocal,
+    const mrpt::poses::CPose3D& localPose, const MatchContext& mc,
+    Pairings& out) const
 {
     MRPT_START
 
@@ -50,8 +50,8 @@ void Matcher_Points_InlierRatio::implMatchOneLayer(
         globalMin.x, globalMax.x, globalMin.y, globalMax.y, globalMin.z,
         globalMax.z);
 
-    const TransformedLocalPointCloud tl = transform_local_to_global(
-        pcLocal, localPose, maxLocalPointsPerLayer_, localPointsSampleSeed_);
+    const TransformedLocalPointCloud tl =
+        sampleAndTransformLocal(pcLocal, localPose);
 
     // No need to compute: Is matching = null?
     if (tl.localMin.x > globalMax.x || tl.localMax.x < globalMin.x ||
@@ -64,10 +64,6 @@ void Matcher_Points_InlierRatio::implMatchOneLayer(
     const auto& gys = pcGlobal.getPointsBufferRef_y();
     const auto& gzs = pcGlobal.getPointsBufferRef_z();
 
-    const auto& lxs = pcLocal.getPointsBufferRef_x();
-    const auto& lys = pcLocal.getPointsBufferRef_y();
-    const auto& lzs = pcLocal.getPointsBufferRef_z();
-
     std::multimap<double, mrpt::tfest::TMatchingPair> sortedPairings;
 
     for (size_t i = 0; i < tl.x_locals.size(); i++)
@@ -83,11 +79,21 @@ void Matcher_Points_InlierRatio::implMatchOneLayer(
             //   (x_local, y_local, z_local)
             // In "this" (global/reference) points map.
 
-            float        tentativeErrSqr;
-            const size_t tentativeGlobalIdx = pcGlobal.kdTreeClosestPoint3D(
-                lx, ly, lz,  // Look closest to this guy
-                tentativeErrSqr  // save here the min. distance squared
-            );
+            float  tentativeErrSqr;
+            size_t tentativeGlobalIdx;
+            if (mc.se2)
+            {
+                // Planar clouds: the cheaper 2D KD-tree is enough.
+                tentativeGlobalIdx =
+                    pcGlobal.kdTreeClosestPoint2D(lx, ly, tentativeErrSqr);
+            }
+            else
+            {
+                tentativeGlobalIdx = pcGlobal.kdTreeClosestPoint3D(
+                    lx, ly, lz,  // Look closest to this guy
+                    tentativeErrSqr  // save here the min. distance squared
+                );
+            }
 
             mrpt::tfest::TMatchingPair p;
             p.this_idx = tentativeGlobalIdx;
@@ -96,9 +102,9 @@ void Matcher_Points_InlierRatio::implMatchOneLayer(
             p.this_z   = gzs[tentativeGlobalIdx];
 
             p.other_idx = localIdx;
-            p.other_x   = lxs[localIdx];
-            p.other_y   = lys[localIdx];
-            p.other_z   = lzs[localIdx];
+            p.other_x   = pcLocal.x(localIdx);
+            p.other_y   = pcLocal.y(localIdx);
+            p.other_z   = pcLocal.z(localIdx);
 
             p.errorSquareAfterTransformation = tentativeErrSqr;
 
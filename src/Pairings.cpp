@@ -74,26 +74,69 @@ static void push_back_move(T&& o, T& me)
         std::make_move_iterator(o.end()));
 }
 
+// Appends the individual weights `o` (of `nO` pairings) to `me` (of `nMe`
+// pairings). If only one of them has explicit weights, the pairings of the
+// other one get weight 1.0.
+static void push_back_weights(
+    const std::vector<double>& o, const std::size_t nO, std::vector<double>& me,
+    const std::size_t nMe)
+{
+    if (o.empty() && me.empty()) return;
+
+    if (me.empty()) me.assign(nMe, 1.0);
+    if (o.empty())
+        me.resize(nMe + nO, 1.0);
+    else
+        me.insert(me.end(), o.begin(), o.end());
+}
+
+// Must be called before appending the pairings themselves:
+static void push_back_weights(const Pairings& o, Pairings& me)
+{
+    auto&       w  = me.weights;
+    const auto& ow = o.weights;
+    if (ow.empty() && w.empty()) return;
+
+    push_back_weights(
+        ow.pt2pt, o.paired_pt2pt.size(), w.pt2pt, me.paired_pt2pt.size());
+    push_back_weights(
+        ow.pt2ln, o.paired_pt2ln.size(), w.pt2ln, me.paired_pt2ln.size());
+    push_back_weights(
+        ow.pt2pl, o.paired_pt2pl.size(), w.pt2pl, me.paired_pt2pl.size());
+    push_back_weights(
+        ow.ln2ln, o.paired_ln2ln.size(), w.ln2ln, me.paired_ln2ln.size());
+    push_back_weights(
+        ow.pl2pl, o.paired_pl2pl.size(), w.pl2pl, me.paired_pl2pl.size());
+    push_back_weights(
+        ow.pt2pl_sym, o.paired_pt2pl_sym.size(), w.pt2pl_sym,
+        me.paired_pt2pl_sym.size());
+}
+
 void Pairings::push_back(const Pairings& o)
 {
+    push_back_weights(o, *this);
     push_back_copy(o.paired_pt2pt, paired_pt2pt);
     push_back_copy(o.paired_pt2ln, paired_pt2ln);
     push_back_copy(o.paired_pt2pl, paired_pt2pl);
     push_back_copy(o.paired_ln2ln, paired_ln2ln);
     push_back_copy(o.paired_pl2pl, paired_pl2pl);
+    push_back_copy(o.paired_pt2pl_sym, paired_pt2pl_sym);
 }
 
 void Pairings::push_back(Pairings&& o)
 {
+    push_back_weights(o, *this);
     push_back_move(std::move(o.paired_pt2pt), paired_pt2pt);
     push_back_move(std::move(o.paired_pt2ln), paired_pt2ln);
     push_back_move(std::move(o.paired_pt2pl), paired_pt2pl);
     push_back_move(std::move(o.paired_ln2ln), paired_ln2ln);
     push_back_move(std::move(o.paired_pl2pl), paired_pl2pl);
+    push_back_move(std::move(o.paired_pt2pl_sym), paired_pt2pl_sym);
 }
 
 size_t Pairings::size() const
 {
     return paired_pt2pt.size() + paired_pt2ln.size() + paired_pt2pl.size() +
-           paired_ln2ln.size() + paired_pl2pl.size();
+           paired_ln2ln.size() + paired_pl2pl.size() +
+           paired_pt2pl_sym.size();
 }
\ No newline at end of file
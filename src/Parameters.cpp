@@ -13,11 +13,17 @@ IMPLEMENTS_MRPT_OBJECT(Parameters, mrpt::serialization::CSerializable, mp2p_icp)
 using namespace mp2p_icp;
 
 // Implementation of the CSerializable virtual interface:
-uint8_t Parameters::serializeGetVersion() const { return 0; }
+uint8_t Parameters::serializeGetVersion() const { return 6; }
 void    Parameters::serializeTo(mrpt::serialization::CArchive& out) const
 {
     out << maxIterations << maxPairsPerLayer << minAbsStep_trans
         << minAbsStep_rot << pairingsWeightParameters;
+    pairingsSelection.serializeTo(out);  // v1
+    out << maxParallelMatchers;  // v2
+    out << andersonHistory;  // v3
+    dofMask.serializeTo(out);  // v4
+    out << autoSE2Mode;  // v5
+    out << compactPairings;  // v6
 }
 void Parameters::serializeFrom(
     mrpt::serialization::CArchive& in, uint8_t version)
@@ -25,9 +31,44 @@ void Parameters::serializeFrom(
     switch (version)
     {
         case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+        case 6:
         {
             in >> maxIterations >> maxPairsPerLayer >> minAbsStep_trans >>
                 minAbsStep_rot >> pairingsWeightParameters;
+            if (version >= 1)
+                pairingsSelection.serializeFrom(in);
+            else
+                pairingsSelection = PairingsSelectionParameters();
+
+            if (version >= 2)
+                in >> maxParallelMatchers;
+            else
+                maxParallelMatchers = 1;
+
+            if (version >= 3)
+                in >> andersonHistory;
+            else
+                andersonHistory = 0;
+
+            if (version >= 4)
+                dofMask.serializeFrom(in);
+            else
+                dofMask = DOFMask();
+
+            if (version >= 5)
+                in >> autoSE2Mode;
+            else
+                autoSE2Mode = true;
+
+            if (version >= 6)
+                in >> compactPairings;
+            else
+                compactPairings = false;
         }
         break;
         default:
@@ -41,9 +82,18 @@ void Parameters::load_from(const mrpt::containers::yaml& p)
     MCP_LOAD_REQ(p, maxPairsPerLayer);
     MCP_LOAD_OPT(p, minAbsStep_trans);
     MCP_LOAD_OPT(p, minAbsStep_rot);
+    MCP_LOAD_OPT(p, maxParallelMatchers);
+    MCP_LOAD_OPT(p, andersonHistory);
+    MCP_LOAD_OPT(p, autoSE2Mode);
+    MCP_LOAD_OPT(p, compactPairings);
 
     if (p.has("pairingsWeightParameters"))
         pairingsWeightParameters.load_from(p["pairingsWeightParameters"]);
+
+    if (p.has("pairingsSelection"))
+        pairingsSelection.load_from(p["pairingsSelection"]);
+
+    if (p.has("dofMask")) dofMask.load_from(p["dofMask"]);
 }
 void Parameters::save_to(mrpt::containers::yaml& p) const
 {
@@ -51,8 +101,20 @@ void Parameters::save_to(mrpt::containers::yaml& p) const
     MCP_SAVE(p, maxPairsPerLayer);
     MCP_SAVE(p, minAbsStep_trans);
     MCP_SAVE(p, minAbsStep_rot);
+    MCP_SAVE(p, maxParallelMatchers);
+    MCP_SAVE(p, andersonHistory);
+    MCP_SAVE(p, autoSE2Mode);
+    MCP_SAVE(p, compactPairings);
 
      mrpt::containers::yaml pp = mrpt::containers::yaml::Map();
     pairingsWeightParameters.save_to(pp);
     p["pairingsWeightParameters"] = std::move(pp);
+
+    mrpt::containers::yaml ps = mrpt::containers::yaml::Map();
+    pairingsSelection.save_to(ps);
+    p["pairingsSelection"] = std::move(ps);
+
+    mrpt::containers::yaml pd = mrpt::containers::yaml::Map();
+    dofMask.save_to(pd);
+    p["dofMask"] = std::move(pd);
 }
@@ -0,0 +1,58 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   PointNormals.cpp
+ * @brief  Per-point normals and local surface shape of a point layer
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/PointNormals.h>
+#include <mrpt/serialization/CArchive.h>
+#include <mrpt/serialization/stl_serialization.h>
+
+IMPLEMENTS_MRPT_OBJECT(
+    PointNormals, mrpt::serialization::CSerializable, mp2p_icp)
+
+using namespace mp2p_icp;
+
+void PointNormals::resize(const std::size_t n)
+{
+    nx.resize(n);
+    ny.resize(n);
+    nz.resize(n);
+    curvature.resize(n);
+    ratio02.resize(n);
+    ratio12.resize(n);
+    valid.resize(n);
+}
+
+// Implementation of the CSerializable virtual interface:
+uint8_t PointNormals::serializeGetVersion() const { return 0; }
+void    PointNormals::serializeTo(mrpt::serialization::CArchive& out) const
+{
+    out << nx << ny << nz << curvature << ratio02 << ratio12 << valid;
+}
+void PointNormals::serializeFrom(
+    mrpt::serialization::CArchive& in, uint8_t version)
+{
+    switch (version)
+    {
+        case 0:
+        {
+            in >> nx >> ny >> nz >> curvature >> ratio02 >> ratio12 >> valid;
+
+            const auto n = valid.size();
+            ASSERT_(
+                nx.size() == n && ny.size() == n && nz.size() == n &&
+                curvature.size() == n && ratio02.size() == n &&
+                ratio12.size() == n);
+        }
+        break;
+        default:
+            MRPT_THROW_UNKNOWN_SERIALIZATION_VERSION(version);
+    };
+}
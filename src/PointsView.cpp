@@ -0,0 +1,26 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   PointsView.cpp
+ * @brief  Non-owning view of points in external buffers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/PointsView.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+
+using namespace mp2p_icp;
+
+mrpt::maps::CPointsMap::Ptr PointsView::toPointsMap() const
+{
+    auto pts = mrpt::maps::CSimplePointsMap::Create();
+    pts->reserve(size_);
+    for (std::size_t i = 0; i < size_; i++)
+        pts->insertPointFast(x(i), y(i), z(i));
+    pts->mark_as_modified();
+    return pts;
+}
@@ -47,13 +47,14 @@ double QualityEvaluator_RangeImageSimilarity::evaluate(
     // "Analyzing the Quality of Matched 3D Point Clouds of Objects"
     // Igor Bogoslavskyi, Cyrill Stachniss
 
-    const auto& p1 = *pcGlobal.point_layers.at(pointcloud_t::PT_LAYER_RAW);
-    const auto& p2 = *pcLocal.point_layers.at(pointcloud_t::PT_LAYER_RAW);
+    const auto p1 = pcGlobal.layerView(pointcloud_t::PT_LAYER_RAW);
+    const auto p2 = pcLocal.layerView(pointcloud_t::PT_LAYER_RAW);
+    ASSERTMSG_(p1 && p2, "Both point clouds must have a 'raw' layer");
 
-    const auto I11 = projectPoints(p1);
-    const auto I12 = projectPoints(p1, localPose);
-    const auto I22 = projectPoints(p2);
-    const auto I21 = projectPoints(p2, -localPose);
+    const auto I11 = projectPoints(*p1);
+    const auto I12 = projectPoints(*p1, localPose);
+    const auto I22 = projectPoints(*p2);
+    const auto I21 = projectPoints(*p2, -localPose);
 
     auto s1 = scores(I11, I21);
     auto s2 = scores(I12, I22);
@@ -132,7 +133,7 @@ static void projectPoint(
 }
 
 mrpt::math::CMatrixDouble QualityEvaluator_RangeImageSimilarity::projectPoints(
-    const mrpt::maps::CPointsMap&              pts,
+    const PointsView&                          pts,
     const std::optional<mrpt::poses::CPose3D>& relativePose) const
 {
     const auto& rc = rangeCamera;
@@ -140,15 +141,11 @@ mrpt::math::CMatrixDouble QualityEvaluator_RangeImageSimilarity::projectPoints(
     mrpt::math::CMatrixDouble I(rc.nrows, rc.ncols);
     I.setZero();  // range=0 means "invalid"
 
-    const auto& xs = pts.getPointsBufferRef_x();
-    const auto& ys = pts.getPointsBufferRef_y();
-    const auto& zs = pts.getPointsBufferRef_z();
-
-    const auto nPoints      = xs.size();
+    const auto nPoints      = pts.size();
     size_t     nValidPoints = 0;
     for (size_t i = 0; i < nPoints; i++)
     {
-        mrpt::math::TPoint3D p(xs[i], ys[i], zs[i]);
+        mrpt::math::TPoint3D p(pts.x(i), pts.y(i), pts.z(i));
         if (relativePose) p = relativePose->composePoint(p);
 
         double px, py;
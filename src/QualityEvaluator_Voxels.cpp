@@ -69,10 +69,9 @@ double QualityEvaluator_Voxels::evaluate(
 
     for (const auto& ly : pointLayers)
     {
-        auto itG = pcGlobal.point_layers.find(ly);
-        auto itL = pcLocal.point_layers.find(ly);
-        if (itG == pcGlobal.point_layers.end() ||
-            itL == pcLocal.point_layers.end())
+        auto       itG = pcGlobal.point_layers.find(ly);
+        const auto lcl = pcLocal.layerView(ly);
+        if (itG == pcGlobal.point_layers.end() || !lcl)
         {
             MRPT_LOG_ERROR_FMT(
                 "Layer `%s` not found in both global/local layers.",
@@ -81,7 +80,14 @@ double QualityEvaluator_Voxels::evaluate(
         }
 
         mrpt::maps::CSimplePointsMap localTransformed;
-        localTransformed.insertAnotherMap(itL->second.get(), localPose);
+        localTransformed.reserve(lcl->size());
+        for (size_t i = 0; i < lcl->size(); i++)
+        {
+            double gx, gy, gz;
+            localPose.composePoint(lcl->x(i), lcl->y(i), lcl->z(i), gx, gy, gz);
+            localTransformed.insertPointFast(gx, gy, gz);
+        }
+        localTransformed.mark_as_modified();
 
         // resize voxel grids?
         MRPT_TODO("Check against current size too, for many layers");
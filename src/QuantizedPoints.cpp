@@ -0,0 +1,231 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   QuantizedPoints.cpp
+ * @brief  Compressed point storage, quantized relative to tile origins
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/QuantizedPoints.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/serialization/CArchive.h>
+#include <mrpt/serialization/stl_serialization.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "RigidTransform3.h"
+
+IMPLEMENTS_MRPT_OBJECT(
+    QuantizedPoints, mrpt::serialization::CSerializable, mp2p_icp)
+
+using namespace mp2p_icp;
+
+namespace
+{
+constexpr int64_t kTileSteps  = 65536;
+constexpr int64_t kHalfSteps  = kTileSteps / 2;
+constexpr int64_t kFloorShift = 16;  // log2(kTileSteps)
+
+// Origin of a tile (its center) along one axis, in resolution steps:
+double tile_origin(const int64_t tileIndex)
+{
+    return static_cast<double>(tileIndex * kTileSteps + kHalfSteps);
+}
+}  // namespace
+
+QuantizedPoints::QuantizedPoints(const double resolution)
+    : resolution_(resolution)
+{
+    ASSERT_GT_(resolution_, 0.0);
+}
+
+void QuantizedPoints::clear()
+{
+    tiles_.clear();
+    tileLookup_.clear();
+    nPoints_ = 0;
+}
+
+std::size_t QuantizedPoints::memoryUsage() const
+{
+    std::size_t n = sizeof(*this) + tiles_.capacity() * sizeof(Tile);
+    for (const auto& t : tiles_)
+        n += (t.dx.capacity() + t.dy.capacity() + t.dz.capacity()) *
+             sizeof(int16_t);
+    return n;
+}
+
+QuantizedPoints::Tile& QuantizedPoints::tileFor(
+    const std::array<int64_t, 3>& index)
+{
+    const auto it = tileLookup_.find(index);
+    if (it != tileLookup_.end()) return tiles_[it->second];
+
+    tileLookup_[index] = tiles_.size();
+    auto& t            = tiles_.emplace_back();
+    t.index            = index;
+    return t;
+}
+
+void QuantizedPoints::insertPoints(
+    const PointsView& pts, const std::optional<mrpt::poses::CPose3D>& pose)
+{
+    MRPT_START
+
+    ASSERT_GT_(resolution_, 0.0);
+    const double invRes = 1.0 / resolution_;
+
+    std::optional<RigidTransform3d> tf;
+    if (pose) tf.emplace(*pose);
+
+    // Consecutive points usually fall in the same tile:
+    Tile*                  lastTile = nullptr;
+    std::array<int64_t, 3> lastIndex{0, 0, 0};
+
+    for (std::size_t i = 0; i < pts.size(); i++)
+    {
+        double x = pts.x(i), y = pts.y(i), z = pts.z(i);
+        if (tf) tf->composePoint(x, y, z, x, y, z);
+
+        // Coordinates in resolution steps, split into tile and offset:
+        const std::array<int64_t, 3> q = {
+            std::llround(x * invRes), std::llround(y * invRes),
+            std::llround(z * invRes)};
+        // (arithmetic shift == floor division by kTileSteps)
+        const std::array<int64_t, 3> idx = {
+            q[0] >> kFloorShift, q[1] >> kFloorShift, q[2] >> kFloorShift};
+
+        if (!lastTile || idx != lastIndex)
+        {
+            lastTile  = &tileFor(idx);
+            lastIndex = idx;
+        }
+        lastTile->dx.push_back(static_cast<int16_t>(
+            q[0] - idx[0] * kTileSteps - kHalfSteps));
+        lastTile->dy.push_back(static_cast<int16_t>(
+            q[1] - idx[1] * kTileSteps - kHalfSteps));
+        lastTile->dz.push_back(static_cast<int16_t>(
+            q[2] - idx[2] * kTileSteps - kHalfSteps));
+        nPoints_++;
+    }
+
+    MRPT_END
+}
+
+void QuantizedPoints::insertPoints(
+    const QuantizedPoints&                     other,
+    const std::optional<mrpt::poses::CPose3D>& pose)
+{
+    MRPT_START
+
+    std::vector<float> xs(other.size()), ys(other.size()), zs(other.size());
+    other.decode(xs.data(), ys.data(), zs.data());
+
+    insertPoints(
+        PointsView::FromArrays(xs.data(), ys.data(), zs.data(), xs.size()),
+        pose);
+
+    MRPT_END
+}
+
+void QuantizedPoints::decode(float* xs, float* ys, float* zs) const
+{
+    const double res = resolution_;
+
+    std::size_t k = 0;
+    for (const auto& t : tiles_)
+    {
+        const double ox = tile_origin(t.index[0]) * res;
+        const double oy = tile_origin(t.index[1]) * res;
+        const double oz = tile_origin(t.index[2]) * res;
+
+        const std::size_t n  = t.dx.size();
+        const int16_t*    dx = t.dx.data();
+        const int16_t*    dy = t.dy.data();
+        const int16_t*    dz = t.dz.data();
+        float*            gx = xs + k;
+        float*            gy = ys + k;
+        float*            gz = zs + k;
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            gx[i] = static_cast<float>(ox + res * dx[i]);
+            gy[i] = static_cast<float>(oy + res * dy[i]);
+            gz[i] = static_cast<float>(oz + res * dz[i]);
+        }
+        k += n;
+    }
+}
+
+bool QuantizedPoints::isPlanar(const double zTolerance) const
+{
+    const double res = resolution_;
+
+    for (const auto& t : tiles_)
+    {
+        if (t.dz.empty()) continue;
+
+        const auto [dzMin, dzMax] =
+            std::minmax_element(t.dz.begin(), t.dz.end());
+
+        // Same arithmetic as decode():
+        const double oz = tile_origin(t.index[2]) * res;
+        for (const int16_t dz : {*dzMin, *dzMax})
+        {
+            const float z = static_cast<float>(oz + res * dz);
+            if (std::abs(z) > zTolerance) return false;
+        }
+    }
+    return true;
+}
+
+mrpt::maps::CPointsMap::Ptr QuantizedPoints::toPointsMap() const
+{
+    std::vector<float> xs(nPoints_), ys(nPoints_), zs(nPoints_);
+    decode(xs.data(), ys.data(), zs.data());
+
+    return PointsView::FromArrays(xs.data(), ys.data(), zs.data(), nPoints_)
+        .toPointsMap();
+}
+
+// Implementation of the CSerializable virtual interface:
+uint8_t QuantizedPoints::serializeGetVersion() const { return 0; }
+void    QuantizedPoints::serializeTo(mrpt::serialization::CArchive& out) const
+{
+    out << resolution_;
+    out.WriteAs<uint32_t>(tiles_.size());
+    for (const auto& t : tiles_)
+        out << t.index[0] << t.index[1] << t.index[2] << t.dx << t.dy << t.dz;
+}
+void QuantizedPoints::serializeFrom(
+    mrpt::serialization::CArchive& in, uint8_t version)
+{
+    switch (version)
+    {
+        case 0:
+        {
+            clear();
+            in >> resolution_;
+            tiles_.resize(in.ReadAs<uint32_t>());
+            for (std::size_t i = 0; i < tiles_.size(); i++)
+            {
+                auto& t = tiles_[i];
+                in >> t.index[0] >> t.index[1] >> t.index[2] >> t.dx >> t.dy >>
+                    t.dz;
+                ASSERT_EQUAL_(t.dx.size(), t.dy.size());
+                ASSERT_EQUAL_(t.dx.size(), t.dz.size());
+
+                tileLookup_[t.index] = i;
+                nPoints_ += t.dx.size();
+            }
+        }
+        break;
+        default:
+            MRPT_THROW_UNKNOWN_SERIALIZATION_VERSION(version);
+    };
+}
@@ -0,0 +1,217 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   RigidTransform3.h
+ * @brief  Lightweight SE(3) transformation for inner loops
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mrpt/core/bits_math.h>
+#include <mrpt/math/CMatrixFixed.h>
+#include <mrpt/math/TPoint3D.h>
+#include <mrpt/poses/CPose3D.h>
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace mp2p_icp
+{
+/** A rigid transformation (rotation matrix and translation) with all
+ * operations inlined, for inner loops over points or pairings.
+ *
+ * Unlike mrpt::poses::CPose3D, it keeps no cached Euler angles. Convert
+ * from/to CPose3D only at API boundaries.
+ *
+ * exp() and log() follow the same (pseudo-exponential) convention than
+ * mrpt::poses::Lie::SE<3>: for `e=[v w]`, the rotation is `exp(w)` and the
+ * translation is `v`.
+ */
+template <typename T>
+class RigidTransform3
+{
+   public:
+    using matrix3_t = Eigen::Matrix<T, 3, 3>;
+    using vector3_t = Eigen::Matrix<T, 3, 1>;
+    using vector6_t = Eigen::Matrix<T, 6, 1>;
+
+    matrix3_t R = matrix3_t::Identity();
+    vector3_t t = vector3_t::Zero();
+
+    /** Identity transformation */
+    RigidTransform3() = default;
+
+    RigidTransform3(const matrix3_t& rot, const vector3_t& trans)
+        : R(rot), t(trans)
+    {
+    }
+
+    explicit RigidTransform3(const mrpt::poses::CPose3D& p)
+    {
+        const auto& rot = p.getRotationMatrix();
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++) R(r, c) = static_cast<T>(rot(r, c));
+        t = vector3_t(
+            static_cast<T>(p.x()), static_cast<T>(p.y()),
+            static_cast<T>(p.z()));
+    }
+
+    mrpt::poses::CPose3D asCPose3D() const
+    {
+        mrpt::math::CMatrixDouble33 rot;
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++) rot(r, c) = R(r, c);
+        return mrpt::poses::CPose3D::FromRotationAndTranslation(
+            rot, mrpt::math::TVector3D(t.x(), t.y(), t.z()));
+    }
+
+    /** g = R*l + t */
+    template <typename U, typename V>
+    inline void composePoint(
+        const U lx, const U ly, const U lz, V& gx, V& gy, V& gz) const
+    {
+        gx = static_cast<V>(R(0, 0) * lx + R(0, 1) * ly + R(0, 2) * lz + t[0]);
+        gy = static_cast<V>(R(1, 0) * lx + R(1, 1) * ly + R(1, 2) * lz + t[1]);
+        gz = static_cast<V>(R(2, 0) * lx + R(2, 1) * ly + R(2, 2) * lz + t[2]);
+    }
+
+    inline vector3_t composePoint(const vector3_t& l) const
+    {
+        return R * l + t;
+    }
+
+    /** l = R^T*(g - t) */
+    template <typename U, typename V>
+    inline void inverseComposePoint(
+        const U gx, const U gy, const U gz, V& lx, V& ly, V& lz) const
+    {
+        const T dx = gx - t[0], dy = gy - t[1], dz = gz - t[2];
+        lx = static_cast<V>(R(0, 0) * dx + R(1, 0) * dy + R(2, 0) * dz);
+        ly = static_cast<V>(R(0, 1) * dx + R(1, 1) * dy + R(2, 1) * dz);
+        lz = static_cast<V>(R(0, 2) * dx + R(1, 2) * dy + R(2, 2) * dz);
+    }
+
+    /** Transforms `n` points given as separate coordinate arrays (which may
+     * be the same for input and output). The loop has no branches nor
+     * function calls, so the compiler can vectorize it. */
+    template <typename U, typename V>
+    void composePoints(
+        const std::size_t n, const U* lxs, const U* lys, const U* lzs, V* gxs,
+        V* gys, V* gzs) const
+    {
+        const T r00 = R(0, 0), r01 = R(0, 1), r02 = R(0, 2);
+        const T r10 = R(1, 0), r11 = R(1, 1), r12 = R(1, 2);
+        const T r20 = R(2, 0), r21 = R(2, 1), r22 = R(2, 2);
+        const T tx = t[0], ty = t[1], tz = t[2];
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const T lx = lxs[i], ly = lys[i], lz = lzs[i];
+            gxs[i]     = static_cast<V>(r00 * lx + r01 * ly + r02 * lz + tx);
+            gys[i]     = static_cast<V>(r10 * lx + r11 * ly + r12 * lz + ty);
+            gzs[i]     = static_cast<V>(r20 * lx + r21 * ly + r22 * lz + tz);
+        }
+    }
+
+    /** Composition, such that `(a*b).composePoint(p)` equals
+     * `a.composePoint(b.composePoint(p))`, i.e. CPose3D's `a+b`. */
+    inline RigidTransform3 operator*(const RigidTransform3& b) const
+    {
+        return RigidTransform3(R * b.R, R * b.t + t);
+    }
+
+    inline RigidTransform3 inverse() const
+    {
+        const matrix3_t Rt = R.transpose();
+        return RigidTransform3(Rt, -(Rt * t));
+    }
+
+    /** SO(3) exponential (Rodrigues formula) */
+    static matrix3_t exp_rotation(const vector3_t& w)
+    {
+        const T         theta2 = w.squaredNorm();
+        const matrix3_t K      = skew(w);
+
+        T a, b;  // R = I + a*K + b*K^2
+        if (theta2 < T(1e-8))
+        {
+            // Taylor expansion, exact up to the precision of T:
+            a = T(1) - theta2 / T(6);
+            b = T(0.5) - theta2 / T(24);
+        }
+        else
+        {
+            const T theta = std::sqrt(theta2);
+            a             = std::sin(theta) / theta;
+            b             = (T(1) - std::cos(theta)) / theta2;
+        }
+        return matrix3_t::Identity() + a * K + b * K * K;
+    }
+
+    /** SO(3) logarithm, inverse of exp_rotation(). */
+    static vector3_t log_rotation(const matrix3_t& rot)
+    {
+        const T cosTheta =
+            std::clamp((rot.trace() - T(1)) / T(2), T(-1), T(1));
+        const T theta = std::acos(cosTheta);
+
+        const vector3_t v(
+            rot(2, 1) - rot(1, 2), rot(0, 2) - rot(2, 0),
+            rot(1, 0) - rot(0, 1));
+
+        if (theta < T(1e-4))
+        {
+            // sin(theta) ~ theta (1-theta^2/6):
+            return (T(0.5) + theta * theta / T(12)) * v;
+        }
+        if (theta < T(M_PI) - T(1e-3))
+            return theta / (T(2) * std::sin(theta)) * v;
+
+        // Near pi, v vanishes. Use the symmetric part instead,
+        // (R+R^T)/2 = cos(theta)*I + (1-cos(theta))*axis*axis^T, taking the
+        // column of its largest diagonal entry:
+        const matrix3_t B = (rot + rot.transpose()) / T(2) -
+                            cosTheta * matrix3_t::Identity();
+        int             k = 0;
+        B.diagonal().maxCoeff(&k);
+        vector3_t axis = B.col(k).normalized();
+        if (axis.dot(v) < 0) axis = -axis;
+        return theta * axis;
+    }
+
+    static RigidTransform3 exp(const vector6_t& e)
+    {
+        return RigidTransform3(
+            exp_rotation(e.template tail<3>()), e.template head<3>());
+    }
+
+    vector6_t log() const
+    {
+        vector6_t e;
+        e.template head<3>() = t;
+        e.template tail<3>() = log_rotation(R);
+        return e;
+    }
+
+    static matrix3_t skew(const vector3_t& w)
+    {
+        matrix3_t K;
+        // clang-format off
+        K <<    0, -w.z(),  w.y(),
+            w.z(),      0, -w.x(),
+           -w.y(),  w.x(),      0;
+        // clang-format on
+        return K;
+    }
+};
+
+using RigidTransform3f = RigidTransform3<float>;
+using RigidTransform3d = RigidTransform3<double>;
+
+}  // namespace mp2p_icp
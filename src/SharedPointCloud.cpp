@@ -0,0 +1,106 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   SharedPointCloud.cpp
+ * @brief  A global map shared between a writer thread and ICP readers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/SharedPointCloud.h>
+#include <mrpt/core/exceptions.h>
+
+#include <atomic>
+
+#include "build_kdtrees.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+// Builds the KD-trees that matchers would otherwise build, lazily, on their
+// first query. The 2D ones are only used for planar alignments. Layers
+// shared with the previous version `prev` already have them, and may be in
+// use by readers, so they are skipped.
+void build_new_kdtrees(
+    const pointcloud_t& pc, const pointcloud_t* prev = nullptr)
+{
+    const bool planar     = pc.isPlanar();
+    const bool prevPlanar = prev && prev->isPlanar();
+
+    for (const auto& layer : pc.point_layers)
+    {
+        const auto& pts = layer.second;
+        if (!pts || pts->empty()) continue;
+
+        if (prev && planar == prevPlanar)
+        {
+            const auto it = prev->point_layers.find(layer.first);
+            if (it != prev->point_layers.end() && it->second == pts) continue;
+        }
+
+        build_kdtree(*pts, planar);
+    }
+}
+}  // namespace
+
+SharedPointCloud::SharedPointCloud()
+    : current_(std::make_shared<const Snapshot>())
+{
+}
+
+SharedPointCloud::SharedPointCloud(pointcloud_t initialMap)
+{
+    auto s = std::make_shared<Snapshot>();
+    s->map = std::move(initialMap);
+    build_new_kdtrees(s->map);
+    current_ = std::move(s);
+}
+
+SharedPointCloud::SnapshotPtr SharedPointCloud::snapshot() const
+{
+    return std::atomic_load(&current_);
+}
+
+uint64_t SharedPointCloud::update(
+    const std::function<void(pointcloud_t&)>& updateFn)
+{
+    MRPT_START
+
+    std::lock_guard<std::mutex> lck(writerMtx_);
+
+    // Layers are shared with the latest version until modified, since
+    // pointcloud_t layers are copy-on-write:
+    pointcloud_t next = std::atomic_load(&current_)->map;
+
+    updateFn(next);
+
+    return publishLocked(std::move(next));
+
+    MRPT_END
+}
+
+uint64_t SharedPointCloud::publish(pointcloud_t newMap)
+{
+    std::lock_guard<std::mutex> lck(writerMtx_);
+    return publishLocked(std::move(newMap));
+}
+
+uint64_t SharedPointCloud::publishLocked(pointcloud_t&& newMap)
+{
+    const auto prev = std::atomic_load(&current_);
+
+    auto s     = std::make_shared<Snapshot>();
+    s->version = prev->version + 1;
+    s->map     = std::move(newMap);
+
+    // Done before publishing, since readers must never modify a snapshot:
+    build_new_kdtrees(s->map, &prev->map);
+
+    const uint64_t version = s->version;
+    std::atomic_store(&current_, std::shared_ptr<const Snapshot>(std::move(s)));
+    return version;
+}
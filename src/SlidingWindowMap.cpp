@@ -0,0 +1,227 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   SlidingWindowMap.cpp
+ * @brief  Incremental local map around the latest pose, for odometry
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/SlidingWindowMap.h>
+#include <mrpt/core/bits_math.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+
+#include <cmath>
+#include <set>
+
+#include "RigidTransform3.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+// 21 bits per voxel coordinate, as in Matcher_Points_Base local sampling.
+// Wrapped-around collisions only make the map sparser.
+uint64_t voxel_key(
+    const float x, const float y, const float z, const double invVoxelSize)
+{
+    const auto ix = static_cast<int64_t>(std::floor(x * invVoxelSize));
+    const auto iy = static_cast<int64_t>(std::floor(y * invVoxelSize));
+    const auto iz = static_cast<int64_t>(std::floor(z * invVoxelSize));
+    return (static_cast<uint64_t>(ix) & 0x1fffff) |
+           ((static_cast<uint64_t>(iy) & 0x1fffff) << 21) |
+           ((static_cast<uint64_t>(iz) & 0x1fffff) << 42);
+}
+}  // namespace
+
+void SlidingWindowMap::initialize(const mrpt::containers::yaml& params)
+{
+    MCP_LOAD_OPT(params, voxelSize);
+    MCP_LOAD_OPT(params, radius);
+    MCP_LOAD_OPT(params, evictionCheckDistance);
+    MCP_LOAD_OPT(params, maxPendingRatio);
+}
+
+void SlidingWindowMap::clear()
+{
+    map_.clear();
+    index_.clear();
+    nPending_ = 0;
+    lastEvictionCenter_.reset();
+}
+
+void SlidingWindowMap::insertScan(
+    const pointcloud_t& scan, const mrpt::poses::CPose3D& scanPose)
+{
+    MRPT_START
+
+    ASSERT_GT_(voxelSize, 0.0);
+    const double invVoxelSize = 1.0 / voxelSize;
+
+    // In double precision, so large translations only round the output:
+    const RigidTransform3d tf(scanPose);
+
+    std::set<std::string> names;
+    for (const auto& l : scan.point_layers) names.insert(l.first);
+    for (const auto& l : scan.external_layers) names.insert(l.first);
+
+    std::vector<float> gxs, gys, gzs;
+    for (const auto& name : names)
+    {
+        const auto view = scan.layerView(name);
+        if (!view || view->empty()) continue;
+
+        const std::size_t n = view->size();
+        gxs.resize(n);
+        gys.resize(n);
+        gzs.resize(n);
+        if (view->contiguous())
+        {
+            tf.composePoints(
+                n, view->xs(), view->ys(), view->zs(), gxs.data(), gys.data(),
+                gzs.data());
+        }
+        else
+        {
+            for (std::size_t i = 0; i < n; i++)
+                tf.composePoint(
+                    view->x(i), view->y(i), view->z(i), gxs[i], gys[i], gzs[i]);
+        }
+
+        auto& idx = index_[name];
+
+        // Keep the first point falling into each voxel:
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const uint64_t key =
+                voxel_key(gxs[i], gys[i], gzs[i], invVoxelSize);
+            const auto nextIdx = static_cast<uint32_t>(idx.keys.size());
+            if (!idx.voxels.try_emplace(key, nextIdx).second) continue;
+
+            idx.pendingX.push_back(gxs[i]);
+            idx.pendingY.push_back(gys[i]);
+            idx.pendingZ.push_back(gzs[i]);
+            idx.keys.push_back(key);
+            nPending_++;
+        }
+    }
+
+    const auto center    = scanPose.translation();
+    const bool mustEvict = !lastEvictionCenter_ ||
+                           (center - *lastEvictionCenter_).norm() >=
+                               evictionCheckDistance;
+    const bool mustFlush = mustEvict || nPending_ > maxPendingRatio * size();
+
+    // Both change the map layers, so do them together:
+    if (mustFlush) flush();
+    if (mustEvict)
+    {
+        evict(center);
+        lastEvictionCenter_ = center;
+    }
+
+    MRPT_END
+}
+
+const pointcloud_t& SlidingWindowMap::asPointCloud()
+{
+    flush();
+    return map_;
+}
+
+void SlidingWindowMap::flush()
+{
+    if (nPending_ == 0) return;
+
+    for (auto& [name, idx] : index_)
+    {
+        if (idx.pendingX.empty()) continue;
+
+        if (!map_.point_layers[name])
+            map_.point_layers[name] = mrpt::maps::CSimplePointsMap::Create();
+        const auto pts = map_.mutableLayer(name);
+
+        for (std::size_t i = 0; i < idx.pendingX.size(); i++)
+        {
+            pts->insertPointFast(
+                idx.pendingX[i], idx.pendingY[i], idx.pendingZ[i]);
+        }
+        pts->mark_as_modified();
+
+        idx.pendingX.clear();
+        idx.pendingY.clear();
+        idx.pendingZ.clear();
+    }
+    nPending_ = 0;
+}
+
+void SlidingWindowMap::evict(const mrpt::math::TPoint3D& center)
+{
+    // Point indices in `index_` assume no pending points:
+    ASSERT_EQUAL_(nPending_, 0U);
+
+    const float r2 = static_cast<float>(mrpt::square(radius));
+    const float cx = static_cast<float>(center.x);
+    const float cy = static_cast<float>(center.y);
+    const float cz = static_cast<float>(center.z);
+
+    const auto isInside = [&](const float x, const float y, const float z) {
+        return mrpt::square(x - cx) + mrpt::square(y - cy) +
+                   mrpt::square(z - cz) <=
+               r2;
+    };
+
+    for (const auto& layer : map_.point_layers)
+    {
+        const auto& name = layer.first;
+
+        // Look for the first point to evict without touching the layer, which
+        // may be shared with a copy of asPointCloud() still in use:
+        std::size_t first = 0;
+        {
+            const auto& xs = layer.second->getPointsBufferRef_x();
+            const auto& ys = layer.second->getPointsBufferRef_y();
+            const auto& zs = layer.second->getPointsBufferRef_z();
+            while (first < xs.size() &&
+                   isInside(xs[first], ys[first], zs[first]))
+                first++;
+            if (first == xs.size()) continue;
+        }
+
+        const auto pts = map_.mutableLayer(name);
+        auto&      idx = index_[name];
+
+        // Remove in place, moving the last point into each freed slot:
+        std::size_t n = pts->size();
+        for (std::size_t i = first; i < n;)
+        {
+            float x, y, z;
+            pts->getPointFast(i, x, y, z);
+            if (isInside(x, y, z))
+            {
+                i++;
+                continue;
+            }
+
+            idx.voxels.erase(idx.keys[i]);
+            n--;
+            if (i != n)
+            {
+                pts->getPointFast(n, x, y, z);
+                pts->setPointFast(i, x, y, z);
+                idx.keys[i]             = idx.keys[n];
+                idx.voxels[idx.keys[i]] = static_cast<uint32_t>(i);
+            }
+        }
+
+        if (n != pts->size())
+        {
+            pts->resize(n);
+            idx.keys.resize(n);
+            pts->mark_as_modified();
+        }
+    }
+}
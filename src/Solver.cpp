@@ -13,6 +13,8 @@
 #include <mp2p_icp/Solver.h>
 #include <mrpt/core/exceptions.h>
 
+#include <type_traits>
+
 IMPLEMENTS_VIRTUAL_MRPT_OBJECT(Solver, mrpt::rtti::CObject, mp2p_icp)
 
 using namespace mp2p_icp;
@@ -25,13 +27,50 @@ void Solver::initialize(const mrpt::containers::yaml& params)
         runUpToIteration = params["runUpToIteration"].as<uint32_t>();
 }
 
-bool Solver::optimal_pose(
-    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+template <class PAIRINGS>
+bool Solver::solve(
+    const PAIRINGS& pairings, OptimalTF_Result& out, const WeightParameters& wp,
     const SolverContext& sc) const
 {
     const auto iter = sc.icpIteration;
     if (iter < runFromIteration) return false;
     if (runUpToIteration > 0 && iter > runUpToIteration) return false;
 
-    return impl_optimal_pose(pairings, out, wp, sc);
+    if constexpr (std::is_same_v<PAIRINGS, CompactPairings>)
+    {
+        if (!impl_optimal_pose_compact(pairings, out, wp, sc)) return false;
+    }
+    else
+    {
+        if (!impl_optimal_pose(pairings, out, wp, sc)) return false;
+    }
+
+    if (!sc.dofMask.allFree())
+    {
+        out.optimalPose = sc.dofMask.project(
+            out.optimalPose,
+            sc.guessRelativePose.value_or(mrpt::poses::CPose3D()));
+    }
+    return true;
+}
+
+bool Solver::optimal_pose(
+    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc) const
+{
+    return solve(pairings, out, wp, sc);
+}
+
+bool Solver::optimal_pose(
+    const CompactPairings& pairings, OptimalTF_Result& out,
+    const WeightParameters& wp, const SolverContext& sc) const
+{
+    return solve(pairings, out, wp, sc);
+}
+
+bool Solver::impl_optimal_pose_compact(
+    const CompactPairings& pairings, OptimalTF_Result& out,
+    const WeightParameters& wp, const SolverContext& sc) const
+{
+    return impl_optimal_pose(pairings.asPairings(), out, wp, sc);
 }
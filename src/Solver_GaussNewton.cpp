@@ -12,6 +12,7 @@
 
 #include <mp2p_icp/Solver_GaussNewton.h>
 #include <mp2p_icp/optimal_tf_gauss_newton.h>
+#include <mp2p_icp/optimal_tf_se2.h>
 #include <mrpt/core/exceptions.h>
 
 IMPLEMENTS_MRPT_OBJECT(Solver_GaussNewton, mp2p_icp::Solver, mp2p_icp)
@@ -23,20 +24,57 @@ void Solver_GaussNewton::initialize(const mrpt::containers::yaml& params)
     Solver::initialize(params);
 
     MCP_LOAD_REQ(params, maxIterations);
+
+    if (params.has("robustKernel"))
+    {
+        robustKernel = mrpt::typemeta::TEnumType<RobustKernel>::name2value(
+            params["robustKernel"].as<std::string>());
+    }
+    MCP_LOAD_OPT(params, robustKernelParam);
 }
 
-bool Solver_GaussNewton::impl_optimal_pose(
-    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
-    [[maybe_unused]] const SolverContext& sc) const
+namespace
 {
-    MRPT_START
+// The SE(2) solver only takes Pairings:
+const Pairings& legacy(const Pairings& p) { return p; }
+const Pairings& legacy(const CompactPairings& p) { return p.asPairings(); }
 
+template <class PAIRINGS>
+bool solve_gauss_newton(
+    const Solver_GaussNewton& s, const PAIRINGS& pairings,
+    OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc)
+{
     out = OptimalTF_Result();
 
+    ASSERT_(sc.guessRelativePose.has_value());
+
+    // Planar point clouds: 3-DOF problem (robust kernels not supported).
+    if (sc.se2 && s.robustKernel == RobustKernel::None)
+    {
+        OptimalTF_SE2_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = s.maxIterations;
+        gnParams.linearizationPoint =
+            mrpt::poses::CPose2D(sc.guessRelativePose.value());
+        gnParams.dofMask = sc.dofMask;
+
+        try
+        {
+            optimal_tf_se2_gauss_newton(legacy(pairings), wp, out, gnParams);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+        return true;
+    }
+
     OptimalTF_GN_Parameters gnParams;
-    gnParams.maxInnerLoopIterations = maxIterations;
+    gnParams.maxInnerLoopIterations = s.maxIterations;
+    gnParams.kernel                 = s.robustKernel;
+    gnParams.kernelParam            = s.robustKernelParam;
+    gnParams.dofMask                = sc.dofMask;
 
-    ASSERT_(sc.guessRelativePose.has_value());
     gnParams.linearizationPoint =
         mrpt::poses::CPose3D(sc.guessRelativePose.value());
 
@@ -45,7 +83,7 @@ bool Solver_GaussNewton::impl_optimal_pose(
     {
         optimal_tf_gauss_newton(pairings, wp, out, gnParams);
     }
-    catch (const std::exception& e)
+    catch (const std::exception&)
     {
         // Skip ill-defined problems if the no. of points is too small.
         // Nothing we can do:
@@ -53,6 +91,23 @@ bool Solver_GaussNewton::impl_optimal_pose(
     }
 
     return true;
+}
+}  // namespace
+
+bool Solver_GaussNewton::impl_optimal_pose(
+    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc) const
+{
+    MRPT_START
+    return solve_gauss_newton(*this, pairings, out, wp, sc);
+    MRPT_END
+}
 
+bool Solver_GaussNewton::impl_optimal_pose_compact(
+    const CompactPairings& pairings, OptimalTF_Result& out,
+    const WeightParameters& wp, const SolverContext& sc) const
+{
+    MRPT_START
+    return solve_gauss_newton(*this, pairings, out, wp, sc);
     MRPT_END
 }
@@ -12,6 +12,7 @@
 
 #include <mp2p_icp/Solver_Horn.h>
 #include <mp2p_icp/optimal_tf_horn.h>
+#include <mp2p_icp/optimal_tf_se2.h>
 #include <mrpt/core/exceptions.h>
 
 IMPLEMENTS_MRPT_OBJECT(Solver_Horn, mp2p_icp::Solver, mp2p_icp)
@@ -20,12 +21,16 @@ using namespace mp2p_icp;
 
 bool Solver_Horn::impl_optimal_pose(
     const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
-    [[maybe_unused]] const SolverContext& sc) const
+    const SolverContext& sc) const
 {
     MRPT_START
 
     out = OptimalTF_Result();
 
+    // Planar point clouds, points only: closed-form SE(2) solution.
+    if (sc.se2 && pairings.paired_pt2pt.size() == pairings.size())
+        return optimal_tf_se2_closed_form(pairings, wp, out);
+
     // Compute the optimal pose:
     try
     {
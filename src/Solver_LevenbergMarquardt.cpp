@@ -0,0 +1,91 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_LevenbergMarquardt.cpp
+ * @brief  ICP registration for points and planes
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/Solver_LevenbergMarquardt.h>
+#include <mp2p_icp/optimal_tf_levenberg_marquardt.h>
+#include <mrpt/core/exceptions.h>
+
+IMPLEMENTS_MRPT_OBJECT(Solver_LevenbergMarquardt, mp2p_icp::Solver, mp2p_icp)
+
+using namespace mp2p_icp;
+
+void Solver_LevenbergMarquardt::initialize(const mrpt::containers::yaml& params)
+{
+    Solver::initialize(params);
+
+    MCP_LOAD_OPT(params, maxIterations);
+    MCP_LOAD_OPT(params, minDelta);
+    MCP_LOAD_OPT(params, initialLambdaFactor);
+
+    if (params.has("robustKernel"))
+    {
+        robustKernel = mrpt::typemeta::TEnumType<RobustKernel>::name2value(
+            params["robustKernel"].as<std::string>());
+    }
+    MCP_LOAD_OPT(params, robustKernelParam);
+}
+
+namespace
+{
+template <class PAIRINGS>
+bool solve_levenberg_marquardt(
+    const Solver_LevenbergMarquardt& s, const PAIRINGS& pairings,
+    OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc)
+{
+    out = OptimalTF_Result();
+
+    OptimalTF_LM_Parameters lmParams;
+    lmParams.maxInnerLoopIterations = s.maxIterations;
+    lmParams.minDelta               = s.minDelta;
+    lmParams.initialLambdaFactor    = s.initialLambdaFactor;
+    lmParams.kernel                 = s.robustKernel;
+    lmParams.kernelParam            = s.robustKernelParam;
+    lmParams.dofMask                = sc.dofMask;
+
+    ASSERT_(sc.guessRelativePose.has_value());
+    lmParams.linearizationPoint =
+        mrpt::poses::CPose3D(sc.guessRelativePose.value());
+
+    // Compute the optimal pose:
+    try
+    {
+        optimal_tf_levenberg_marquardt(pairings, wp, out, lmParams);
+    }
+    catch (const std::exception& e)
+    {
+        // Skip ill-defined problems if the no. of points is too small.
+        // Nothing we can do:
+        return false;
+    }
+
+    return true;
+}
+}  // namespace
+
+bool Solver_LevenbergMarquardt::impl_optimal_pose(
+    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc) const
+{
+    MRPT_START
+    return solve_levenberg_marquardt(*this, pairings, out, wp, sc);
+    MRPT_END
+}
+
+bool Solver_LevenbergMarquardt::impl_optimal_pose_compact(
+    const CompactPairings& pairings, OptimalTF_Result& out,
+    const WeightParameters& wp, const SolverContext& sc) const
+{
+    MRPT_START
+    return solve_levenberg_marquardt(*this, pairings, out, wp, sc);
+    MRPT_END
+}
@@ -0,0 +1,36 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_PointToPlaneLinear.cpp
+ * @brief  ICP registration for points and planes
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/Solver_PointToPlaneLinear.h>
+#include <mp2p_icp/optimal_tf_point2plane_linear.h>
+#include <mrpt/core/exceptions.h>
+
+IMPLEMENTS_MRPT_OBJECT(Solver_PointToPlaneLinear, mp2p_icp::Solver, mp2p_icp)
+
+using namespace mp2p_icp;
+
+bool Solver_PointToPlaneLinear::impl_optimal_pose(
+    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+    const SolverContext& sc) const
+{
+    MRPT_START
+
+    out = OptimalTF_Result();
+
+    ASSERT_(sc.guessRelativePose.has_value());
+
+    // Compute the optimal pose:
+    return optimal_tf_point2plane_linear(
+        pairings, wp, sc.guessRelativePose.value(), out, sc.dofMask);
+
+    MRPT_END
+}
@@ -0,0 +1,283 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   Solver_RANSAC.cpp
+ * @brief  Robust solver from minimal samples of point-to-point pairings
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/Solver_RANSAC.h>
+#include <mp2p_icp/optimal_tf_horn.h>
+#include <mrpt/core/exceptions.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "RigidTransform3.h"
+#include "run_in_parallel.h"
+
+IMPLEMENTS_MRPT_OBJECT(Solver_RANSAC, mp2p_icp::Solver, mp2p_icp)
+
+using namespace mp2p_icp;
+
+void Solver_RANSAC::initialize(const mrpt::containers::yaml& params)
+{
+    Solver::initialize(params);
+
+    MCP_LOAD_OPT(params, inlierThreshold);
+    MCP_LOAD_OPT(params, confidence);
+    MCP_LOAD_OPT(params, maxHypotheses);
+    MCP_LOAD_OPT(params, refineIterations);
+    MCP_LOAD_OPT(params, maxThreads);
+    MCP_LOAD_OPT(params, randomSeed);
+}
+
+namespace
+{
+// Invokes `f(i, isInlier)` for each pairing `i`, where `isInlier` is true if
+// the squared norm of the residual `this - pose (+) other` is below
+// `thresSqr`.
+template <class FUNCTOR>
+void visit_residuals(
+    const mrpt::tfest::TMatchingPairList& pairs,
+    const mrpt::poses::CPose3D& pose, const float thresSqr, FUNCTOR f)
+{
+    const RigidTransform3f tf(pose);
+
+    const std::size_t n = pairs.size();
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const auto& p = pairs[i];
+
+        float gx, gy, gz;
+        tf.composePoint(p.other_x, p.other_y, p.other_z, gx, gy, gz);
+
+        const float ex = gx - p.this_x, ey = gy - p.this_y,
+                    ez = gz - p.this_z;
+        f(i, ex * ex + ey * ey + ez * ez < thresSqr);
+    }
+}
+
+std::size_t count_inliers(
+    const mrpt::tfest::TMatchingPairList& pairs,
+    const mrpt::poses::CPose3D& pose, const float thresSqr)
+{
+    std::size_t n = 0;
+    visit_residuals(
+        pairs, pose, thresSqr,
+        [&n](std::size_t, const bool isInlier) { n += isInlier ? 1 : 0; });
+    return n;
+}
+
+// Number of hypotheses to draw such that at least one of them is free of
+// outliers with probability `confidence`, given the inlier ratio.
+std::size_t required_hypotheses(
+    const double inlierRatio, const double confidence,
+    const std::size_t maxHypotheses)
+{
+    const double pGoodSample = inlierRatio * inlierRatio * inlierRatio;
+    if (pGoodSample >= 1.0 - 1e-12) return 1;
+    if (pGoodSample <= 0) return maxHypotheses;
+
+    const double n = std::log(1.0 - confidence) / std::log(1.0 - pGoodSample);
+    if (n >= static_cast<double>(maxHypotheses)) return maxHypotheses;
+    return std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(n)));
+}
+
+struct Hypothesis
+{
+    std::array<std::size_t, 3> sample;
+    bool                       valid    = false;
+    std::size_t                nInliers = 0;
+    mrpt::poses::CPose3D       pose;
+};
+
+// Solves for the pose defined by a minimal sample of pairings. Returns false
+// for degenerate (aligned) samples.
+bool solve_minimal(
+    const Pairings& in, const std::array<std::size_t, 3>& sample,
+    const WeightParameters& wp, mrpt::poses::CPose3D& pose)
+{
+    Pairings minimal;
+    for (const auto i : sample)
+        minimal.paired_pt2pt.push_back(in.paired_pt2pt[i]);
+
+    const auto pt = [&](const std::size_t k) {
+        const auto& p = minimal.paired_pt2pt[k];
+        return mrpt::math::TPoint3D(p.this_x, p.this_y, p.this_z);
+    };
+    const auto v1 = pt(1) - pt(0), v2 = pt(2) - pt(0);
+    if (mrpt::math::crossProduct3D(v1, v2).norm() < 1e-6) return false;
+
+    try
+    {
+        OptimalTF_Result res;
+        optimal_tf_horn(minimal, wp, res);
+        pose = res.optimalPose;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool Solver_RANSAC::impl_optimal_pose(
+    const Pairings& pairings, OptimalTF_Result& out, const WeightParameters& wp,
+    [[maybe_unused]] const SolverContext& sc) const
+{
+    MRPT_START
+
+    out = OptimalTF_Result();
+
+    const std::size_t nPairs = pairings.paired_pt2pt.size();
+    if (nPairs < 3) return false;
+
+    ASSERT_GT_(inlierThreshold, 0.0);
+    ASSERT_GT_(confidence, 0.0);
+    ASSERT_LT_(confidence, 1.0);
+
+    const auto& data = pairings.paired_pt2pt;
+    const float thresSqr =
+        static_cast<float>(inlierThreshold * inlierThreshold);
+
+    // Minimal samples: just 3 points, no room for outlier rejection:
+    WeightParameters wpMinimal           = wp;
+    wpMinimal.use_scale_outlier_detector = false;
+    wpMinimal.use_robust_kernel          = false;
+
+    // Both the seed and the clock count are 64 bit, so seed the RNG with
+    // their two halves instead of truncating them:
+    const uint64_t seed =
+        randomSeed != 0
+            ? randomSeed
+            : static_cast<uint64_t>(
+                  std::chrono::system_clock::now().time_since_epoch().count());
+    std::seed_seq seedSeq{
+        static_cast<uint32_t>(seed & 0xffffffff),
+        static_cast<uint32_t>(seed >> 32)};
+    std::default_random_engine                 rng(seedSeq);
+    std::uniform_int_distribution<std::size_t> pick(0, nPairs - 1);
+
+    // Draw all samples serially, so results only depend on the seed:
+    std::vector<Hypothesis> hyps(maxHypotheses);
+    for (auto& h : hyps)
+    {
+        auto& s = h.sample;
+        for (std::size_t k = 0; k < s.size(); k++)
+        {
+            // Redraw repeated indices:
+            s[k] = pick(rng);
+            while (std::find(s.begin(), s.begin() + k, s[k]) != s.begin() + k)
+                s[k] = pick(rng);
+        }
+    }
+
+    // Hypotheses are scored by worker threads in any order, but the
+    // termination criterion only looks at the first `nDone` ones, all of them
+    // already scored, so the outcome is the same as scoring them in order.
+    // Hypotheses scored beyond that point when it stops are discarded.
+    Hypothesis               best;
+    std::size_t              nDone = 0;
+    std::vector<char>        scored(hyps.size(), 0);
+    std::atomic<std::size_t> nextHyp{0};
+    std::atomic<bool>        finished{hyps.empty()};
+    std::mutex               doneMtx;
+
+    const auto worker = [&](std::size_t) {
+        for (std::size_t i = nextHyp++; i < hyps.size() && !finished;
+             i = nextHyp++)
+        {
+            auto& h = hyps[i];
+            h.valid = solve_minimal(pairings, h.sample, wpMinimal, h.pose);
+            if (h.valid) h.nInliers = count_inliers(data, h.pose, thresSqr);
+
+            std::lock_guard<std::mutex> lck(doneMtx);
+            scored[i] = 1;
+            while (!finished && nDone < hyps.size() && scored[nDone])
+            {
+                const auto& hd = hyps[nDone++];
+                if (hd.valid && (!best.valid || hd.nInliers > best.nInliers))
+                    best = hd;
+
+                // Adaptive termination:
+                if (nDone == hyps.size() ||
+                    (best.valid &&
+                     nDone >= required_hypotheses(
+                                  static_cast<double>(best.nInliers) / nPairs,
+                                  confidence, maxHypotheses)))
+                    finished = true;
+            }
+        }
+    };
+
+    // One task per thread, each one scoring hypotheses until finished:
+    // (hardware_concurrency() may return 0 if unknown)
+    const std::size_t nThreads = std::max<std::size_t>(
+        1, std::min<std::size_t>(
+               maxThreads != 0 ? maxThreads
+                               : std::thread::hardware_concurrency(),
+               hyps.size()));
+    run_in_parallel(nThreads, nThreads, worker);
+
+    if (!best.valid || best.nInliers < 3) return false;
+
+    // Refine with all inliers:
+    out.optimalPose = best.pose;
+    for (uint32_t iter = 0; iter < refineIterations; iter++)
+    {
+        Pairings inliers;
+        inliers.paired_ln2ln  = pairings.paired_ln2ln;
+        inliers.paired_pl2pl  = pairings.paired_pl2pl;
+        inliers.weights.ln2ln = pairings.weights.ln2ln;
+        inliers.weights.pl2pl = pairings.weights.pl2pl;
+
+        const auto& ptWeights = pairings.weights.pt2pt;
+
+        visit_residuals(
+            data, out.optimalPose, thresSqr,
+            [&](const std::size_t i, const bool isInlier) {
+                if (!isInlier) return;
+                inliers.paired_pt2pt.push_back(pairings.paired_pt2pt[i]);
+
+                if (!ptWeights.empty())
+                    inliers.weights.pt2pt.push_back(ptWeights[i]);
+            });
+        if (inliers.paired_pt2pt.size() < 3) break;
+
+        try
+        {
+            OptimalTF_Result res;
+            optimal_tf_horn(inliers, wp, res);
+            out.optimalPose          = res.optimalPose;
+            out.outliers.line2line   = res.outliers.line2line;
+            out.outliers.plane2plane = res.outliers.plane2plane;
+        }
+        catch (const std::exception&)
+        {
+            break;
+        }
+    }
+
+    visit_residuals(
+        data, out.optimalPose, thresSqr,
+        [&](const std::size_t i, const bool isInlier) {
+            if (!isInlier) out.outliers.point2point.push_back(i);
+        });
+
+    return true;
+
+    MRPT_END
+}
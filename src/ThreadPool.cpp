@@ -0,0 +1,118 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   ThreadPool.cpp
+ * @brief  Persistent worker threads shared by all parallel loops.
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace mp2p_icp;
+
+ThreadPool& ThreadPool::Instance()
+{
+    // hardware_concurrency() may return 0 if unknown:
+    const std::size_t hw = std::thread::hardware_concurrency();
+    static ThreadPool pool(hw > 1 ? hw - 1 : 1);
+    return pool;
+}
+
+ThreadPool::ThreadPool(const std::size_t nThreads)
+{
+    workers_.reserve(nThreads);
+    for (std::size_t i = 0; i < nThreads; i++)
+        workers_.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lck(jobsMtx_);
+        stop_ = true;
+    }
+    jobsCv_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lck(jobsMtx_);
+            jobsCv_.wait(lck, [this]() { return stop_ || !jobs_.empty(); });
+            if (stop_) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+namespace
+{
+// State of one ThreadPool::run() call, shared with its helper jobs, which
+// may outlive it if they start late.
+struct RunState
+{
+    const std::function<void()>* work = nullptr;
+
+    std::mutex              mtx;
+    std::condition_variable cv;
+    bool                    closed = false;  //!< The caller is done
+    std::size_t             active = 0;  //!< Helpers running `work`
+};
+}  // namespace
+
+void ThreadPool::run(
+    const std::size_t nHelpers, const std::function<void()>& work)
+{
+    const std::size_t n = std::min(nHelpers, workers_.size());
+    if (n == 0)
+    {
+        work();
+        return;
+    }
+
+    auto st  = std::make_shared<RunState>();
+    st->work = &work;
+
+    {
+        std::lock_guard<std::mutex> lck(jobsMtx_);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            jobs_.emplace_back([st]() {
+                {
+                    std::lock_guard<std::mutex> l(st->mtx);
+                    if (st->closed) return;
+                    st->active++;
+                }
+                (*st->work)();
+
+                std::lock_guard<std::mutex> l(st->mtx);
+                if (--st->active == 0) st->cv.notify_all();
+            });
+        }
+    }
+    if (n == 1)
+        jobsCv_.notify_one();
+    else
+        jobsCv_.notify_all();
+
+    work();
+
+    // Wait only for helpers already running `work`, which references the
+    // caller's stack. Later ones will find `closed` set:
+    std::unique_lock<std::mutex> lck(st->mtx);
+    st->closed = true;
+    st->cv.wait(lck, [&]() { return st->active == 0; });
+}
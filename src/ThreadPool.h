@@ -0,0 +1,68 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   ThreadPool.h
+ * @brief  Persistent worker threads shared by all parallel loops.
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mp2p_icp
+{
+/** A fixed set of worker threads, created once and kept alive until the end
+ * of the process, so parallel loops run at each ICP iteration do not create
+ * and join threads. Use it through run_in_parallel().
+ */
+class ThreadPool
+{
+   public:
+    /** The process-wide pool, with one worker less than hardware threads
+     * (the calling thread of run() also works), and at least one. Created on
+     * first use. */
+    static ThreadPool& Instance();
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** Number of worker threads */
+    std::size_t size() const { return workers_.size(); }
+
+    /** Runs `work()` in the calling thread, and in up to `nHelpers` workers
+     * of the pool at the same time, and returns once all of them are done.
+     * `work` must not throw, and must return once there is nothing left to
+     * do, since it is run a variable number of times.
+     *
+     * Helpers which have not started when the calling thread returns from
+     * `work()` are skipped, not waited for. Hence, run() may be called from
+     * within `work()` of another run(), even with all workers busy, without
+     * deadlocks.
+     */
+    void run(const std::size_t nHelpers, const std::function<void()>& work);
+
+   private:
+    explicit ThreadPool(const std::size_t nThreads);
+
+    std::vector<std::thread>          workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex                        jobsMtx_;
+    std::condition_variable           jobsCv_;
+    bool                              stop_ = false;
+
+    void workerLoop();
+};
+
+}  // namespace mp2p_icp
@@ -0,0 +1,432 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   TiledPointCloud.cpp
+ * @brief  Out-of-core global map, split in tiles loaded on demand
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/MappedPointCloud.h>
+#include <mp2p_icp/TiledPointCloud.h>
+#include <mp2p_icp/morton_order.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/core/format.h>
+#include <mrpt/io/CFileInputStream.h>
+#include <mrpt/io/CFileOutputStream.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/rtti/CObject.h>
+#include <mrpt/serialization/CArchive.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "build_kdtrees.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+const char*   kIndexFileName = "tiles.idx";
+const char*   kIndexMagic    = "MP2PTILES";
+const uint8_t kIndexVersion  = 1;
+
+std::string tile_file_name(
+    const std::string& directory, const TiledPointCloud::TileIndex& idx)
+{
+    return mrpt::format(
+        "%s/tile_%d_%d_%d.mp2pcol", directory.c_str(), idx[0], idx[1],
+        idx[2]);
+}
+
+TiledPointCloud::TileIndex tile_of(
+    const double x, const double y, const double z, const double tileSize)
+{
+    return {
+        static_cast<int32_t>(std::floor(x / tileSize)),
+        static_cast<int32_t>(std::floor(y / tileSize)),
+        static_cast<int32_t>(std::floor(z / tileSize))};
+}
+
+// An empty points map of the same class as `pts`:
+mrpt::maps::CPointsMap::Ptr empty_like(const mrpt::maps::CPointsMap& pts)
+{
+    auto m = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+        mrpt::rtti::classFactory(pts.GetRuntimeClass()->className));
+    if (!m) m = mrpt::maps::CSimplePointsMap::Create();
+    return m;
+}
+
+// Bounding box of all local layers, in the local frame. Points maps cache
+// their bounding box, so only external layers are scanned:
+void local_bounding_box(
+    const pointcloud_t& pcLocal, mrpt::math::TPoint3D& bbMin,
+    mrpt::math::TPoint3D& bbMax)
+{
+    const double big = std::numeric_limits<double>::max();
+    bbMin            = {big, big, big};
+    bbMax            = {-big, -big, -big};
+
+    const auto extend = [&](const double x, const double y, const double z) {
+        bbMin.x = std::min(bbMin.x, x);
+        bbMin.y = std::min(bbMin.y, y);
+        bbMin.z = std::min(bbMin.z, z);
+        bbMax.x = std::max(bbMax.x, x);
+        bbMax.y = std::max(bbMax.y, y);
+        bbMax.z = std::max(bbMax.z, z);
+    };
+
+    for (const auto& l : pcLocal.point_layers)
+    {
+        if (!l.second || l.second->empty()) continue;
+
+        mrpt::math::TPoint3D lMin, lMax;
+        l.second->boundingBox(lMin, lMax);
+        extend(lMin.x, lMin.y, lMin.z);
+        extend(lMax.x, lMax.y, lMax.z);
+    }
+    for (const auto& l : pcLocal.external_layers)
+    {
+        const PointsView& v = l.second;
+        for (std::size_t i = 0; i < v.size(); i++)
+            extend(v.x(i), v.y(i), v.z(i));
+    }
+}
+
+// Bounding box of a local box, once transformed with `pose`:
+void transform_box(
+    const mrpt::math::TPoint3D& lMin, const mrpt::math::TPoint3D& lMax,
+    const mrpt::poses::CPose3D& pose, mrpt::math::TPoint3D& gMin,
+    mrpt::math::TPoint3D& gMax)
+{
+    const double big = std::numeric_limits<double>::max();
+    gMin             = {big, big, big};
+    gMax             = {-big, -big, -big};
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const mrpt::math::TPoint3D c = pose.composePoint(
+            {(corner & 1) ? lMax.x : lMin.x, (corner & 2) ? lMax.y : lMin.y,
+             (corner & 4) ? lMax.z : lMin.z});
+        for (int k = 0; k < 3; k++)
+        {
+            gMin[k] = std::min(gMin[k], c[k]);
+            gMax[k] = std::max(gMax[k], c[k]);
+        }
+    }
+}
+}  // namespace
+
+void mp2p_icp::save_tiled(
+    const pointcloud_t& pc, const std::string& directory,
+    const double tileSize)
+{
+    MRPT_START
+
+    ASSERT_GT_(tileSize, 0.0);
+
+    std::map<TiledPointCloud::TileIndex, pointcloud_t> tiles;
+
+    for (const auto& [name, pts] : pc.point_layers)
+    {
+        ASSERT_(pts);
+        const auto& xs = pts->getPointsBufferRef_x();
+        const auto& ys = pts->getPointsBufferRef_y();
+        const auto& zs = pts->getPointsBufferRef_z();
+
+        for (std::size_t i = 0; i < xs.size(); i++)
+        {
+            auto& layer = tiles[tile_of(xs[i], ys[i], zs[i], tileSize)]
+                              .point_layers[name];
+            if (!layer) layer = empty_like(*pts);
+            layer->insertPointFast(xs[i], ys[i], zs[i]);
+        }
+    }
+    for (const auto& p : pc.planes)
+    {
+        const auto& c = p.centroid;
+        tiles[tile_of(c.x, c.y, c.z, tileSize)].planes.push_back(p);
+    }
+    for (const auto& l : pc.lines)
+    {
+        const auto& b = l.pBase;
+        tiles[tile_of(b.x, b.y, b.z, tileSize)].lines.push_back(l);
+    }
+
+    for (auto& [idx, tile] : tiles)
+    {
+        for (auto& layer : tile.point_layers) layer.second->mark_as_modified();
+
+        // Saved in Z-order, so the KD-tree queries of the loaded tiles are
+        // cache friendly:
+        reorder_layers_morton(tile);
+
+        save_columnar(tile, tile_file_name(directory, idx));
+    }
+
+    mrpt::io::CFileOutputStream f;
+    if (!f.open(directory + "/" + kIndexFileName))
+        THROW_EXCEPTION_FMT(
+            "Cannot write tile index in '%s'", directory.c_str());
+
+    auto arch = mrpt::serialization::archiveFrom(f);
+    arch << std::string(kIndexMagic);
+    arch.WriteAs<uint8_t>(kIndexVersion);
+    arch << tileSize;
+    arch.WriteAs<uint32_t>(tiles.size());
+    for (const auto& t : tiles) arch << t.first[0] << t.first[1] << t.first[2];
+
+    MRPT_END
+}
+
+TiledPointCloud::TiledPointCloud(
+    const std::string& directory, const std::size_t maxCachedTiles)
+    : directory_(directory), maxCachedTiles_(maxCachedTiles)
+{
+    MRPT_START
+
+    ASSERT_GT_(maxCachedTiles_, 0U);
+
+    mrpt::io::CFileInputStream f;
+    if (!f.open(directory_ + "/" + kIndexFileName))
+        THROW_EXCEPTION_FMT(
+            "Cannot open tile index in '%s'", directory_.c_str());
+
+    auto        arch = mrpt::serialization::archiveFrom(f);
+    std::string magic;
+    arch >> magic;
+    ASSERTMSG_(magic == kIndexMagic, "Not a tiled point cloud index file");
+    const auto version = arch.ReadAs<uint8_t>();
+    ASSERT_EQUAL_(version, kIndexVersion);
+
+    arch >> tileSize_;
+    ASSERT_GT_(tileSize_, 0.0);
+
+    const auto nTiles = arch.ReadAs<uint32_t>();
+    for (uint32_t i = 0; i < nTiles; i++)
+    {
+        TileIndex idx;
+        arch >> idx[0] >> idx[1] >> idx[2];
+        tiles_.insert(idx);
+    }
+
+    MRPT_END
+}
+
+TiledPointCloud::~TiledPointCloud()
+{
+    std::lock_guard<std::mutex> lck(prefetchesMtx_);
+    for (auto& p : prefetches_) p.wait();
+}
+
+TiledPointCloud::TileIndex TiledPointCloud::tileOf(
+    const mrpt::math::TPoint3D& p) const
+{
+    return tile_of(p.x, p.y, p.z, tileSize_);
+}
+
+std::shared_ptr<const pointcloud_t> TiledPointCloud::tile(const TileIndex& idx)
+{
+    MRPT_START
+
+    if (tiles_.count(idx) == 0) return {};
+
+    std::promise<std::shared_ptr<const pointcloud_t>>       loader;
+    std::shared_future<std::shared_ptr<const pointcloud_t>> result;
+    bool                                                    mustLoad = false;
+    uint64_t                                                loadId   = 0;
+    {
+        std::lock_guard<std::mutex> lck(cacheMtx_);
+
+        if (auto it = cache_.find(idx); it != cache_.end())
+        {
+            // Hit: move to the front of the LRU list.
+            lru_.splice(lru_.begin(), lru_, it->second.lruIt);
+            result = it->second.tile;
+        }
+        else
+        {
+            // Miss: evict the least recently used tiles, and reserve the
+            // entry so other threads wait for this one to load it.
+            while (cache_.size() >= maxCachedTiles_)
+            {
+                cache_.erase(lru_.back());
+                lru_.pop_back();
+            }
+            lru_.push_front(idx);
+            result      = loader.get_future().share();
+            loadId      = nextLoadId_++;
+            cache_[idx] = {result, lru_.begin(), loadId};
+            mustLoad    = true;
+        }
+    }
+
+    if (mustLoad)
+    {
+        try
+        {
+            const MappedPointCloud m(tile_file_name(directory_, idx));
+            auto t = std::make_shared<const pointcloud_t>(m.toPointCloud());
+
+            // Tiles are shared by threads and by assembled maps, so build
+            // their KD-trees once, before publishing them:
+            build_kdtrees(*t, t->isPlanar());
+            loader.set_value(t);
+        }
+        catch (...)
+        {
+            // Do not keep the failed entry, so it may be retried, unless it
+            // was evicted meanwhile and the entry is now another loader's:
+            {
+                std::lock_guard<std::mutex> lck(cacheMtx_);
+                if (auto it = cache_.find(idx);
+                    it != cache_.end() && it->second.loadId == loadId)
+                {
+                    lru_.erase(it->second.lruIt);
+                    cache_.erase(it);
+                }
+            }
+            loader.set_exception(std::current_exception());
+        }
+    }
+
+    return result.get();
+
+    MRPT_END
+}
+
+std::vector<TiledPointCloud::TileIndex> TiledPointCloud::tilesInBox(
+    const mrpt::math::TPoint3D& bbMin, const mrpt::math::TPoint3D& bbMax,
+    const double margin) const
+{
+    std::vector<TileIndex> out;
+    if (bbMin.x > bbMax.x) return out;  // empty box
+
+    const auto lo = tile_of(
+        bbMin.x - margin, bbMin.y - margin, bbMin.z - margin, tileSize_);
+    const auto hi = tile_of(
+        bbMax.x + margin, bbMax.y + margin, bbMax.z + margin, tileSize_);
+
+    // Iterate over the existing tiles instead of all tiles in the box, since
+    // it is cheaper for large boxes, and as cheap for small ones:
+    for (auto it = tiles_.lower_bound(lo); it != tiles_.end(); ++it)
+    {
+        const auto& t = *it;
+        if (t[0] > hi[0]) break;
+        if (t[1] >= lo[1] && t[1] <= hi[1] && t[2] >= lo[2] && t[2] <= hi[2])
+            out.push_back(t);
+    }
+    return out;
+}
+
+std::shared_ptr<const pointcloud_t> TiledPointCloud::mapAround(
+    const mrpt::math::TPoint3D& bbMin, const mrpt::math::TPoint3D& bbMax,
+    const double margin)
+{
+    MRPT_START
+
+    const auto idxs = tilesInBox(bbMin, bbMax, margin);
+
+    // Reuse the last map while it covers all the requested tiles:
+    {
+        std::lock_guard<std::mutex> lck(lastMapMtx_);
+        if (lastMap_ && std::includes(
+                            lastMapTiles_.begin(), lastMapTiles_.end(),
+                            idxs.begin(), idxs.end()))
+            return lastMap_;
+    }
+
+    // Otherwise, assemble a new one, with half a tile of extra margin so
+    // small motions are still covered by it. Tiles are loaded and merged
+    // without holding the lock, so other threads are not blocked on I/O.
+    // Merging (shallow) copies of the tiles shares the layers found in just
+    // one tile, along with their KD-trees; others are copied and appended:
+    const auto newIdxs = tilesInBox(bbMin, bbMax, margin + 0.5 * tileSize_);
+
+    auto map = std::make_shared<pointcloud_t>();
+    for (const auto& idx : newIdxs) map->mergeWith(pointcloud_t(*tile(idx)));
+
+    // The map is shared by all callers until the next re-assembly:
+    build_kdtrees(*map, map->isPlanar());
+
+    std::lock_guard<std::mutex> lck(lastMapMtx_);
+    lastMapTiles_ = newIdxs;
+    lastMap_      = map;
+    return map;
+
+    MRPT_END
+}
+
+std::shared_ptr<const pointcloud_t> TiledPointCloud::mapFor(
+    const pointcloud_t& pcLocal, const mrpt::poses::CPose3D& localPose,
+    const double margin)
+{
+    mrpt::math::TPoint3D lMin, lMax, gMin, gMax;
+    local_bounding_box(pcLocal, lMin, lMax);
+    if (lMin.x > lMax.x) return mapAround(lMin, lMax, margin);
+
+    transform_box(lMin, lMax, localPose, gMin, gMax);
+    return mapAround(gMin, gMax, margin);
+}
+
+void TiledPointCloud::prefetch(
+    const pointcloud_t&                      pcLocal,
+    const std::vector<mrpt::poses::CPose3D>& predictedPoses,
+    const double                             margin)
+{
+    MRPT_START
+
+    mrpt::math::TPoint3D lMin, lMax;
+    local_bounding_box(pcLocal, lMin, lMax);
+    if (lMin.x > lMax.x) return;
+
+    std::set<TileIndex> idxs;
+    for (const auto& pose : predictedPoses)
+    {
+        mrpt::math::TPoint3D gMin, gMax;
+        transform_box(lMin, lMax, pose, gMin, gMax);
+        for (const auto& idx : tilesInBox(gMin, gMax, margin))
+            idxs.insert(idx);
+    }
+    if (idxs.empty()) return;
+
+    std::lock_guard<std::mutex> lck(prefetchesMtx_);
+
+    // Forget about finished prefetches:
+    prefetches_.erase(
+        std::remove_if(
+            prefetches_.begin(), prefetches_.end(),
+            [](const std::future<void>& f) {
+                return f.wait_for(std::chrono::seconds(0)) ==
+                       std::future_status::ready;
+            }),
+        prefetches_.end());
+
+    prefetches_.emplace_back(
+        std::async(std::launch::async, [this, idxs = std::move(idxs)]() {
+            for (const auto& idx : idxs)
+            {
+                // Errors are reported when the tile is actually requested.
+                try
+                {
+                    tile(idx);
+                }
+                catch (const std::exception&)
+                {
+                }
+            }
+        }));
+
+    MRPT_END
+}
+
+std::size_t TiledPointCloud::cachedTileCount() const
+{
+    std::lock_guard<std::mutex> lck(cacheMtx_);
+    return cache_.size();
+}
@@ -0,0 +1,63 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   anderson_acceleration.cpp
+ * @brief  Anderson acceleration of fixed-point iterations in R^6
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/anderson_acceleration.h>
+
+using namespace mp2p_icp;
+
+void AndersonAcceleration::reset()
+{
+    dG_.clear();
+    dF_.clear();
+    prevG_.reset();
+    prevF_.reset();
+}
+
+AndersonAcceleration::vector6_t AndersonAcceleration::compute(
+    const vector6_t& u, const vector6_t& g)
+{
+    const vector6_t f = g - u;
+
+    if (prevG_)
+    {
+        dG_.push_back(g - *prevG_);
+        dF_.push_back(f - *prevF_);
+        if (dG_.size() > m_)
+        {
+            dG_.pop_front();
+            dF_.pop_front();
+        }
+    }
+    prevG_ = g;
+    prevF_ = f;
+
+    if (dF_.empty()) return g;
+
+    // Unconstrained form: gamma = argmin |f - dF * gamma|
+    const auto       n = static_cast<Eigen::Index>(dF_.size());
+    Eigen::MatrixXd  dF(6, n), dG(6, n);
+    for (Eigen::Index i = 0; i < n; i++)
+    {
+        dF.col(i) = dF_[i];
+        dG.col(i) = dG_[i];
+    }
+
+    const Eigen::VectorXd gamma = dF.colPivHouseholderQr().solve(f);
+
+    const vector6_t next = g - dG * gamma;
+    if (!next.allFinite())
+    {
+        reset();
+        return g;
+    }
+    return next;
+}
@@ -0,0 +1,44 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   build_kdtrees.h
+ * @brief  Builds the lazily-built KD-trees of point layers beforehand.
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/maps/CPointsMap.h>
+
+namespace mp2p_icp
+{
+/** Builds the KD-tree and the bounding box of a points map, which are
+ * otherwise computed and cached on their first query, so later queries from
+ * several threads only read them. The 2D KD-tree, used in SE(2) mode, is only
+ * built if `also2D` is true. A no-op if already built.
+ */
+inline void build_kdtree(const mrpt::maps::CPointsMap& pts, const bool also2D)
+{
+    if (pts.empty()) return;
+
+    float sqrDist;
+    pts.kdTreeClosestPoint3D(0, 0, 0, sqrDist);
+    if (also2D) pts.kdTreeClosestPoint2D(0, 0, sqrDist);
+
+    // All matchers check the bounding box of global layers first:
+    float x0, x1, y0, y1, z0, z1;
+    pts.boundingBox(x0, x1, y0, y1, z0, z1);
+}
+
+/** Runs build_kdtree() on all point layers of a point cloud. */
+inline void build_kdtrees(const pointcloud_t& pc, const bool also2D)
+{
+    for (const auto& layer : pc.point_layers)
+        if (layer.second) build_kdtree(*layer.second, also2D);
+}
+
+}  // namespace mp2p_icp
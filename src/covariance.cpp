@@ -15,6 +15,7 @@
 #include <mrpt/math/num_jacobian.h>
 
 #include <Eigen/Dense>
+#include <vector>
 
 using namespace mp2p_icp;
 
@@ -33,7 +34,7 @@ mrpt::math::CMatrixDouble66 mp2p_icp::covariance(
     mrpt::math::CMatrixDouble61 xInitial;
     xInitial[0] = finalAlignSolution.x();
     xInitial[1] = finalAlignSolution.y();
-    xInitial[0] = finalAlignSolution.x();
+    xInitial[2] = finalAlignSolution.z();
     xInitial[3] = finalAlignSolution.yaw();
     xInitial[4] = finalAlignSolution.pitch();
     xInitial[5] = finalAlignSolution.roll();
@@ -59,9 +60,10 @@ mrpt::math::CMatrixDouble66 mp2p_icp::covariance(
         const auto nPt2Pl = in.paired_pt2pl.size();
         const auto nPl2Pl = in.paired_pl2pl.size();
         const auto nLn2Ln = in.paired_ln2ln.size();
+        const auto nSym   = in.paired_pt2pl_sym.size();
 
         const auto nErrorTerms =
-            (nPt2Pt + nPl2Pl) * 3 + nPt2Pl + nPt2Ln + nLn2Ln * 4;
+            (nPt2Pt + nPl2Pl) * 3 + nPt2Pl + nPt2Ln + nLn2Ln * 4 + nSym;
         ASSERT_(nErrorTerms > 0);
         err.resize(nErrorTerms);
 
@@ -96,7 +98,7 @@ mrpt::math::CMatrixDouble66 mp2p_icp::covariance(
                 mp2p_icp::error_line2line(p, pose);
             err.block<4, 1>(base_idx + idx_ln * 4, 0) = ret.asEigen();
         }
-        base_idx += nLn2Ln;
+        base_idx += nLn2Ln * 4;
 
         // Point-to-plane:
         for (size_t idx_pl = 0; idx_pl < nPt2Pl; idx_pl++)
@@ -118,6 +120,16 @@ mrpt::math::CMatrixDouble66 mp2p_icp::covariance(
                 mp2p_icp::error_plane2plane(p, pose);
             err.block<3, 1>(idx_pl * 3 + base_idx, 0) = ret.asEigen();
         }
+        base_idx += nPl2Pl * 3;
+
+        // Symmetric point-to-plane:
+        for (size_t idx_pl = 0; idx_pl < nSym; idx_pl++)
+        {
+            const auto&                       p = in.paired_pt2pl_sym[idx_pl];
+            mrpt::math::CVectorFixedDouble<1> ret =
+                mp2p_icp::error_point2plane_sym(p, pose);
+            err.block<1, 1>(idx_pl + base_idx, 0) = ret.asEigen();
+        }
     };
 
     // Do NOT use "Eigen::MatrixXd", it may have different alignment
@@ -130,10 +142,38 @@ mrpt::math::CMatrixDouble66 mp2p_icp::covariance(
             mrpt::math::CVectorDouble&)>(errorLambda),
         xIncrs, lmbParams, jacob);
 
-    const mrpt::math::CMatrixDouble66 hessian(
-        jacob.asEigen().transpose() * jacob.asEigen());
+    if (param.dofMask.allFree())
+    {
+        const mrpt::math::CMatrixDouble66 hessian(
+            jacob.asEigen().transpose() * jacob.asEigen());
+
+        const mrpt::math::CMatrixDouble66 cov = hessian.inverse_LLt();
+
+        return cov;
+    }
 
-    const mrpt::math::CMatrixDouble66 cov = hessian.inverse_LLt();
+    // Reduced problem, for the free DOFs only, in the same order than the
+    // columns of the Jacobian (x,y,z,yaw,pitch,roll):
+    const auto&      m         = param.dofMask;
+    const bool       isFree[6] = {m.x, m.y, m.z, m.yaw, m.pitch, m.roll};
+    std::vector<int> freeCols;
+    for (int i = 0; i < 6; i++)
+        if (isFree[i]) freeCols.push_back(i);
+    const auto k = static_cast<Eigen::Index>(freeCols.size());
+
+    Eigen::MatrixXd jacobFree(jacob.rows(), k);
+    for (Eigen::Index c = 0; c < k; c++)
+        jacobFree.col(c) = jacob.asEigen().col(freeCols[c]);
+
+    const Eigen::MatrixXd hessian = jacobFree.transpose() * jacobFree;
+    const Eigen::MatrixXd covFree =
+        hessian.llt().solve(Eigen::MatrixXd::Identity(k, k));
+
+    mrpt::math::CMatrixDouble66 cov;
+    cov.setZero();
+    for (Eigen::Index r = 0; r < k; r++)
+        for (Eigen::Index c = 0; c < k; c++)
+            cov(freeCols[r], freeCols[c]) = covFree(r, c);
 
     return cov;
 }
@@ -147,6 +147,40 @@ mrpt::math::CVectorFixedDouble<1> mp2p_icp::error_point2plane(
     MRPT_END
 }
 
+mrpt::math::CVectorFixedDouble<1> mp2p_icp::error_point2plane_sym(
+    const mp2p_icp::point_plane_sym_pair_t&                     pairing,
+    const mrpt::poses::CPose3D&                                 relativePose,
+    mrpt::optional_ref<mrpt::math::CMatrixFixed<double, 1, 12>> jacobian)
+{
+    MRPT_START
+    mrpt::math::CVectorFixedDouble<1> error;
+
+    const mrpt::math::TPoint3D  p(pairing.pt_other), q(pairing.pt_this);
+    const mrpt::math::TVector3D np(pairing.n_other), nq(pairing.n_this);
+
+    // Local point and normal, in the global frame:
+    mrpt::math::TPoint3D g;
+    relativePose.composePoint(p, g);
+    const mrpt::math::TVector3D gn = relativePose.rotateVector(np);
+
+    const mrpt::math::TVector3D d = g - q;
+    const mrpt::math::TVector3D n = gn + nq;
+
+    error[0] = d.x * n.x + d.y * n.y + d.z * n.z;
+    if (jacobian)
+    {
+        // de/dR(i,j) = p_j * n_i + np_j * d_i  ;  de/dt_i = n_i
+        // (12 pose entries: R in column-major order, then t)
+        auto& J = jacobian.value().get();
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 3; i++)
+                J(0, j * 3 + i) = p[j] * n[i] + np[j] * d[i];
+        for (int i = 0; i < 3; i++) J(0, 9 + i) = n[i];
+    }
+    return error;
+    MRPT_END
+}
+
 mrpt::math::CVectorFixedDouble<4> mp2p_icp::error_line2line(
     const mp2p_icp::matched_line_t&            pairing,
     const mrpt::poses::CPose3D&                relativePose,
@@ -0,0 +1,121 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   estimate_normals.cpp
+ * @brief  Batch estimation of normals for whole point layers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/estimate_normals.h>
+#include <mp2p_icp/estimate_points_eigen.h>
+#include <mrpt/core/bits_math.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/core/format.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "run_in_parallel.h"
+
+using namespace mp2p_icp;
+
+PointNormals::Ptr mp2p_icp::estimate_normals(
+    const mrpt::maps::CPointsMap& pts, const NormalEstimationParameters& p)
+{
+    MRPT_START
+
+    ASSERT_GE_(p.knn, 3U);
+
+    const std::size_t n   = pts.size();
+    auto              out = PointNormals::Create();
+    out->resize(n);
+    if (n == 0) return out;
+
+    const auto& xs = pts.getPointsBufferRef_x();
+    const auto& ys = pts.getPointsBufferRef_y();
+    const auto& zs = pts.getPointsBufferRef_z();
+
+    // Build the KD-tree here, not from the first parallel query:
+    {
+        float sqrDist;
+        pts.kdTreeClosestPoint3D(xs[0], ys[0], zs[0], sqrDist);
+    }
+
+    float maxDistSqr = std::numeric_limits<float>::max();
+    if (p.maxDistance > 0)
+        maxDistSqr = static_cast<float>(mrpt::square(p.maxDistance));
+
+    // Chunks of consecutive points, big enough to amortize the scheduling:
+    constexpr std::size_t chunkSize = 1024;
+    const std::size_t     nChunks   = (n + chunkSize - 1) / chunkSize;
+
+    run_in_parallel(nChunks, p.maxThreads, [&](const std::size_t chunk) {
+        std::vector<float>  sqrDists;
+        std::vector<size_t> idxs;
+
+        const std::size_t i1 = std::min(n, (chunk + 1) * chunkSize);
+        for (std::size_t i = chunk * chunkSize; i < i1; i++)
+        {
+            pts.kdTreeNClosestPoint3DIdx(
+                xs[i], ys[i], zs[i], p.knn, idxs, sqrDists);
+
+            // Neighbors are sorted by distance:
+            for (size_t j = 0; j < sqrDists.size(); j++)
+            {
+                if (sqrDists[j] > maxDistSqr)
+                {
+                    idxs.resize(j);
+                    break;
+                }
+            }
+            if (idxs.size() < 3) continue;  // (all attributes left as 0)
+
+            const PointCloudEigen eig = estimate_points_eigen(
+                xs.data(), ys.data(), zs.data(), idxs);
+
+            const double e0 = eig.eigVals[0], e1 = eig.eigVals[1],
+                         e2 = eig.eigVals[2];
+            if (!(e2 > 0)) continue;  // all neighbors at the same position
+
+            const auto& nv    = eig.eigVectors[0];
+            out->nx[i]        = static_cast<float>(nv.x);
+            out->ny[i]        = static_cast<float>(nv.y);
+            out->nz[i]        = static_cast<float>(nv.z);
+            out->curvature[i] = static_cast<float>(e0 / (e0 + e1 + e2));
+            out->ratio02[i]   = static_cast<float>(e0 / e2);
+            out->ratio12[i]   = static_cast<float>(e1 / e2);
+            out->valid[i]     = 1;
+        }
+    });
+
+    return out;
+
+    MRPT_END
+}
+
+void mp2p_icp::estimate_normals(
+    pointcloud_t& pc, const NormalEstimationParameters& p,
+    const std::vector<std::string>& layers)
+{
+    MRPT_START
+
+    std::vector<std::string> names = layers;
+    if (names.empty())
+        for (const auto& l : pc.point_layers) names.push_back(l.first);
+
+    for (const auto& name : names)
+    {
+        const auto it = pc.point_layers.find(name);
+        ASSERTMSG_(
+            it != pc.point_layers.end(),
+            mrpt::format("No point layer named '%s'", name.c_str()));
+
+        pc.layer_normals[name] = estimate_normals(*it->second, p);
+    }
+
+    MRPT_END
+}
@@ -0,0 +1,386 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   linearize_pairings.cpp
+ * @brief  Normal equations of the SE(3) least-squares registration problem
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include "linearize_pairings.h"
+
+#include <mp2p_icp/errorTerms.h>
+#include <mrpt/poses/Lie/SE.h>
+
+#include <vector>
+
+#include "RigidTransform3.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+template <int N>
+using jacob_t = mrpt::math::CMatrixFixed<double, N, 12>;
+
+template <int N>
+mrpt::optional_ref<jacob_t<N>> optionalJacob(jacob_t<N>& J, const bool b)
+{
+    if (b) return J;
+    return std::nullopt;
+}
+
+using dpose_de_t = Eigen::Matrix<double, 12, 6>;
+
+// Adds one error term of dimension N to the normal equations (not to the
+// cost), with weight `wH` in the Hessian and `wG` in the gradient.
+template <int N>
+void accumulate(
+    LinearizedPairings& eq, const double wH, const double wG,
+    const mrpt::math::CVectorFixedDouble<N>& err, const jacob_t<N>& J1,
+    const dpose_de_t& dpose_de, const bool computeJacobians)
+{
+    if (!computeJacobians) return;
+
+    const Eigen::Matrix<double, N, 6> J = J1.asEigen() * dpose_de;
+
+    eq.H.noalias() += wH * J.transpose() * J;
+    eq.g.noalias() += wG * J.transpose() * err.asEigen();
+}
+
+// Invokes `f(w, err, J1)` for each error term of all pairings, where `w` is
+// its (non-robust) weight, `err` its residual, and `J1` the Jacobian of the
+// residual wrt the 12 entries of the pose (only if `withJacobians`).
+template <class FUNCTOR>
+void visit_error_terms(
+    const Pairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose, const bool withJacobians,
+    FUNCTOR f)
+{
+    const auto& w  = wp.pair_weights;
+    const auto& iw = in.weights;
+
+    // Point-to-point:
+    for (std::size_t i = 0; i < in.paired_pt2pt.size(); i++)
+    {
+        jacob_t<3> J1;
+        const auto err = error_point2point(
+            in.paired_pt2pt[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pt, i, w.pt2pt), err, J1);
+    }
+
+    // Point-to-line:
+    for (std::size_t i = 0; i < in.paired_pt2ln.size(); i++)
+    {
+        jacob_t<1> J1;
+        const auto err = error_point2line(
+            in.paired_pt2ln[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2ln, i, w.pt2ln), err, J1);
+    }
+
+    // Line-to-line:
+    for (std::size_t i = 0; i < in.paired_ln2ln.size(); i++)
+    {
+        jacob_t<4> J1;
+        const auto err = error_line2line(
+            in.paired_ln2ln[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.ln2ln, i, w.ln2ln), err, J1);
+    }
+
+    // Point-to-plane:
+    for (std::size_t i = 0; i < in.paired_pt2pl.size(); i++)
+    {
+        jacob_t<1> J1;
+        const auto err = error_point2plane(
+            in.paired_pt2pl[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pl, i, w.pt2pl), err, J1);
+    }
+
+    // Symmetric point-to-plane (same weight than point-to-plane):
+    for (std::size_t i = 0; i < in.paired_pt2pl_sym.size(); i++)
+    {
+        jacob_t<1> J1;
+        const auto err = error_point2plane_sym(
+            in.paired_pt2pl_sym[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pl_sym, i, w.pt2pl), err, J1);
+    }
+
+    // Plane-to-plane (only direction of normal vectors):
+    for (std::size_t i = 0; i < in.paired_pl2pl.size(); i++)
+    {
+        jacob_t<3> J1;
+        const auto err = error_plane2plane(
+            in.paired_pl2pl[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pl2pl, i, w.pl2pl), err, J1);
+    }
+}
+
+// Same as above, for pairings in compact form. Each pairing is gathered from
+// the coordinate arrays into a temporary, to reuse the error functions.
+template <class FUNCTOR>
+void visit_error_terms(
+    const CompactPairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose, const bool withJacobians,
+    FUNCTOR f)
+{
+    const auto& w  = wp.pair_weights;
+    const auto& iw = in.weights;
+
+    // Point-to-point:
+    const auto& pp = in.pt2pt;
+    for (std::size_t i = 0; i < pp.size(); i++)
+    {
+        mrpt::tfest::TMatchingPair p;
+        p.this_x  = pp.this_x[i];
+        p.this_y  = pp.this_y[i];
+        p.this_z  = pp.this_z[i];
+        p.other_x = pp.other_x[i];
+        p.other_y = pp.other_y[i];
+        p.other_z = pp.other_z[i];
+
+        jacob_t<3> J1;
+        const auto err = error_point2point(
+            p, relativePose, optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pt, i, w.pt2pt), err, J1);
+    }
+
+    // Point-to-line:
+    for (std::size_t i = 0; i < in.paired_pt2ln.size(); i++)
+    {
+        jacob_t<1> J1;
+        const auto err = error_point2line(
+            in.paired_pt2ln[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2ln, i, w.pt2ln), err, J1);
+    }
+
+    // Line-to-line:
+    for (std::size_t i = 0; i < in.paired_ln2ln.size(); i++)
+    {
+        jacob_t<4> J1;
+        const auto err = error_line2line(
+            in.paired_ln2ln[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.ln2ln, i, w.ln2ln), err, J1);
+    }
+
+    // Point-to-plane (the error only depends on the plane coefficients):
+    const auto& pl  = in.pt2pl;
+    const auto& tbl = in.planes;
+    for (std::size_t i = 0; i < pl.size(); i++)
+    {
+        const uint32_t     k = pl.plane_idx[i];
+        point_plane_pair_t p;
+        p.pl_this.plane.coefs[0] = tbl.nx[k];
+        p.pl_this.plane.coefs[1] = tbl.ny[k];
+        p.pl_this.plane.coefs[2] = tbl.nz[k];
+        p.pl_this.plane.coefs[3] = tbl.d[k];
+        p.pt_other = {pl.other_x[i], pl.other_y[i], pl.other_z[i]};
+
+        jacob_t<1> J1;
+        const auto err = error_point2plane(
+            p, relativePose, optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pl, i, w.pt2pl), err, J1);
+    }
+
+    // Symmetric point-to-plane (same weight than point-to-plane):
+    for (std::size_t i = 0; i < in.pt2pl_sym.size(); i++)
+    {
+        jacob_t<1> J1;
+        const auto err = error_point2plane_sym(
+            in.pt2pl_sym.at(i), relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pt2pl_sym, i, w.pt2pl), err, J1);
+    }
+
+    // Plane-to-plane (only direction of normal vectors):
+    for (std::size_t i = 0; i < in.paired_pl2pl.size(); i++)
+    {
+        jacob_t<3> J1;
+        const auto err = error_plane2plane(
+            in.paired_pl2pl[i], relativePose,
+            optionalJacob(J1, withJacobians));
+        f(pairing_weight(iw.pl2pl, i, w.pl2pl), err, J1);
+    }
+}
+
+// Jacobian of the 12 pose entries (R in column-major order, then t) of
+// exp(e) (+) P, wrt the free components of a global-frame increment
+// e=[v w], such that R'=exp(w)*R, t'=exp(w)*t+v. Columns of fixed DOFs are
+// dropped, and the remaining ones packed to the left.
+dpose_de_t jacob_dexpeD_de_free(
+    const mrpt::poses::CPose3D& P, const std::vector<int>& freeIdxs)
+{
+    const Eigen::Matrix3d R = P.getRotationMatrix().asEigen();
+    const Eigen::Vector3d t(P.x(), P.y(), P.z());
+
+    dpose_de_t J = dpose_de_t::Zero();
+    for (std::size_t c = 0; c < freeIdxs.size(); c++)
+    {
+        const int k = freeIdxs[c];
+        if (k < 3)
+        {
+            J(9 + k, c) = 1.0;  // dt/dv
+            continue;
+        }
+        Eigen::Vector3d axis = Eigen::Vector3d::Zero();
+        axis[k - 3]          = 1.0;
+
+        // d(exp(w)*R)/dw_k = [axis]x * R  ;  d(exp(w)*t)/dw_k = axis x t
+        for (int j = 0; j < 3; j++)
+            J.block<3, 1>(j * 3, c) = axis.cross(R.col(j));
+        J.block<3, 1>(9, c) = axis.cross(t);
+    }
+    return J;
+}
+
+template <class PAIRINGS>
+LinearizedPairings linearize(
+    const PAIRINGS& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose, const bool computeJacobians,
+    const RobustKernel kernel, const double kernelParam, const DOFMask& dofs,
+    const bool weightJacobiansOnly)
+{
+    LinearizedPairings eq;
+
+    // Hessian weight, for a gradient weight `k*w` (see weightJacobiansOnly):
+    const auto hessianWeight = [&](const double w, const double k) {
+        return weightJacobiansOnly ? k * w * w : k * w;
+    };
+
+    // (12x6 Jacobian)
+    dpose_de_t dDexpe_de;
+    if (dofs.allFree())
+    {
+        dDexpe_de =
+            mrpt::poses::Lie::SE<3>::jacob_dDexpe_de(relativePose).asEigen();
+    }
+    else
+    {
+        const auto freeIdxs = dofs.freeIncrementIndices();
+        eq.nDOFs            = static_cast<int>(freeIdxs.size());
+        dDexpe_de           = jacob_dexpeD_de_free(relativePose, freeIdxs);
+    }
+
+    if (kernel == RobustKernel::None)
+    {
+        // Plain least squares: a single pass.
+        visit_error_terms(
+            in, wp, relativePose, computeJacobians,
+            [&](const double w, const auto& err, const auto& J1) {
+                eq.cost += w * err.asEigen().squaredNorm();
+                accumulate(
+                    eq, hessianWeight(w, 1.0), w, err, J1, dDexpe_de,
+                    computeJacobians);
+            });
+        return eq;
+    }
+
+    // Iteratively reweighted least squares. First, evaluate all residuals
+    // to get their robust weights at once:
+    const std::size_t nTerms = in.size();
+
+    Eigen::ArrayXd residuals(nTerms), baseWeights(nTerms);
+    {
+        std::size_t i = 0;
+        visit_error_terms(
+            in, wp, relativePose, false /*no Jacobians*/,
+            [&](const double w, const auto& err, const auto&) {
+                baseWeights[i] = w;
+                residuals[i]   = err.asEigen().norm();
+                i++;
+            });
+    }
+
+    const Eigen::ArrayXd kernelWeights =
+        robust_kernel_weights(kernel, kernelParam, residuals);
+
+    eq.cost = (baseWeights * robust_kernel_cost(kernel, kernelParam, residuals))
+                  .sum();
+
+    if (!computeJacobians) return eq;
+
+    // Second pass: accumulate the reweighted normal equations.
+    std::size_t i = 0;
+    visit_error_terms(
+        in, wp, relativePose, true /*Jacobians*/,
+        [&](const double w, const auto& err, const auto& J1) {
+            const double k = kernelWeights[i++];
+            accumulate(
+                eq, hessianWeight(w, k), k * w, err, J1, dDexpe_de, true);
+        });
+
+    return eq;
+}
+
+}  // namespace
+
+LinearizedPairings mp2p_icp::linearize_pairings(
+    const Pairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose, const bool computeJacobians,
+    const RobustKernel kernel, const double kernelParam, const DOFMask& dofs,
+    const bool weightJacobiansOnly)
+{
+    MRPT_START
+    return linearize(
+        in, wp, relativePose, computeJacobians, kernel, kernelParam, dofs,
+        weightJacobiansOnly);
+    MRPT_END
+}
+
+LinearizedPairings mp2p_icp::linearize_pairings(
+    const CompactPairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose, const bool computeJacobians,
+    const RobustKernel kernel, const double kernelParam, const DOFMask& dofs,
+    const bool weightJacobiansOnly)
+{
+    MRPT_START
+    return linearize(
+        in, wp, relativePose, computeJacobians, kernel, kernelParam, dofs,
+        weightJacobiansOnly);
+    MRPT_END
+}
+
+Eigen::Matrix<double, 6, 1> mp2p_icp::solve_increment(
+    const LinearizedPairings& eq, const double lambda)
+{
+    const int k = eq.nDOFs;
+    ASSERT_GT_(k, 0);
+
+    Eigen::MatrixXd A = eq.H.topLeftCorner(k, k);
+    A.diagonal().array() += lambda;
+
+    Eigen::Matrix<double, 6, 1> delta = Eigen::Matrix<double, 6, 1>::Zero();
+    if (lambda > 0)
+        delta.head(k) = -A.ldlt().solve(eq.g.head(k));
+    else
+        delta.head(k) = -A.colPivHouseholderQr().solve(eq.g.head(k));
+
+    return delta;
+}
+
+mrpt::poses::CPose3D mp2p_icp::apply_increment(
+    const mrpt::poses::CPose3D& pose, const Eigen::Matrix<double, 6, 1>& delta,
+    const DOFMask& dofs)
+{
+    const RigidTransform3d P(pose);
+
+    if (dofs.allFree()) return (P * RigidTransform3d::exp(delta)).asCPose3D();
+
+    // Unpack the free components:
+    Eigen::Matrix<double, 6, 1> e        = Eigen::Matrix<double, 6, 1>::Zero();
+    const auto                  freeIdxs = dofs.freeIncrementIndices();
+    for (std::size_t c = 0; c < freeIdxs.size(); c++)
+        e[freeIdxs[c]] = delta[c];
+
+    return (RigidTransform3d::exp(e) * P).asCPose3D();
+}
@@ -0,0 +1,104 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   linearize_pairings.h
+ * @brief  Normal equations of the SE(3) least-squares registration problem
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <mp2p_icp/CompactPairings.h>
+#include <mp2p_icp/DOFMask.h>
+#include <mp2p_icp/Pairings.h>
+#include <mp2p_icp/WeightParameters.h>
+#include <mp2p_icp/robust_kernels.h>
+#include <mrpt/poses/CPose3D.h>
+
+#include <Eigen/Dense>
+
+namespace mp2p_icp
+{
+/** Normal equations of the weighted least-squares problem for all pairings,
+ * linearized at a given relative pose `P`, for an SE(3) increment `e` such
+ * that the new pose is `P \oplus exp(e)`.
+ *
+ * If some DOFs are fixed (see DOFMask), the increment is instead applied in
+ * the global frame, and only has the `nDOFs` free components, packed in the
+ * order of DOFMask::freeIncrementIndices(). See apply_increment().
+ */
+struct LinearizedPairings
+{
+    /** Number of free DOFs. Only the top-left `nDOFs` block of `H` and the
+     * first `nDOFs` entries of `g` are meaningful. */
+    int nDOFs = 6;
+
+    /** Approximate Hessian: \f$ \sum_i w_i J_i^\top J_i \f$ */
+    Eigen::Matrix<double, 6, 6> H = Eigen::Matrix<double, 6, 6>::Zero();
+
+    /** Gradient: \f$ \sum_i w_i J_i^\top e_i \f$ */
+    Eigen::Matrix<double, 6, 1> g = Eigen::Matrix<double, 6, 1>::Zero();
+
+    /** Weighted squared error: \f$ \sum_i w_i |e_i|^2 \f$, or the
+     * weighted robust cost \f$ \sum_i w_i \rho(|e_i|) \f$ if using a
+     * robust kernel. */
+    double cost = 0;
+};
+
+/** Evaluates all error terms in `in` at `relativePose`, accumulating them
+ * directly into 6x6 normal equations, without building the (potentially
+ * large) full Jacobian matrix.
+ *
+ * Weights come from `wp.pair_weights`, times the individual weights in
+ * `Pairings::weights`, if any. Symmetric point-to-plane pairings use the
+ * point-to-plane weight.
+ *
+ * If `computeJacobians` is false, only `cost` is evaluated, which is faster.
+ *
+ * With a robust `kernel`, this is one step of iteratively reweighted least
+ * squares (IRLS): each error term weight is multiplied by the kernel weight
+ * \f$ w(|e_i|) \f$ evaluated at `relativePose`.
+ *
+ * If `weightJacobiansOnly` is true, each error term is instead added as if
+ * its Jacobian rows, but not its residual, were scaled by its weight, as
+ * optimal_tf_gauss_newton() has always done: `H` gets \f$ w_i^2 \f$ and
+ * `g` gets \f$ w_i \f$. The solution of `H x = -g` is then no longer the
+ * Gauss-Newton step of `cost` unless all weights are 1, although both
+ * vanish at the same poses.
+ */
+LinearizedPairings linearize_pairings(
+    const Pairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose,
+    const bool                  computeJacobians    = true,
+    const RobustKernel          kernel              = RobustKernel::None,
+    const double                kernelParam         = 1.0,
+    const DOFMask&              dofs                = DOFMask(),
+    const bool                  weightJacobiansOnly = false);
+
+/** \overload For pairings in compact form, read directly from their
+ * coordinate arrays. Gives the same result than for the equivalent Pairings.
+ */
+LinearizedPairings linearize_pairings(
+    const CompactPairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& relativePose,
+    const bool                  computeJacobians    = true,
+    const RobustKernel          kernel              = RobustKernel::None,
+    const double                kernelParam         = 1.0,
+    const DOFMask&              dofs                = DOFMask(),
+    const bool                  weightJacobiansOnly = false);
+
+/** Solves the (optionally damped) normal equations, returning the increment
+ * (only the first `eq.nDOFs` entries are non-zero). */
+Eigen::Matrix<double, 6, 1> solve_increment(
+    const LinearizedPairings& eq, const double lambda = 0);
+
+/** Applies an increment, solution of linearize_pairings() with the same
+ * `dofs`, to a pose. */
+mrpt::poses::CPose3D apply_increment(
+    const mrpt::poses::CPose3D& pose, const Eigen::Matrix<double, 6, 1>& delta,
+    const DOFMask& dofs);
+
+}  // namespace mp2p_icp
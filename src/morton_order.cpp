@@ -0,0 +1,183 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   morton_order.cpp
+ * @brief  Z-order (Morton) sorting of points, for cache-coherent KD-tree use
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/morton_order.h>
+#include <mrpt/core/exceptions.h>
+
+#include <algorithm>
+#include <utility>  // std::pair
+
+using namespace mp2p_icp;
+
+static constexpr uint32_t MORTON_BITS_PER_AXIS = 21;
+static constexpr uint32_t MORTON_MAX_CELL = (1U << MORTON_BITS_PER_AXIS) - 1;
+
+// Spreads the lowest 21 bits of v such that there are two zero bits between
+// each of them (e.g. "abc" -> "00a00b00c").
+static inline uint64_t morton_spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x001f00000000ffffULL;
+    v = (v | (v << 16)) & 0x001f0000ff0000ffULL;
+    v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+static inline uint32_t morton_quantize(
+    const float v, const float vMin, const float scale)
+{
+    const float q = (v - vMin) * scale;
+    if (q <= 0) return 0;
+    if (q >= MORTON_MAX_CELL) return MORTON_MAX_CELL;
+    return static_cast<uint32_t>(q);
+}
+
+static inline float morton_scale(const float vMin, const float vMax)
+{
+    const float extent = vMax - vMin;
+    return extent > 0 ? MORTON_MAX_CELL / extent : .0f;
+}
+
+uint64_t mp2p_icp::morton_code(
+    const float x, const float y, const float z,
+    const mrpt::math::TPoint3Df& bbMin, const mrpt::math::TPoint3Df& bbMax)
+{
+    const uint32_t ix =
+        morton_quantize(x, bbMin.x, morton_scale(bbMin.x, bbMax.x));
+    const uint32_t iy =
+        morton_quantize(y, bbMin.y, morton_scale(bbMin.y, bbMax.y));
+    const uint32_t iz =
+        morton_quantize(z, bbMin.z, morton_scale(bbMin.z, bbMax.z));
+
+    return morton_spread_bits(ix) | (morton_spread_bits(iy) << 1) |
+           (morton_spread_bits(iz) << 2);
+}
+
+std::vector<std::size_t> mp2p_icp::morton_sort_indices(
+    const float* xs, const float* ys, const float* zs, const std::size_t n,
+    const mrpt::math::TPoint3Df& bbMin, const mrpt::math::TPoint3Df& bbMax)
+{
+    MRPT_START
+
+    // Precompute the quantization scales once, instead of per point:
+    const float sx = morton_scale(bbMin.x, bbMax.x);
+    const float sy = morton_scale(bbMin.y, bbMax.y);
+    const float sz = morton_scale(bbMin.z, bbMax.z);
+
+    // Sort (code,index) pairs, which is more cache friendly than sorting
+    // indices with an indirect comparison against a separate codes vector:
+    std::vector<std::pair<uint64_t, std::size_t>> codes(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        const uint32_t ix = morton_quantize(xs[i], bbMin.x, sx);
+        const uint32_t iy = morton_quantize(ys[i], bbMin.y, sy);
+        const uint32_t iz = morton_quantize(zs[i], bbMin.z, sz);
+
+        codes[i].first = morton_spread_bits(ix) |
+                         (morton_spread_bits(iy) << 1) |
+                         (morton_spread_bits(iz) << 2);
+        codes[i].second = i;
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<std::size_t> perm(n);
+    for (std::size_t i = 0; i < n; i++) perm[i] = codes[i].second;
+
+    return perm;
+
+    MRPT_END
+}
+
+// Reorders the points, returning the permutation applied: the new point i
+// is the former point perm[i]. Empty if there was nothing to reorder.
+static std::vector<std::size_t> reorder_points_impl(
+    mrpt::maps::CPointsMap& pts)
+{
+    const std::size_t n = pts.size();
+    if (n < 2) return {};
+
+    mrpt::math::TPoint3Df bbMin, bbMax;
+    pts.boundingBox(bbMin.x, bbMax.x, bbMin.y, bbMax.y, bbMin.z, bbMax.z);
+
+    std::vector<std::size_t> perm = morton_sort_indices(
+        pts.getPointsBufferRef_x().data(), pts.getPointsBufferRef_y().data(),
+        pts.getPointsBufferRef_z().data(), n, bbMin, bbMax);
+
+    // Keep a copy of the original points, to read from it while overwriting
+    // the target map. Going through the "all fields" API keeps any other
+    // per-point data (color, intensity,...) in sync with the coordinates.
+    const auto orig = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+        pts.duplicateGetSmartPtr());
+    ASSERT_(orig);
+
+    std::vector<float> ptData;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        orig->getPointAllFieldsFast(perm[i], ptData);
+        pts.setPointAllFieldsFast(i, ptData);
+    }
+
+    // Invalidate the KD-tree and other cached data:
+    pts.mark_as_modified();
+
+    return perm;
+}
+
+template <typename T>
+static void permute(
+    const std::vector<T>& in, const std::vector<std::size_t>& perm,
+    std::vector<T>& out)
+{
+    for (std::size_t i = 0; i < perm.size(); i++) out[i] = in[perm[i]];
+}
+
+void mp2p_icp::reorder_points_morton(mrpt::maps::CPointsMap& pts)
+{
+    MRPT_START
+    reorder_points_impl(pts);
+    MRPT_END
+}
+
+void mp2p_icp::reorder_layers_morton(pointcloud_t& pc)
+{
+    MRPT_START
+
+    for (const auto& layer : pc.point_layers)
+    {
+        const auto& name = layer.first;
+        if (name == pointcloud_t::PT_LAYER_PLANE_CENTROIDS) continue;
+        if (!layer.second || layer.second->size() < 2) continue;
+
+        // mutableLayer() drops the normals, which are reordered below:
+        const auto normals = pc.normalsOf(name);
+
+        // Layers may be shared with copies of this point cloud:
+        const auto perm = reorder_points_impl(*pc.mutableLayer(name));
+        if (!normals || perm.empty()) continue;
+
+        // Normals may be shared too, so reorder into new ones:
+        const auto newNormals = PointNormals::Create();
+        newNormals->resize(perm.size());
+        permute(normals->nx, perm, newNormals->nx);
+        permute(normals->ny, perm, newNormals->ny);
+        permute(normals->nz, perm, newNormals->nz);
+        permute(normals->curvature, perm, newNormals->curvature);
+        permute(normals->ratio02, perm, newNormals->ratio02);
+        permute(normals->ratio12, perm, newNormals->ratio12);
+        permute(normals->valid, perm, newNormals->valid);
+        pc.layer_normals[name] = newNormals;
+    }
+
+    MRPT_END
+}
@@ -0,0 +1,120 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_levenberg_marquardt.cpp
+ * @brief  Damped non-linear optimizer for the SE(3) optimal transformation
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/optimal_tf_levenberg_marquardt.h>
+#include <mrpt/poses/Lie/SE.h>
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "linearize_pairings.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+template <class PAIRINGS>
+void levenberg_marquardt(
+    const PAIRINGS& in, const WeightParameters& wp, OptimalTF_Result& result,
+    const OptimalTF_LM_Parameters& lmParams)
+{
+    using std::size_t;
+
+    ASSERTMSG_(
+        lmParams.linearizationPoint.has_value(),
+        "This method requires a linearization point");
+
+    result.optimalPose = lmParams.linearizationPoint.value();
+
+    // Normal equations at the current solution. They are only rebuilt after
+    // accepted steps; rejected ones just change the damping:
+    const auto linearize = [&](const mrpt::poses::CPose3D& p, bool withJ) {
+        return linearize_pairings(
+            in, wp, p, withJ, lmParams.kernel, lmParams.kernelParam,
+            lmParams.dofMask);
+    };
+
+    LinearizedPairings eq = linearize(result.optimalPose, true);
+
+    const double maxDiagH = eq.H.diagonal().maxCoeff();
+
+    double lambda =
+        lmParams.initialLambdaFactor * (maxDiagH > 0 ? maxDiagH : 1.0);
+    double nu = 2.0;
+
+    for (size_t iter = 0; iter < lmParams.maxInnerLoopIterations; iter++)
+    {
+        if (eq.g.cwiseAbs().maxCoeff() < lmParams.minGradient) break;
+
+        // Solve the damped system (only for the free DOFs):
+        const Eigen::Matrix<double, 6, 1> delta = solve_increment(eq, lambda);
+
+        if (delta.norm() < lmParams.minDelta) break;
+
+        const auto newPose =
+            apply_increment(result.optimalPose, delta, lmParams.dofMask);
+
+        const double newCost = linearize(newPose, false /*no J*/).cost;
+
+        // Actual vs. predicted (by the linear model) cost decrease:
+        const double predicted = delta.dot(lambda * delta - eq.g);
+        const double rho =
+            predicted > 0 ? (eq.cost - newCost) / predicted : -1.0;
+
+        if (lmParams.verbose)
+        {
+            std::cout << "[P2P LM] iter:" << iter
+                      << " err:" << std::sqrt(eq.cost)
+                      << " new_err:" << std::sqrt(newCost)
+                      << " lambda:" << lambda << " rho:" << rho
+                      << " delta:" << delta.transpose() << "\n";
+        }
+
+        if (rho > 0)
+        {
+            // Accept step:
+            result.optimalPose = newPose;
+            eq                 = linearize(result.optimalPose, true);
+
+            lambda *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+            nu = 2.0;
+        }
+        else
+        {
+            // Reject step, and move towards gradient descent:
+            lambda *= nu;
+            nu *= 2.0;
+        }
+    }  // for each iteration
+}
+
+}  // namespace
+
+void mp2p_icp::optimal_tf_levenberg_marquardt(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result,
+    const OptimalTF_LM_Parameters& lmParams)
+{
+    MRPT_START
+    levenberg_marquardt(in, wp, result, lmParams);
+    MRPT_END
+}
+
+void mp2p_icp::optimal_tf_levenberg_marquardt(
+    const CompactPairings& in, const WeightParameters& wp,
+    OptimalTF_Result& result, const OptimalTF_LM_Parameters& lmParams)
+{
+    MRPT_START
+    levenberg_marquardt(in, wp, result, lmParams);
+    MRPT_END
+}
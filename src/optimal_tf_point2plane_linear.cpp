@@ -0,0 +1,170 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_point2plane_linear.cpp
+ * @brief  Small-angle linearized point-to-plane optimal transformation
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/optimal_tf_point2plane_linear.h>
+#include <mrpt/math/CMatrixFixed.h>
+
+#include <Eigen/Dense>
+#include <vector>
+
+#include "RigidTransform3.h"
+
+using namespace mp2p_icp;
+
+namespace
+{
+// Adds the linearized residual n^T (p + w x p + t - q) of one pairing, with
+// p the transformed local point (or, in general, the point about which the
+// rotation acts), to the normal equations in (w, t):
+inline void accumulate_pt2pl(
+    Eigen::Matrix<double, 6, 6>& AtA, Eigen::Matrix<double, 6, 1>& Atb,
+    const double w, const mrpt::math::TPoint3D& p,
+    const mrpt::math::TVector3D& n, const double residual)
+{
+    const mrpt::math::TVector3D pxn = mrpt::math::crossProduct3D(p, n);
+
+    Eigen::Matrix<double, 6, 1> a;
+    a << pxn.x, pxn.y, pxn.z, n.x, n.y, n.z;
+
+    AtA.noalias() += w * a * a.transpose();
+    Atb.noalias() -= w * residual * a;
+}
+}  // namespace
+
+bool mp2p_icp::optimal_tf_point2plane_linear(
+    const Pairings& in, const WeightParameters& wp,
+    const mrpt::poses::CPose3D& linearizationPoint, OptimalTF_Result& result,
+    const DOFMask& dofs)
+{
+    MRPT_START
+
+    using mrpt::math::TPoint3D;
+    using mrpt::math::TVector3D;
+
+    result.optimalPose = linearizationPoint;
+
+    const RigidTransform3d linTf(linearizationPoint);
+
+    Eigen::Matrix<double, 6, 6> AtA = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> Atb = Eigen::Matrix<double, 6, 1>::Zero();
+
+    const auto& w  = wp.pair_weights;
+    const auto& iw = in.weights;
+
+    // Point-to-plane:
+    for (std::size_t i = 0; i < in.paired_pt2pl.size(); i++)
+    {
+        const auto& pair = in.paired_pt2pl[i];
+        const auto& pl   = pair.pl_this.plane;
+        const auto& q    = pair.pt_other;
+        TPoint3D    p;
+        linTf.composePoint(q.x, q.y, q.z, p.x, p.y, p.z);
+
+        const TVector3D n(pl.coefs[0], pl.coefs[1], pl.coefs[2]);
+        accumulate_pt2pl(
+            AtA, Atb, pairing_weight(iw.pt2pl, i, w.pt2pl), p, n,
+            pl.evaluatePoint(p));
+    }
+
+    // Symmetric point-to-plane: with the increment split in two half
+    // rotations around the translation, the linearized residual is
+    // n^T (p - q + (w/2) x (p + q) + t), with n = n_p + n_q:
+    for (std::size_t i = 0; i < in.paired_pt2pl_sym.size(); i++)
+    {
+        const auto& pair = in.paired_pt2pl_sym[i];
+        TPoint3D    p;
+        linTf.composePoint(
+            pair.pt_other.x, pair.pt_other.y, pair.pt_other.z, p.x, p.y, p.z);
+        const TPoint3D q(pair.pt_this);
+
+        const TVector3D n = linearizationPoint.rotateVector(
+                                TVector3D(pair.n_other)) +
+                            TVector3D(pair.n_this);
+
+        const TVector3D d = p - q;
+        accumulate_pt2pl(
+            AtA, Atb, pairing_weight(iw.pt2pl_sym, i, w.pt2pl), (p + q) * 0.5,
+            n, d.x * n.x + d.y * n.y + d.z * n.z);
+    }
+
+    // Point-to-point, as three orthogonal planes:
+    for (std::size_t i = 0; i < in.paired_pt2pt.size(); i++)
+    {
+        const double wPt  = pairing_weight(iw.pt2pt, i, w.pt2pt);
+        const auto&  pair = in.paired_pt2pt[i];
+        TPoint3D     p;
+        linTf.composePoint(
+            pair.other_x, pair.other_y, pair.other_z, p.x, p.y, p.z);
+
+        const TVector3D d = p - TPoint3D(pair.this_x, pair.this_y, pair.this_z);
+
+        accumulate_pt2pl(AtA, Atb, wPt, p, {1.0, 0.0, 0.0}, d.x);
+        accumulate_pt2pl(AtA, Atb, wPt, p, {0.0, 1.0, 0.0}, d.y);
+        accumulate_pt2pl(AtA, Atb, wPt, p, {0.0, 0.0, 1.0}, d.z);
+    }
+
+    // Keep the rows of the free DOFs only. Unknowns here are [w t], while
+    // DOFMask indices refer to [t w]:
+    std::vector<int> idxs = dofs.freeIncrementIndices();
+    for (auto& i : idxs) i = i < 3 ? i + 3 : i - 3;
+    const auto k = static_cast<Eigen::Index>(idxs.size());
+    ASSERT_GT_(k, 0);
+
+    Eigen::MatrixXd AtA_k(k, k);
+    Eigen::VectorXd Atb_k(k);
+    for (Eigen::Index r = 0; r < k; r++)
+    {
+        Atb_k[r] = Atb[idxs[r]];
+        for (Eigen::Index c = 0; c < k; c++)
+            AtA_k(r, c) = AtA(idxs[r], idxs[c]);
+    }
+
+    // Solve. A (near) zero pivot means some DOF is not constrained:
+    const Eigen::LDLT<Eigen::MatrixXd> ldlt(AtA_k);
+    if (ldlt.info() != Eigen::Success) return false;
+
+    const auto   D    = ldlt.vectorD().cwiseAbs();
+    const double maxD = D.maxCoeff();
+    if (!(maxD > 0) || D.minCoeff() < 1e-10 * maxD) return false;
+
+    const Eigen::VectorXd x_k = ldlt.solve(Atb_k);
+
+    Eigen::Matrix<double, 6, 1> x = Eigen::Matrix<double, 6, 1>::Zero();
+    for (Eigen::Index r = 0; r < k; r++) x[idxs[r]] = x_k[r];
+
+    // Apply the increment, in the global frame, on the left. Both
+    // parameterizations, R(w)*T(t) and R(w/2)*T(t)*R(w/2), agree to first
+    // order; the latter is the one the symmetric residuals were built for.
+    const Eigen::Vector3d t = x.tail<3>();
+    RigidTransform3d      dPose;
+
+    if (in.paired_pt2pl_sym.empty())
+    {
+        dPose = RigidTransform3d(
+            RigidTransform3d::exp_rotation(x.head<3>()), t);
+    }
+    else
+    {
+        const RigidTransform3d halfR(
+            RigidTransform3d::exp_rotation(0.5 * x.head<3>()),
+            Eigen::Vector3d::Zero());
+
+        dPose =
+            halfR * RigidTransform3d(Eigen::Matrix3d::Identity(), t) * halfR;
+    }
+
+    result.optimalPose = (dPose * linTf).asCPose3D();
+
+    return true;
+
+    MRPT_END
+}
@@ -0,0 +1,166 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   optimal_tf_se2.cpp
+ * @brief  SE(2) optimal transformation for planar point clouds
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/optimal_tf_se2.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/poses/CPose3D.h>
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <vector>
+
+using namespace mp2p_icp;
+
+namespace
+{
+// Invokes `f(pair, w)` for each point-to-point pairing, with its weight:
+template <class FUNCTOR>
+void forEachPt2Pt(const Pairings& in, const WeightParameters& wp, FUNCTOR f)
+{
+    for (std::size_t i = 0; i < in.paired_pt2pt.size(); i++)
+    {
+        f(in.paired_pt2pt[i],
+          pairing_weight(in.weights.pt2pt, i, wp.pair_weights.pt2pt));
+    }
+}
+}  // namespace
+
+bool mp2p_icp::optimal_tf_se2_closed_form(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result)
+{
+    MRPT_START
+
+    if (in.paired_pt2pt.size() < 2) return false;
+
+    // Weighted centroids of global ("this", a) and local ("other", b) points:
+    double sumW = 0, ax = 0, ay = 0, bx = 0, by = 0;
+    forEachPt2Pt(in, wp, [&](const mrpt::tfest::TMatchingPair& p, double w) {
+        sumW += w;
+        ax += w * p.this_x;
+        ay += w * p.this_y;
+        bx += w * p.other_x;
+        by += w * p.other_y;
+    });
+    if (!(sumW > 0)) return false;
+    ax /= sumW;
+    ay /= sumW;
+    bx /= sumW;
+    by /= sumW;
+
+    // Optimal rotation from the cross-covariance of centered points:
+    double sCos = 0, sSin = 0;
+    forEachPt2Pt(in, wp, [&](const mrpt::tfest::TMatchingPair& p, double w) {
+        const double dax = p.this_x - ax, day = p.this_y - ay;
+        const double dbx = p.other_x - bx, dby = p.other_y - by;
+        sCos += w * (dbx * dax + dby * day);
+        sSin += w * (dbx * day - dby * dax);
+    });
+
+    const double phi = std::atan2(sSin, sCos);
+    const double c = std::cos(phi), s = std::sin(phi);
+
+    result.optimalPose = mrpt::poses::CPose3D(mrpt::poses::CPose2D(
+        ax - (c * bx - s * by), ay - (s * bx + c * by), phi));
+    result.optimalScale = 1.0;
+
+    return true;
+
+    MRPT_END
+}
+
+void mp2p_icp::optimal_tf_se2_gauss_newton(
+    const Pairings& in, const WeightParameters& wp, OptimalTF_Result& result,
+    const OptimalTF_SE2_GN_Parameters& gnParams)
+{
+    MRPT_START
+
+    ASSERTMSG_(
+        gnParams.linearizationPoint.has_value(),
+        "This method requires a linearization point");
+
+    mrpt::poses::CPose2D pose = gnParams.linearizationPoint.value();
+
+    // Free DOFs, as indices in (x,y,yaw):
+    const auto&      m = gnParams.dofMask;
+    std::vector<int> freeIdxs;
+    if (m.x) freeIdxs.push_back(0);
+    if (m.y) freeIdxs.push_back(1);
+    if (m.yaw) freeIdxs.push_back(2);
+
+    const auto nFree = static_cast<Eigen::Index>(freeIdxs.size());
+
+    for (uint32_t iter = 0;
+         nFree > 0 && iter < gnParams.maxInnerLoopIterations; iter++)
+    {
+        Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+        Eigen::Vector3d g = Eigen::Vector3d::Zero();
+
+        const double c = std::cos(pose.phi()), s = std::sin(pose.phi());
+
+        const auto addTerm = [&](const double w, const Eigen::RowVector3d& J,
+                                 const double err) {
+            H.noalias() += w * J.transpose() * J;
+            g.noalias() += w * J.transpose() * err;
+        };
+
+        // The Jacobian of a transformed local point wrt (x,y,phi) is
+        // [1 0 -ry; 0 1 rx], with (rx,ry) the rotated (not translated) point:
+        forEachPt2Pt(
+            in, wp, [&](const mrpt::tfest::TMatchingPair& p, double w) {
+                const double rx = c * p.other_x - s * p.other_y;
+                const double ry = s * p.other_x + c * p.other_y;
+                addTerm(w, {1.0, 0.0, -ry}, rx + pose.x() - p.this_x);
+                addTerm(w, {0.0, 1.0, rx}, ry + pose.y() - p.this_y);
+            });
+
+        for (std::size_t i = 0; i < in.paired_pt2pl.size(); i++)
+        {
+            const auto& p  = in.paired_pt2pl[i];
+            const auto& pl = p.pl_this.plane;
+            const double nx = pl.coefs[0], ny = pl.coefs[1];
+            if (std::abs(nx) + std::abs(ny) < 1e-6) continue;
+
+            const double rx = c * p.pt_other.x - s * p.pt_other.y;
+            const double ry = s * p.pt_other.x + c * p.pt_other.y;
+
+            const double err = pl.evaluatePoint(
+                {rx + pose.x(), ry + pose.y(), p.pt_other.z});
+            addTerm(
+                pairing_weight(in.weights.pt2pl, i, wp.pair_weights.pt2pl),
+                {nx, ny, ny * rx - nx * ry}, err);
+        }
+
+        // Reduced normal equations of the free DOFs:
+        Eigen::MatrixXd Hr(nFree, nFree);
+        Eigen::VectorXd gr(nFree);
+        for (Eigen::Index r = 0; r < nFree; r++)
+        {
+            gr[r] = g[freeIdxs[r]];
+            for (Eigen::Index c2 = 0; c2 < nFree; c2++)
+                Hr(r, c2) = H(freeIdxs[r], freeIdxs[c2]);
+        }
+        const Eigen::VectorXd deltaR = -Hr.colPivHouseholderQr().solve(gr);
+
+        Eigen::Vector3d delta = Eigen::Vector3d::Zero();
+        for (Eigen::Index r = 0; r < nFree; r++) delta[freeIdxs[r]] = deltaR[r];
+
+        pose = mrpt::poses::CPose2D(
+            pose.x() + delta[0], pose.y() + delta[1], pose.phi() + delta[2]);
+
+        if (delta.norm() < gnParams.minDelta) break;
+    }
+
+    result.optimalPose  = mrpt::poses::CPose3D(pose);
+    result.optimalScale = 1.0;
+
+    MRPT_END
+}
@@ -11,13 +11,18 @@
  */
 
 #include <mp2p_icp/pointcloud.h>
+#include <mrpt/maps/CSimplePointsMap.h>
 #include <mrpt/opengl/CGridPlaneXY.h>
 #include <mrpt/opengl/CSetOfObjects.h>
 #include <mrpt/serialization/CArchive.h>
 #include <mrpt/serialization/stl_serialization.h>
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+#include <set>
+
+#include "RigidTransform3.h"
 
 IMPLEMENTS_MRPT_OBJECT(
     pointcloud_t, mrpt::serialization::CSerializable, mp2p_icp)
@@ -25,11 +30,9 @@ IMPLEMENTS_MRPT_OBJECT(
 using namespace mp2p_icp;
 
 // Implementation of the CSerializable virtual interface:
-uint8_t pointcloud_t::serializeGetVersion() const { return 0; }
+uint8_t pointcloud_t::serializeGetVersion() const { return 3; }
 void    pointcloud_t::serializeTo(mrpt::serialization::CArchive& out) const
 {
-    out << lines;
-
     out.WriteAs<uint32_t>(planes.size());
     for (const auto& p : planes) out << p.plane << p.centroid;
 
@@ -38,6 +41,12 @@ void    pointcloud_t::serializeTo(mrpt::serialization::CArchive& out) const
 
     out.WriteAs<uint32_t>(point_layers.size());
     for (const auto& l : point_layers) out << l.first << *l.second.get();
+
+    out.WriteAs<uint32_t>(quantized_layers.size());
+    for (const auto& l : quantized_layers) out << l.first << *l.second.get();
+
+    out.WriteAs<uint32_t>(layer_normals.size());
+    for (const auto& l : layer_normals) out << l.first << *l.second.get();
 }
 void pointcloud_t::serializeFrom(
     mrpt::serialization::CArchive& in, uint8_t version)
@@ -45,8 +54,13 @@ void pointcloud_t::serializeFrom(
     switch (version)
     {
         case 0:
+        case 1:
+        case 2:
+        case 3:
         {
-            in >> lines;
+            // v0 wrote the lines twice:
+            if (version == 0) in >> lines;
+
             const auto nPls = in.ReadAs<uint32_t>();
             planes.resize(nPls);
             for (auto& pl : planes) in >> pl.plane >> pl.centroid;
@@ -65,6 +79,32 @@ void pointcloud_t::serializeFrom(
                     mrpt::ptr_cast<mrpt::maps::CPointsMap>::from(
                         in.ReadObject());
             }
+
+            quantized_layers.clear();
+            if (version >= 2)
+            {
+                const auto nQs = in.ReadAs<uint32_t>();
+                for (std::size_t i = 0; i < nQs; i++)
+                {
+                    std::string name;
+                    in >> name;
+                    quantized_layers[name] =
+                        mrpt::ptr_cast<QuantizedPoints>::from(in.ReadObject());
+                }
+            }
+
+            layer_normals.clear();
+            if (version >= 3)
+            {
+                const auto nNs = in.ReadAs<uint32_t>();
+                for (std::size_t i = 0; i < nNs; i++)
+                {
+                    std::string name;
+                    in >> name;
+                    layer_normals[name] =
+                        mrpt::ptr_cast<PointNormals>::from(in.ReadObject());
+                }
+            }
         }
         break;
         default:
@@ -96,83 +136,368 @@ void pointcloud_t::planesAsRenderizable(
 
 bool pointcloud_t::empty() const
 {
-    return point_layers.empty() && lines.empty() && planes.empty();
+    return point_layers.empty() && external_layers.empty() &&
+           quantized_layers.empty() && lines.empty() && planes.empty();
 }
 void pointcloud_t::clear() { *this = pointcloud_t(); }
 
-MRPT_TODO("Write unit test for mergeWith()");
+namespace
+{
+// Point maps with no per-point fields other than (x,y,z), which can be
+// appended and transformed directly on their coordinate buffers:
+bool is_plain_xyz(const mrpt::maps::CPointsMap& m)
+{
+    return m.GetRuntimeClass() == CLASS_ID(mrpt::maps::CSimplePointsMap);
+}
+
+// Points are transformed in chunks, small enough to stay in cache:
+constexpr std::size_t kTransformChunk = 4096;
+
+// dst[dstFirst + i] = tf(src[i]), for all points in `src`. `dst` may be
+// `src` itself. The transformation is done in double precision, like
+// CPointsMap::insertAnotherMap(), so large translations (e.g. UTM
+// coordinates) add no rounding other than storing the result as float.
+void transform_points(
+    const mrpt::maps::CPointsMap& src, mrpt::maps::CPointsMap& dst,
+    const std::size_t dstFirst, const RigidTransform3d& tf)
+{
+    const std::size_t n  = src.size();
+    const float*      xs = src.getPointsBufferRef_x().data();
+    const float*      ys = src.getPointsBufferRef_y().data();
+    const float*      zs = src.getPointsBufferRef_z().data();
+
+    float gxs[kTransformChunk], gys[kTransformChunk], gzs[kTransformChunk];
+    for (std::size_t i0 = 0; i0 < n; i0 += kTransformChunk)
+    {
+        const std::size_t m = std::min(kTransformChunk, n - i0);
+        tf.composePoints(m, xs + i0, ys + i0, zs + i0, gxs, gys, gzs);
+        for (std::size_t i = 0; i < m; i++)
+            dst.setPointFast(dstFirst + i0 + i, gxs[i], gys[i], gzs[i]);
+    }
+}
+
+// Appends all points of `src` to `dst`, transformed by `pose` if given:
+void append_points(
+    mrpt::maps::CPointsMap& dst, const mrpt::maps::CPointsMap& src,
+    const std::optional<mrpt::poses::CPose3D>& pose)
+{
+    if (!is_plain_xyz(dst) || !is_plain_xyz(src))
+    {
+        dst.insertAnotherMap(&src, pose ? *pose : mrpt::poses::CPose3D());
+        return;
+    }
+
+    const std::size_t n0 = dst.size(), n = src.size();
+    dst.resize(n0 + n);
+    if (pose)
+    {
+        transform_points(src, dst, n0, RigidTransform3d(*pose));
+    }
+    else
+    {
+        const auto& xs = src.getPointsBufferRef_x();
+        const auto& ys = src.getPointsBufferRef_y();
+        const auto& zs = src.getPointsBufferRef_z();
+        for (std::size_t i = 0; i < n; i++)
+            dst.setPointFast(n0 + i, xs[i], ys[i], zs[i]);
+    }
+    dst.mark_as_modified();
+}
+
+void transform_in_place(
+    mrpt::maps::CPointsMap& m, const mrpt::poses::CPose3D& pose)
+{
+    if (!is_plain_xyz(m))
+    {
+        m.changeCoordinatesReference(pose);
+        return;
+    }
+    transform_points(m, m, 0, RigidTransform3d(pose));
+    m.mark_as_modified();
+}
+
+// What merge_layer() may do with the source layer:
+enum class SourceLayer
+{
+    Borrowed,  //!< Only read it: new layers get a copy.
+    Shared,  //!< Hold it too, but never modify it.
+    Owned  //!< Nobody else holds it: it may be modified or stolen.
+};
+
+// Merges one point layer of another point cloud into `layers`.
+void merge_layer(
+    std::map<std::string, mrpt::maps::CPointsMap::Ptr>& layers,
+    const std::string& name, const mrpt::maps::CPointsMap::Ptr& src,
+    const std::optional<mrpt::poses::CPose3D>& pose, const SourceLayer access)
+{
+    ASSERT_(src);
+
+    auto& dst = layers[name];
+    if (!dst)
+    {
+        // New layer: share or steal `src` if possible.
+        if (access != SourceLayer::Borrowed && !pose)
+        {
+            dst = src;
+        }
+        else if (access == SourceLayer::Owned)
+        {
+            transform_in_place(*src, *pose);
+            dst = src;
+        }
+        else if (is_plain_xyz(*src))
+        {
+            dst = mrpt::maps::CSimplePointsMap::Create();
+            append_points(*dst, *src, pose);
+        }
+        else
+        {
+            dst = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+                src->duplicateGetSmartPtr());
+            if (pose) dst->changeCoordinatesReference(*pose);
+        }
+        return;
+    }
+
+    // Existing layer: copy it first if shared (copy-on-write), or if it is
+    // `src` itself, since appending would invalidate its buffers.
+    if (dst.use_count() > 1 || dst == src)
+        dst = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+            dst->duplicateGetSmartPtr());
+
+    append_points(*dst, *src, pose);
+}
+
+plane_patch_t transform_plane(
+    const plane_patch_t& p, const mrpt::poses::CPose3D& pose)
+{
+    // A point on the plane (the closest one to the origin), which the
+    // centroid may not be exactly:
+    const mrpt::math::TVector3D n  = p.plane.getNormalVector();
+    const double                n2 = n.sqrNorm();
+    ASSERT_GT_(n2, 0.0);
+    const mrpt::math::TPoint3D onPlane = n * (-p.plane.coefs[3] / n2);
+
+    plane_patch_t g;
+    g.centroid = pose.composePoint(p.centroid);
+    g.plane    = mrpt::math::TPlane::FromPointAndNormal(
+        pose.composePoint(onPlane), pose.rotateVector(n));
+    return g;
+}
+void append_normals(
+    PointNormals& dst, const PointNormals& src,
+    const std::optional<mrpt::poses::CPose3D>& pose)
+{
+    const std::size_t n0 = dst.size(), n = src.size();
+    dst.resize(n0 + n);
+
+    std::copy(src.curvature.begin(), src.curvature.end(), &dst.curvature[n0]);
+    std::copy(src.ratio02.begin(), src.ratio02.end(), &dst.ratio02[n0]);
+    std::copy(src.ratio12.begin(), src.ratio12.end(), &dst.ratio12[n0]);
+    std::copy(src.valid.begin(), src.valid.end(), &dst.valid[n0]);
+
+    if (pose)
+    {
+        // Normals are only rotated:
+        RigidTransform3f rot(*pose);
+        rot.t.setZero();
+        rot.composePoints(
+            n, src.nx.data(), src.ny.data(), src.nz.data(), &dst.nx[n0],
+            &dst.ny[n0], &dst.nz[n0]);
+    }
+    else
+    {
+        std::copy(src.nx.begin(), src.nx.end(), &dst.nx[n0]);
+        std::copy(src.ny.begin(), src.ny.end(), &dst.ny[n0]);
+        std::copy(src.nz.begin(), src.nz.end(), &dst.nz[n0]);
+    }
+}
+}  // namespace
+
 void pointcloud_t::mergeWith(
     const pointcloud_t&                       otherPc,
     const std::optional<mrpt::math::TPose3D>& otherRelativePose)
 {
-    mrpt::poses::CPose3D pose;
+    MRPT_START
+
+    std::optional<mrpt::poses::CPose3D> pose;
     if (otherRelativePose.has_value())
         pose = mrpt::poses::CPose3D(otherRelativePose.value());
 
-    // Lines:
+    mergeNormals(otherPc, pose, false);
+    mergeLinesAndPlanes(otherPc.lines, otherPc.planes, pose);
+
+    // Points. Layers of otherPc are copied, so later changes to either
+    // point cloud do not show up in the other:
+    for (const auto& [name, pts] : otherPc.point_layers)
+        merge_layer(point_layers, name, pts, pose, SourceLayer::Borrowed);
+
+    for (const auto& [name, view] : otherPc.external_layers)
+    {
+        merge_layer(
+            point_layers, name, view.toPointsMap(), pose, SourceLayer::Owned);
+    }
+
+    mergeQuantized(otherPc.quantized_layers, pose);
+
+    MRPT_END
+}
+
+void pointcloud_t::mergeWith(
+    pointcloud_t&&                            otherPc,
+    const std::optional<mrpt::math::TPose3D>& otherRelativePose)
+{
+    MRPT_START
+
+    std::optional<mrpt::poses::CPose3D> pose;
     if (otherRelativePose.has_value())
+        pose = mrpt::poses::CPose3D(otherRelativePose.value());
+
+    mergeNormals(otherPc, pose, true);
+
+    // Steal the lines and planes if they need not be transformed nor
+    // appended; otherwise, this is a no-op:
+    if (!pose && lines.empty()) lines.swap(otherPc.lines);
+    if (!pose && planes.empty()) planes.swap(otherPc.planes);
+    mergeLinesAndPlanes(otherPc.lines, otherPc.planes, pose);
+
+    // Points. Layers owned only by otherPc are stolen, others shared:
+    for (auto& [name, pts] : otherPc.point_layers)
     {
-        std::transform(
-            otherPc.lines.begin(), otherPc.lines.end(),
-            std::back_inserter(lines), [&](const mrpt::math::TLine3D& l) {
-                return mrpt::math::TLine3D::FromPointAndDirector(
-                    pose.composePoint(l.pBase),
-                    pose.rotateVector(l.getDirectorVector()));
-            });
+        const auto access = pts.use_count() == 1 ? SourceLayer::Owned
+                                                 : SourceLayer::Shared;
+        merge_layer(point_layers, name, pts, pose, access);
     }
-    else
+
+    for (const auto& [name, view] : otherPc.external_layers)
     {
-        std::copy(
-            otherPc.lines.begin(), otherPc.lines.end(),
-            std::back_inserter(lines));
+        merge_layer(
+            point_layers, name, view.toPointsMap(), pose, SourceLayer::Owned);
     }
 
-    // Planes:
-    if (otherRelativePose.has_value())
+    mergeQuantized(otherPc.quantized_layers, pose);
+
+    otherPc.clear();
+
+    MRPT_END
+}
+
+void pointcloud_t::mergeLinesAndPlanes(
+    const std::vector<mrpt::math::TLine3D>&    otherLines,
+    const std::vector<plane_patch_t>&          otherPlanes,
+    const std::optional<mrpt::poses::CPose3D>& pose)
+{
+    lines.reserve(lines.size() + otherLines.size());
+    planes.reserve(planes.size() + otherPlanes.size());
+
+    if (pose)
     {
         std::transform(
-            otherPc.planes.begin(), otherPc.planes.end(),
-            std::back_inserter(planes), [&](const plane_patch_t& l) {
-                plane_patch_t g;
-                g.centroid = pose.composePoint(l.centroid);
-                MRPT_TODO("Finish rotating planes");
-                // ...
-                THROW_EXCEPTION("To-do");
-                return g;
+            otherLines.begin(), otherLines.end(), std::back_inserter(lines),
+            [&](const mrpt::math::TLine3D& l) {
+                return mrpt::math::TLine3D::FromPointAndDirector(
+                    pose->composePoint(l.pBase),
+                    pose->rotateVector(l.getDirectorVector()));
             });
+        std::transform(
+            otherPlanes.begin(), otherPlanes.end(), std::back_inserter(planes),
+            [&](const plane_patch_t& p) { return transform_plane(p, *pose); });
     }
     else
     {
         std::copy(
-            otherPc.planes.begin(), otherPc.planes.end(),
+            otherLines.begin(), otherLines.end(), std::back_inserter(lines));
+        std::copy(
+            otherPlanes.begin(), otherPlanes.end(),
             std::back_inserter(planes));
     }
+}
+
+void pointcloud_t::mergeQuantized(
+    const std::map<std::string, QuantizedPoints::Ptr>& otherLayers,
+    const std::optional<mrpt::poses::CPose3D>&         pose)
+{
+    for (const auto& [name, otherQ] : otherLayers)
+    {
+        ASSERT_(otherQ);
+        auto& q = quantized_layers[name];
+        if (!q)
+            q = QuantizedPoints::Create(otherQ->resolution());
+        else if (q.use_count() > 1)
+            q = std::dynamic_pointer_cast<QuantizedPoints>(
+                q->duplicateGetSmartPtr());
+
+        q->insertPoints(*otherQ, pose);
+    }
+}
+
+void pointcloud_t::mergeNormals(
+    const pointcloud_t&                        otherPc,
+    const std::optional<mrpt::poses::CPose3D>& pose, const bool share)
+{
+    std::set<std::string> names;
+    for (const auto& l : otherPc.point_layers) names.insert(l.first);
+    for (const auto& l : otherPc.external_layers) names.insert(l.first);
 
-    // Points:
-    for (const auto& layer : otherPc.point_layers)
+    for (const auto& name : names)
     {
-        const auto& name     = layer.first;
-        const auto& otherPts = layer.second;
+        const auto itPts = point_layers.find(name);
+        const bool isNew = itPts == point_layers.end() || !itPts->second;
 
-        // New layer?
-        if (point_layers.count(name) == 0)
+        // Normals are kept only if all points of the merged layer have them:
+        const auto otherN = otherPc.normalsOf(name);
+        if (!otherN || (!isNew && !normalsOf(name)))
         {
-            // Make a copy and transform (if applicable):
-            point_layers[name] =
-                std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
-                    otherPts->duplicateGetSmartPtr());
+            layer_normals.erase(name);
+            continue;
+        }
 
-            if (otherRelativePose.has_value())
-                point_layers[name]->changeCoordinatesReference(pose);
+        auto& mine = layer_normals[name];
+        if (isNew)
+        {
+            if (!pose && share)
+            {
+                // Shared: normals are never modified in place once merged.
+                mine = otherPc.layer_normals.at(name);
+                continue;
+            }
+            mine = PointNormals::Create();
         }
-        else
+        else if (mine.use_count() > 1 || mine == otherN)
         {
-            // merge with existing layer:
-            point_layers[name]->insertAnotherMap(otherPts.get(), pose);
+            mine = std::dynamic_pointer_cast<PointNormals>(
+                mine->duplicateGetSmartPtr());
         }
+        append_normals(*mine, *otherN, pose);
     }
 }
 
+PointNormals::ConstPtr pointcloud_t::normalsOf(const std::string& layer) const
+{
+    const auto itN = layer_normals.find(layer);
+    const auto itP = point_layers.find(layer);
+    if (itN == layer_normals.end() || itP == point_layers.end()) return {};
+
+    const auto& normals = itN->second;
+    const auto& pts     = itP->second;
+    if (!normals || !pts || normals->size() != pts->size()) return {};
+    return normals;
+}
+
+mrpt::maps::CPointsMap::Ptr pointcloud_t::mutableLayer(const std::string& name)
+{
+    auto& l = point_layers.at(name);
+    ASSERT_(l);
+    if (l.use_count() > 1)
+        l = std::dynamic_pointer_cast<mrpt::maps::CPointsMap>(
+            l->duplicateGetSmartPtr());
+
+    // The caller may move points without changing their number, which
+    // normalsOf() could not detect:
+    layer_normals.erase(name);
+    return l;
+}
+
 size_t pointcloud_t::size() const
 {
     size_t n = 0;
@@ -180,6 +505,44 @@ size_t pointcloud_t::size() const
     n += lines.size();
     n += planes.size();
     for (const auto& layer : point_layers) n += layer.second->size();
+    for (const auto& layer : external_layers) n += layer.second.size();
+    for (const auto& layer : quantized_layers) n += layer.second->size();
 
     return n;
 }
+
+bool pointcloud_t::isPlanar(const double zTolerance) const
+{
+    if (!lines.empty() || !planes.empty()) return false;
+
+    for (const auto& layer : point_layers)
+    {
+        for (const float z : layer.second->getPointsBufferRef_z())
+            if (std::abs(z) > zTolerance) return false;
+    }
+    for (const auto& layer : external_layers)
+    {
+        const PointsView& v = layer.second;
+        for (std::size_t i = 0; i < v.size(); i++)
+            if (std::abs(v.z(i)) > zTolerance) return false;
+    }
+    for (const auto& layer : quantized_layers)
+        if (!layer.second->isPlanar(zTolerance)) return false;
+
+    return true;
+}
+
+std::optional<PointsView> pointcloud_t::layerView(
+    const std::string& name) const
+{
+    if (const auto it = point_layers.find(name); it != point_layers.end())
+    {
+        ASSERT_(it->second);
+        return PointsView::FromPointsMap(*it->second);
+    }
+    if (const auto it = external_layers.find(name);
+        it != external_layers.end())
+        return it->second;
+
+    return {};
+}
@@ -13,14 +13,20 @@
 #include <mp2p_icp/ICP.h>
 #include <mp2p_icp/ICP_LibPointmatcher.h>
 #include <mp2p_icp/Matcher_Point2Plane.h>
+#include <mp2p_icp/Matcher_Point2PlaneSymmetric.h>
 #include <mp2p_icp/Matcher_Points_DistanceThreshold.h>
 #include <mp2p_icp/Matcher_Points_InlierRatio.h>
+#include <mp2p_icp/PointNormals.h>
 #include <mp2p_icp/QualityEvaluator_PairedRatio.h>
 #include <mp2p_icp/QualityEvaluator_RangeImageSimilarity.h>
 #include <mp2p_icp/QualityEvaluator_Voxels.h>
+#include <mp2p_icp/QuantizedPoints.h>
 #include <mp2p_icp/Solver_GaussNewton.h>
 #include <mp2p_icp/Solver_Horn.h>
+#include <mp2p_icp/Solver_LevenbergMarquardt.h>
 #include <mp2p_icp/Solver_OLAE.h>
+#include <mp2p_icp/Solver_PointToPlaneLinear.h>
+#include <mp2p_icp/Solver_RANSAC.h>
 #include <mp2p_icp/pointcloud.h>
 #include <mrpt/core/initializer.h>
 
@@ -29,6 +35,8 @@ MRPT_INITIALIZER(register_mp2p_icp)
     using mrpt::rtti::registerClass;
 
     registerClass(CLASS_ID(mp2p_icp::pointcloud_t));
+    registerClass(CLASS_ID(mp2p_icp::PointNormals));
+    registerClass(CLASS_ID(mp2p_icp::QuantizedPoints));
 
     registerClass(CLASS_ID(mp2p_icp::ICP));
     registerClass(CLASS_ID(mp2p_icp::ICP_LibPointmatcher));
@@ -36,12 +44,16 @@ MRPT_INITIALIZER(register_mp2p_icp)
     registerClass(CLASS_ID(mp2p_icp::Solver));
     registerClass(CLASS_ID(mp2p_icp::Solver_OLAE));
     registerClass(CLASS_ID(mp2p_icp::Solver_GaussNewton));
+    registerClass(CLASS_ID(mp2p_icp::Solver_LevenbergMarquardt));
     registerClass(CLASS_ID(mp2p_icp::Solver_Horn));
+    registerClass(CLASS_ID(mp2p_icp::Solver_PointToPlaneLinear));
+    registerClass(CLASS_ID(mp2p_icp::Solver_RANSAC));
 
     registerClass(CLASS_ID(mp2p_icp::Matcher));
     registerClass(CLASS_ID(mp2p_icp::Matcher_Points_DistanceThreshold));
     registerClass(CLASS_ID(mp2p_icp::Matcher_Points_InlierRatio));
     registerClass(CLASS_ID(mp2p_icp::Matcher_Point2Plane));
+    registerClass(CLASS_ID(mp2p_icp::Matcher_Point2PlaneSymmetric));
 
     registerClass(CLASS_ID(mp2p_icp::QualityEvaluator));
     registerClass(CLASS_ID(mp2p_icp::QualityEvaluator_PairedRatio));
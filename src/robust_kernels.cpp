@@ -0,0 +1,82 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   robust_kernels.cpp
+ * @brief  Robust cost functions (M-estimators) for least-squares solvers
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/robust_kernels.h>
+#include <mrpt/core/exceptions.h>
+
+using namespace mp2p_icp;
+
+// All kernels are written as whole-array Eigen expressions, so the compiler
+// can vectorize them over the residuals buffer.
+
+Eigen::ArrayXd mp2p_icp::robust_kernel_weights(
+    const RobustKernel kernel, const double c, const Eigen::ArrayXd& r)
+{
+    MRPT_START
+
+    if (kernel == RobustKernel::None) return Eigen::ArrayXd::Ones(r.size());
+
+    ASSERT_GT_(c, 0.0);
+
+    const double         c2 = c * c;
+    const Eigen::ArrayXd r2 = r.square();
+
+    switch (kernel)
+    {
+        case RobustKernel::Huber:
+            return (r <= c).select(
+                Eigen::ArrayXd::Ones(r.size()), c / r.max(c));
+        case RobustKernel::Cauchy:
+            return c2 / (c2 + r2);
+        case RobustKernel::Tukey:
+            return (r <= c).select(
+                (1.0 - r2 / c2).square(), Eigen::ArrayXd::Zero(r.size()));
+        case RobustKernel::GemanMcClure:
+            return (c2 / (c2 + r2)).square();
+        default:
+            THROW_EXCEPTION("Unknown robust kernel");
+    };
+
+    MRPT_END
+}
+
+Eigen::ArrayXd mp2p_icp::robust_kernel_cost(
+    const RobustKernel kernel, const double c, const Eigen::ArrayXd& r)
+{
+    MRPT_START
+
+    const Eigen::ArrayXd r2 = r.square();
+
+    if (kernel == RobustKernel::None) return r2;
+
+    ASSERT_GT_(c, 0.0);
+
+    const double c2 = c * c;
+
+    switch (kernel)
+    {
+        case RobustKernel::Huber:
+            return (r <= c).select(r2, 2 * c * r - c2);
+        case RobustKernel::Cauchy:
+            return c2 * (1.0 + r2 / c2).log();
+        case RobustKernel::Tukey:
+            return (r <= c).select(
+                (c2 / 3) * (1.0 - (1.0 - r2 / c2).cube()),
+                Eigen::ArrayXd::Constant(r.size(), c2 / 3));
+        case RobustKernel::GemanMcClure:
+            return c2 * r2 / (c2 + r2);
+        default:
+            THROW_EXCEPTION("Unknown robust kernel");
+    };
+
+    MRPT_END
+}
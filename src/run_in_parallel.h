@@ -0,0 +1,70 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   run_in_parallel.h
+ * @brief  Minimal helper to run independent tasks on pooled threads.
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace mp2p_icp
+{
+/** Invokes `task(i)` for each i in [0,nTasks), distributing them among up to
+ * `maxThreads` threads (`0` means as many as hardware threads): the calling
+ * thread, and workers of ThreadPool::Instance(), which are created once and
+ * reused by all calls. `maxThreads=1` runs all tasks serially, in order, in
+ * the calling thread. Calls may be nested.
+ *
+ * Tasks must not depend on each other. If any task throws, the remaining
+ * ones are still run, and the exception of the lowest-index failing task is
+ * rethrown in the caller thread once all of them have finished.
+ */
+template <class TASK>
+void run_in_parallel(
+    const std::size_t nTasks, const std::size_t maxThreads, TASK task)
+{
+    auto& pool = ThreadPool::Instance();
+
+    std::size_t nThreads = maxThreads != 0 ? maxThreads : pool.size() + 1;
+    nThreads             = std::min({nThreads, pool.size() + 1, nTasks});
+
+    if (nThreads <= 1)
+    {
+        for (std::size_t i = 0; i < nTasks; i++) task(i);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(nTasks);
+    std::atomic<std::size_t>        nextTask{0};
+
+    pool.run(nThreads - 1, [&]() {
+        for (std::size_t i = nextTask++; i < nTasks; i = nextTask++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+
+    for (const auto& e : errors)
+        if (e) std::rethrow_exception(e);
+}
+
+}  // namespace mp2p_icp
@@ -0,0 +1,263 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+/**
+ * @file   select_informative_pairings.cpp
+ * @brief  Selection of the subset of pairings that best constrain the pose
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/select_informative_pairings.h>
+#include <mrpt/core/exceptions.h>
+#include <mrpt/math/CMatrixFixed.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace mp2p_icp;
+
+void PairingsSelectionParameters::load_from(const mrpt::containers::yaml& p)
+{
+    MCP_LOAD_REQ(p, enabled);
+    MCP_LOAD_OPT(p, keepRatio);
+    MCP_LOAD_OPT(p, minPairings);
+}
+
+void PairingsSelectionParameters::save_to(mrpt::containers::yaml& p) const
+{
+    MCP_SAVE(p, enabled);
+    MCP_SAVE(p, keepRatio);
+    MCP_SAVE(p, minPairings);
+}
+
+void PairingsSelectionParameters::serializeTo(
+    mrpt::serialization::CArchive& out) const
+{
+    out << enabled << keepRatio << minPairings;
+}
+
+void PairingsSelectionParameters::serializeFrom(
+    mrpt::serialization::CArchive& in)
+{
+    in >> enabled >> keepRatio >> minPairings;
+}
+
+namespace
+{
+// Contribution of one pairing to each of the 6 eigen-directions of the
+// information matrix:
+using score6_t = std::array<double, 6>;
+
+// A candidate pairing, with its global-frame position and, for
+// point-to-plane pairings, the plane normal.
+struct Candidate
+{
+    bool                  isPt2Pt = true;
+    std::size_t           idx     = 0;
+    mrpt::math::TPoint3D  pt;
+    mrpt::math::TVector3D normal;
+};
+
+// Invokes `f(row)` with each 6-vector row [n; r x n] of the Jacobian of
+// the SE(3) registration problem associated to one candidate, where `r` is
+// the centered, normalized position of the pairing and `n` is either the
+// plane normal or each of the three coordinate axes for point-to-point
+// pairings.
+template <class FUNCTOR>
+void forEachRow(
+    const Candidate& c, const mrpt::math::TPoint3D& center,
+    const double invScale, FUNCTOR f)
+{
+    const mrpt::math::TVector3D r = (c.pt - center) * invScale;
+
+    const auto rowFor = [&](const mrpt::math::TVector3D& n) {
+        const mrpt::math::TVector3D rxn = mrpt::math::crossProduct3D(r, n);
+        return std::array<double, 6>{n.x, n.y, n.z, rxn.x, rxn.y, rxn.z};
+    };
+
+    if (c.isPt2Pt)
+    {
+        f(rowFor({1.0, 0.0, 0.0}));
+        f(rowFor({0.0, 1.0, 0.0}));
+        f(rowFor({0.0, 0.0, 1.0}));
+    }
+    else
+    {
+        f(rowFor(c.normal));
+    }
+}
+
+}  // namespace
+
+Pairings mp2p_icp::select_informative_pairings(
+    const Pairings& in, const PairingsSelectionParameters& p,
+    const mrpt::poses::CPose3D& relativePose)
+{
+    MRPT_START
+
+    ASSERT_GE_(p.keepRatio, 0.0);
+    ASSERT_LE_(p.keepRatio, 1.0);
+
+    const std::size_t nPt2Pt = in.paired_pt2pt.size();
+    const std::size_t nPt2Pl = in.paired_pt2pl.size();
+    const std::size_t nCand  = nPt2Pt + nPt2Pl;
+
+    const std::size_t nKeep = std::max<std::size_t>(
+        p.minPairings, static_cast<std::size_t>(std::lround(
+                           p.keepRatio * static_cast<double>(nCand))));
+
+    // Nothing to discard?
+    if (nKeep >= nCand) return in;
+
+    // Gather candidates, in the global frame:
+    std::vector<Candidate> cands(nCand);
+    mrpt::math::TPoint3D   center(0, 0, 0);
+    for (std::size_t i = 0; i < nPt2Pt; i++)
+    {
+        const auto& pair = in.paired_pt2pt[i];
+        auto&       c    = cands[i];
+        c.isPt2Pt        = true;
+        c.idx            = i;
+        c.pt             = {pair.this_x, pair.this_y, pair.this_z};
+        center += c.pt;
+    }
+    for (std::size_t i = 0; i < nPt2Pl; i++)
+    {
+        const auto& pair = in.paired_pt2pl[i];
+        auto&       c    = cands[nPt2Pt + i];
+        c.isPt2Pt        = false;
+        c.idx            = i;
+        c.pt =
+            relativePose.composePoint(mrpt::math::TPoint3D(pair.pt_other));
+        c.normal = pair.pl_this.plane.getNormalVector();
+        center += c.pt;
+    }
+    center *= 1.0 / nCand;
+
+    // Normalize positions by their mean distance to the center, such that
+    // rotational and translational terms have comparable magnitudes:
+    double meanDist = 0;
+    for (const auto& c : cands) meanDist += (c.pt - center).norm();
+    meanDist /= nCand;
+    const double invScale = meanDist > 0 ? 1.0 / meanDist : 1.0;
+
+    // Build the 6x6 information matrix and its eigen-decomposition:
+    mrpt::math::CMatrixDouble66 H;
+    H.setZero();
+    for (const auto& c : cands)
+    {
+        forEachRow(c, center, invScale, [&](const std::array<double, 6>& row) {
+            for (int r = 0; r < 6; r++)
+                for (int s = 0; s < 6; s++) H(r, s) += row[r] * row[s];
+        });
+    }
+
+    mrpt::math::CMatrixDouble66 eigVectors;
+    std::vector<double>         eigVals;
+    H.eig_symmetric(eigVectors, eigVals, true /*sorted*/);
+
+    // Directions in the null space (e.g. motion along an infinite corridor)
+    // cannot be constrained by any pairing: ignore them, or they would keep
+    // drawing pairings with no information at all.
+    std::array<bool, 6> usedDirection;
+    for (int k = 0; k < 6; k++)
+        usedDirection[k] = eigVals[k] > 1e-9 * std::abs(eigVals[5]);
+
+    // Score each candidate by its contribution to each eigen-direction:
+    std::vector<score6_t> scores(nCand);
+    for (std::size_t i = 0; i < nCand; i++)
+    {
+        auto& sc = scores[i];
+        sc.fill(0);
+        forEachRow(
+            cands[i], center, invScale, [&](const std::array<double, 6>& row) {
+                for (int k = 0; k < 6; k++)
+                {
+                    double dot = 0;
+                    for (int r = 0; r < 6; r++)
+                        dot += row[r] * eigVectors(r, k);
+                    sc[k] += dot * dot;
+                }
+            });
+    }
+
+    // One list of candidates per eigen-direction, sorted by decreasing
+    // contribution to it:
+    std::array<std::vector<std::size_t>, 6> buckets;
+    for (int k = 0; k < 6; k++)
+    {
+        auto& b = buckets[k];
+        b.resize(nCand);
+        for (std::size_t i = 0; i < nCand; i++) b[i] = i;
+        std::sort(b.begin(), b.end(), [&](std::size_t i1, std::size_t i2) {
+            return scores[i1][k] > scores[i2][k];
+        });
+    }
+
+    // Greedy selection: always feed the least constrained direction so far.
+    std::vector<bool>          taken(nCand, false);
+    std::array<std::size_t, 6> nextInBucket;
+    std::array<double, 6>      accum;
+    nextInBucket.fill(0);
+    accum.fill(0);
+
+    for (std::size_t nSelected = 0; nSelected < nKeep;)
+    {
+        int    bestK   = -1;
+        double bestAcc = 0;
+        for (int k = 0; k < 6; k++)
+        {
+            if (!usedDirection[k]) continue;
+            auto& b = buckets[k];
+            auto& n = nextInBucket[k];
+            while (n < nCand && taken[b[n]]) n++;
+            if (n >= nCand) continue;
+            if (bestK < 0 || accum[k] < bestAcc)
+            {
+                bestK   = k;
+                bestAcc = accum[k];
+            }
+        }
+        // All pairings have been drawn already (or H was all zeros):
+        if (bestK < 0) break;
+
+        const std::size_t i = buckets[bestK][nextInBucket[bestK]++];
+        taken[i]            = true;
+        for (int k = 0; k < 6; k++) accum[k] += scores[i][k];
+        nSelected++;
+    }
+
+    // Build output, keeping the original relative order of pairings:
+    Pairings out;
+    out.paired_pt2ln     = in.paired_pt2ln;
+    out.paired_ln2ln     = in.paired_ln2ln;
+    out.paired_pl2pl     = in.paired_pl2pl;
+    out.paired_pt2pl_sym = in.paired_pt2pl_sym;
+
+    const auto& iw        = in.weights;
+    out.weights.pt2ln     = iw.pt2ln;
+    out.weights.ln2ln     = iw.ln2ln;
+    out.weights.pl2pl     = iw.pl2pl;
+    out.weights.pt2pl_sym = iw.pt2pl_sym;
+
+    for (std::size_t i = 0; i < nPt2Pt; i++)
+    {
+        if (!taken[i]) continue;
+        out.paired_pt2pt.push_back(in.paired_pt2pt[i]);
+        if (!iw.pt2pt.empty()) out.weights.pt2pt.push_back(iw.pt2pt[i]);
+    }
+    for (std::size_t i = 0; i < nPt2Pl; i++)
+    {
+        if (!taken[nPt2Pt + i]) continue;
+        out.paired_pt2pl.push_back(in.paired_pt2pl[i]);
+        if (!iw.pt2pl.empty()) out.weights.pt2pl.push_back(iw.pt2pl[i]);
+    }
+
+    return out;
+
+    MRPT_END
+}
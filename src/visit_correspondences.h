@@ -36,17 +36,6 @@ void visit_correspondences(
     const auto nPlanes     = in.paired_pl2pl.size();
     const auto nAllMatches = nPoints + nLines + nPlanes;
 
-    // weight of points, block by block:
-    auto point_weights = in.point_weights;
-    if (point_weights.empty())
-    {
-        // Default, equal weights:
-        point_weights.emplace_back(nPoints, 1.0);
-    }
-
-    auto        cur_point_block_weights = point_weights.begin();
-    std::size_t cur_point_block_start   = 0;
-
     // Normalized weights for attitude "waXX":
     double waPoints, waLines, waPlanes;
     {
@@ -95,15 +84,7 @@ void visit_correspondences(
         {
             // point-to-point pairing:  normalize(point-centroid)
             const auto& p = in.paired_pt2pt[i];
-            wi            = waPoints;
-
-            if (i >= cur_point_block_start + cur_point_block_weights->first)
-            {
-                ASSERT_(cur_point_block_weights != point_weights.end());
-                ++cur_point_block_weights;  // move to next block
-                cur_point_block_start = i;
-            }
-            wi *= cur_point_block_weights->second;
+            wi            = pairing_weight(in.weights.pt2pt, i, waPoints);
             // (solution will be normalized via w_sum a the end)
 
             bi = TVector3D(p.this_x, p.this_y, p.this_z) - ct_this;
@@ -143,10 +124,10 @@ void visit_correspondences(
         else if (i < nPoints + nLines)
         {
             // line-to-line pairing:
-            wi = waLines;
-
             const auto idxLine = i - nPoints;
 
+            wi = pairing_weight(in.weights.ln2ln, idxLine, waLines);
+
             bi = in.paired_ln2ln[idxLine].ln_this.getDirectorVector();
             ri = in.paired_ln2ln[idxLine].ln_other.getDirectorVector();
 
@@ -156,9 +137,10 @@ void visit_correspondences(
         else
         {
             // plane-to-plane pairing:
-            wi = waPlanes;
-
             const auto idxPlane = i - (nPoints + nLines);
+
+            wi = pairing_weight(in.weights.pl2pl, idxPlane, waPlanes);
+
             bi = in.paired_pl2pl[idxPlane].p_this.plane.getNormalVector();
             ri = in.paired_pl2pl[idxPlane].p_other.plane.getNormalVector();
 
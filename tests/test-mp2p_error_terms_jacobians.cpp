@@ -250,6 +250,75 @@ void test_Jacob_error_point2plane()
     }
 }
 
+// ===========================================================================
+//  Test: error_point2plane_sym
+// ===========================================================================
+
+void test_Jacob_error_point2plane_sym()
+{
+    const CPose3D p = CPose3D(
+        // x y z
+        normald(10), normald(10), normald(10),
+        // Yaw pitch roll
+        rnd.drawUniform(-M_PI, M_PI), rnd.drawUniform(-M_PI * 0.5, M_PI * 0.5),
+        rnd.drawUniform(-M_PI * 0.5, M_PI * 0.5));
+
+    const auto randomNormal = []() {
+        mrpt::math::TVector3Df n(normalf(1), normalf(1), normalf(1));
+        return n * (1.0f / n.norm());
+    };
+
+    const mp2p_icp::point_plane_sym_pair_t pair(
+        {normalf(20), normalf(20), normalf(20)}, randomNormal(),
+        {normalf(10), normalf(10), normalf(10)}, randomNormal());
+
+    // Implemented values:
+    mrpt::math::CMatrixFixed<double, 1, 12> J1;
+
+    mp2p_icp::error_point2plane_sym(pair, p, J1);
+
+    // (12x6 Jacobian)
+    const auto dDexpe_de = mrpt::poses::Lie::SE<3>::jacob_dDexpe_de(p);
+
+    const mrpt::math::CMatrixFixed<double, 1, 6> jacob(J1 * dDexpe_de);
+
+    // Numerical Jacobian:
+    CMatrixDouble numJacob;
+    {
+        CVectorFixedDouble<6> x_mean;
+        x_mean.setZero();
+
+        CVectorFixedDouble<6> x_incrs;
+        x_incrs.fill(1e-6);
+        mrpt::math::estimateJacobian(
+            x_mean,
+            /* Error function to evaluate */
+            std::function<void(
+                const CVectorFixedDouble<6>& eps, const CPose3D& D,
+                CVectorFixedDouble<1>& err)>(
+                /* Lambda, capturing the pair data */
+                [pair](
+                    const CVectorFixedDouble<6>& eps, const CPose3D& D,
+                    CVectorFixedDouble<1>& err) {
+                    // SE(3) pose increment on the manifold:
+                    const CPose3D incr         = Lie::SE<3>::exp(eps);
+                    const CPose3D D_expEpsilon = D + incr;
+                    err = mp2p_icp::error_point2plane_sym(pair, D_expEpsilon);
+                }),
+            x_incrs, p, numJacob);
+    }
+
+    if ((numJacob.asEigen() - jacob.asEigen()).array().abs().maxCoeff() > 1e-5)
+    {
+        std::cerr << "numJacob:\n"
+                  << numJacob.asEigen() << "\njacob:\n"
+                  << jacob.asEigen() << "\nDiff:\n"
+                  << (numJacob - jacob) << "\nJ1:\n"
+                  << J1.asEigen() << "\n";
+        THROW_EXCEPTION("Jacobian mismatch, see above.");
+    }
+}
+
 // ===========================================================================
 //  Test: error_line2line
 // ===========================================================================
@@ -494,6 +563,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
         test_Jacob_error_point2point();
         test_Jacob_error_point2line();
         test_Jacob_error_point2plane();
+        test_Jacob_error_point2plane_sym();
         // test_Jacob_error_line2line();
         test_Jacob_error_plane2plane();
         test_error_line2line();
@@ -11,15 +11,19 @@
  * @date   May 12, 2019
  */
 
+#include <mp2p_icp/ICP.h>
 #include <mp2p_icp/ICP_LibPointmatcher.h>
 #include <mp2p_icp/Matcher_Point2Plane.h>
+#include <mp2p_icp/Matcher_Point2PlaneSymmetric.h>
 #include <mp2p_icp/Matcher_Points_DistanceThreshold.h>
 #include <mp2p_icp/Solver_GaussNewton.h>
 #include <mp2p_icp/Solver_Horn.h>
 #include <mp2p_icp/Solver_OLAE.h>
+#include <mp2p_icp/anderson_acceleration.h>
 #include <mrpt/core/exceptions.h>
 #include <mrpt/core/get_env.h>
 #include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/poses/CPose2D.h>
 #include <mrpt/poses/CPose3D.h>
 #include <mrpt/poses/CPose3DQuat.h>
 #include <mrpt/poses/Lie/SE.h>
@@ -29,6 +33,7 @@
 #include <mrpt/system/filesystem.h>
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <iostream>
 
 #include "test-common.h"  // load_xyz_file()
@@ -45,7 +50,8 @@ const std::string datasetDir = MP2P_DATASET_DIR;
 
 static void test_icp(
     const std::string& inFile, const std::string& icpClassName,
-    const std::string& solverName, const std::string& matcherName)
+    const std::string& solverName, const std::string& matcherName,
+    const uint32_t andersonHistory = 0)
 {
     using namespace mrpt::poses::Lie;
 
@@ -55,15 +61,17 @@ static void test_icp(
 
     std::cout << "\nRunning " << icpClassName << "|" << solverName << "|"
               << matcherName << " test on: " << inFile << " with "
-              << pts->size() << " points\n";
+              << pts->size() << " points, andersonHistory="
+              << andersonHistory << "\n";
 
     double outliers_ratio = 0;
     bool   use_robust     = true;
 
     const std::string tstName = mrpt::format(
-        "test_icp_Model=%s_Algo=%s_%s_%s_outliers=%06.03f_robust=%i",
+        "test_icp_Model=%s_Algo=%s_%s_%s_outliers=%06.03f_robust=%i_aa=%u",
         inFile.c_str(), icpClassName.c_str(), solverName.c_str(),
-        matcherName.c_str(), outliers_ratio, use_robust ? 1 : 0);
+        matcherName.c_str(), outliers_ratio, use_robust ? 1 : 0,
+        static_cast<unsigned int>(andersonHistory));
 
     mrpt::math::TPoint3D bbox_min, bbox_max;
     pts->boundingBox(bbox_min, bbox_max);
@@ -167,13 +175,27 @@ static void test_icp(
 
                 m->initialize(ps);
             }
+
+            if (auto m = std::dynamic_pointer_cast<
+                    mp2p_icp::Matcher_Point2PlaneSymmetric>(
+                    icp->matchers().at(0));
+                m)
+            {
+                mrpt::containers::yaml ps;
+                ps["distanceThreshold"]   = 0.15 * max_dim;
+                ps["planeEigenThreshold"] = 10.0;
+                ps["knn"]                 = 5;
+
+                m->initialize(ps);
+            }
         }
 
         // ICP test itself:
         mp2p_icp::Parameters icp_params;
         mp2p_icp::Results    icp_results;
 
-        icp_params.maxIterations = 100;
+        icp_params.maxIterations   = 100;
+        icp_params.andersonHistory = andersonHistory;
 
         timer.Tic();
 
@@ -219,6 +241,272 @@ static void test_icp(
             "norm(XYZ_error) icp_time\n\n");
 }
 
+static void test_anderson_acceleration()
+{
+    using vector6_t = mp2p_icp::AndersonAcceleration::vector6_t;
+
+    // A linear contraction G(u) = A*u + b, with a slow (0.95) mode, and its
+    // known fixed point u* = (I-A)^-1 * b:
+    Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Zero();
+    A.diagonal() << 0.95, 0.9, 0.8, 0.7, 0.5, 0.3;
+    A(0, 1) = 0.05;
+    A(2, 4) = -0.1;
+    A(5, 3) = 0.1;
+
+    vector6_t b;
+    b << 1.0, -2.0, 0.5, 0.3, -0.7, 1.5;
+
+    const Eigen::Matrix<double, 6, 6> IminusA =
+        Eigen::Matrix<double, 6, 6>::Identity() - A;
+    const vector6_t uStar = IminusA.colPivHouseholderQr().solve(b);
+
+    const auto G = [&](const vector6_t& u) -> vector6_t { return A * u + b; };
+
+    mp2p_icp::AndersonAcceleration aa(6);
+
+    vector6_t u = vector6_t::Zero(), uPlain = vector6_t::Zero();
+
+    // The first step, without history, is the plain one:
+    u = aa.compute(u, G(u));
+    ASSERT_LT_((u - G(vector6_t::Zero())).norm(), 1e-12);
+
+    for (int i = 0; i < 15; i++) u = aa.compute(u, G(u));
+    for (int i = 0; i < 16; i++) uPlain = G(uPlain);
+
+    // A linear map in R^6 is solved exactly after a few accelerated steps,
+    // while the plain iteration is still far from it:
+    ASSERT_LT_((u - uStar).norm(), 1e-6);
+    ASSERT_GT_((uPlain - uStar).norm(), 1e-2);
+
+    // After reset(), the history is gone:
+    aa.reset();
+    const vector6_t u0 = vector6_t::Ones();
+    ASSERT_LT_((aa.compute(u0, G(u0)) - G(u0)).norm(), 1e-12);
+}
+
+// Anderson-accelerated ICP must return a pose that was evaluated, with its
+// pairings, whatever the iteration it stops at (e.g. right after the safeguard
+// rejected an extrapolated pose):
+static void test_icp_anderson_safeguard()
+{
+    using namespace mrpt::poses::Lie;
+
+    const mrpt::maps::CSimplePointsMap::Ptr pts =
+        load_xyz_file(datasetDir + "bunny_decim.xyz.gz");
+
+    mrpt::math::TPoint3D bbox_min, bbox_max;
+    pts->boundingBox(bbox_min, bbox_max);
+    const auto   bbox_size = bbox_max - bbox_min;
+    const double max_dim   = mrpt::max3(bbox_size.x, bbox_size.y, bbox_size.z);
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        0.1 * bbox_size.x, -0.05 * bbox_size.y, 0.05 * bbox_size.z,
+        mrpt::DEG2RAD(10.0), mrpt::DEG2RAD(-5.0), mrpt::DEG2RAD(5.0));
+
+    auto pts_reg = mrpt::maps::CSimplePointsMap::Create();
+    pts_reg->changeCoordinatesReference(*pts, gt_pose);
+
+    mp2p_icp::pointcloud_t pc_ref, pc_mod;
+    pc_ref.point_layers["raw"] = pts;
+    pc_mod.point_layers["raw"] = pts_reg;
+
+    auto matcher = mp2p_icp::Matcher_Points_DistanceThreshold::Create();
+    {
+        mrpt::containers::yaml ps;
+        ps["threshold"] = 0.15 * max_dim;
+        matcher->initialize(ps);
+    }
+
+    mp2p_icp::ICP icp;
+    icp.solvers().push_back(mp2p_icp::Solver_Horn::Create());
+    icp.matchers().push_back(matcher);
+
+    for (uint32_t maxIters = 1; maxIters <= 40; maxIters++)
+    {
+        mp2p_icp::Parameters icp_params;
+        mp2p_icp::Results    icp_results;
+
+        icp_params.maxIterations   = maxIters;
+        icp_params.andersonHistory = 5;
+
+        icp.align(
+            pc_mod, pc_ref, mrpt::math::TPose3D::Identity(), icp_params,
+            icp_results);
+
+        ASSERT_(!icp_results.finalPairings.empty());
+
+        // Unless it stalled (pose unchanged by the last step), the final
+        // pairings are those at the returned pose:
+        if (icp_results.terminationReason != mp2p_icp::IterTermReason::Stalled)
+        {
+            mp2p_icp::Pairings     pairingsAtPose;
+            mp2p_icp::MatchContext mc;
+            mc.icpIteration = icp_results.nIterations;
+            matcher->match(
+                pc_mod, pc_ref, icp_results.optimal_tf.mean, mc,
+                pairingsAtPose);
+
+            ASSERT_EQUAL_(
+                icp_results.finalPairings.size(), pairingsAtPose.size());
+        }
+
+        if (maxIters == 40)
+        {
+            const auto pos_error = gt_pose - icp_results.optimal_tf.mean;
+            ASSERT_LT_(SE<3>::log(pos_error).norm(), 1e-2 * max_dim);
+        }
+    }
+}
+
+// Feeding the solvers with compact pairings must not change the result,
+// both for solvers using them directly and for those converting them back:
+static void test_icp_compact_pairings()
+{
+    const mrpt::maps::CSimplePointsMap::Ptr pts =
+        load_xyz_file(datasetDir + "bunny_decim.xyz.gz");
+
+    mrpt::math::TPoint3D bbox_min, bbox_max;
+    pts->boundingBox(bbox_min, bbox_max);
+    const auto   bbox_size = bbox_max - bbox_min;
+    const double max_dim   = mrpt::max3(bbox_size.x, bbox_size.y, bbox_size.z);
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        0.05 * bbox_size.x, -0.05 * bbox_size.y, 0.02 * bbox_size.z,
+        mrpt::DEG2RAD(5.0), mrpt::DEG2RAD(-2.0), mrpt::DEG2RAD(2.0));
+
+    auto pts_reg = mrpt::maps::CSimplePointsMap::Create();
+    pts_reg->changeCoordinatesReference(*pts, gt_pose);
+
+    mp2p_icp::pointcloud_t pc_ref, pc_mod;
+    pc_ref.point_layers["raw"] = pts;
+    pc_mod.point_layers["raw"] = pts_reg;
+
+    auto matcher = mp2p_icp::Matcher_Points_DistanceThreshold::Create();
+    {
+        mrpt::containers::yaml ps;
+        ps["threshold"] = 0.15 * max_dim;
+        matcher->initialize(ps);
+    }
+
+    const std::vector<mp2p_icp::Solver::Ptr> solvers = {
+        mp2p_icp::Solver_GaussNewton::Create(),
+        mp2p_icp::Solver_Horn::Create()};
+
+    for (const auto& solver : solvers)
+    {
+        mp2p_icp::ICP icp;
+        icp.solvers().push_back(solver);
+        icp.matchers().push_back(matcher);
+
+        std::string poses[2];
+        for (int compact = 0; compact < 2; compact++)
+        {
+            mp2p_icp::Parameters icp_params;
+            icp_params.maxIterations   = 20;
+            icp_params.compactPairings = compact != 0;
+
+            mp2p_icp::Results res;
+            icp.align(
+                pc_mod, pc_ref, mrpt::math::TPose3D::Identity(), icp_params,
+                res);
+            poses[compact] = res.optimal_tf.mean.asString();
+        }
+        ASSERT_EQUAL_(poses[0], poses[1]);
+    }
+}
+
+// Planar point clouds with an SE(2) initial guess must switch to SE(2) mode,
+// unless disabled, and ICP::align(TPose2D) must find the planar pose:
+static void test_icp_se2_mode()
+{
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose2D(0.15, -0.1, mrpt::DEG2RAD(4.0));
+
+    auto pts     = mrpt::maps::CSimplePointsMap::Create();
+    auto pts_reg = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 500; i++)
+    {
+        const double x = rnd.drawUniform(-5.0, 5.0);
+        const double y = rnd.drawUniform(-5.0, 5.0);
+        pts->insertPoint(x, y, 0);
+
+        double gx, gy;
+        gt_pose.composePoint(x, y, gx, gy);
+        pts_reg->insertPoint(gx, gy, 0);
+    }
+
+    mp2p_icp::pointcloud_t pc_ref, pc_mod;
+    pc_ref.point_layers["raw"] = pts;
+    pc_mod.point_layers["raw"] = pts_reg;
+
+    auto matcher = mp2p_icp::Matcher_Points_DistanceThreshold::Create();
+    {
+        mrpt::containers::yaml ps;
+        ps["threshold"] = 1.0;
+        matcher->initialize(ps);
+    }
+
+    mp2p_icp::ICP icp;
+    icp.solvers().push_back(mp2p_icp::Solver_GaussNewton::Create());
+    icp.matchers().push_back(matcher);
+
+    mp2p_icp::Parameters icp_params;
+    icp_params.maxIterations = 100;
+
+    // Auto-detected SE(2) mode:
+    {
+        mp2p_icp::Results res;
+        icp.align(
+            pc_mod, pc_ref, mrpt::math::TPose2D(0, 0, 0), icp_params, res);
+
+        ASSERT_(res.se2Mode);
+
+        const auto sol = res.optimal_tf_2d().mean;
+        ASSERT_NEAR_(sol.x(), gt_pose.x(), 1e-3);
+        ASSERT_NEAR_(sol.y(), gt_pose.y(), 1e-3);
+        ASSERT_NEAR_(sol.phi(), gt_pose.phi(), 1e-3);
+        ASSERT_NEAR_(res.optimal_tf.mean.z(), 0.0, 1e-9);
+        ASSERT_NEAR_(res.optimal_tf.mean.pitch(), 0.0, 1e-9);
+        ASSERT_NEAR_(res.optimal_tf.mean.roll(), 0.0, 1e-9);
+    }
+
+    // Only the mode is checked from now on:
+    icp_params.maxIterations = 1;
+
+    // Not with a non-planar initial guess, nor if disabled:
+    {
+        mp2p_icp::Results res;
+        icp.align(
+            pc_mod, pc_ref, mrpt::math::TPose3D(0, 0, 0.1, 0, 0, 0),
+            icp_params, res);
+        ASSERT_(!res.se2Mode);
+    }
+    {
+        mp2p_icp::Parameters p = icp_params;
+        p.autoSE2Mode          = false;
+
+        mp2p_icp::Results res;
+        icp.align(pc_mod, pc_ref, mrpt::math::TPose2D(0, 0, 0), p, res);
+        ASSERT_(!res.se2Mode);
+    }
+
+    // Nor with a non-planar cloud:
+    {
+        auto pts3D = mrpt::maps::CSimplePointsMap::Create();
+        *pts3D     = *pts;
+        pts3D->insertPoint(0, 0, 1.0);
+
+        mp2p_icp::pointcloud_t pc_ref3D;
+        pc_ref3D.point_layers["raw"] = pts3D;
+
+        mp2p_icp::Results res;
+        icp.align(
+            pc_mod, pc_ref3D, mrpt::math::TPose2D(0, 0, 0), icp_params, res);
+        ASSERT_(!res.se2Mode);
+    }
+}
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
 {
     try
@@ -226,6 +514,11 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
         auto& rnd = mrpt::random::getRandomGenerator();
         rnd.randomize(1234);  // for reproducible tests
 
+        test_anderson_acceleration();
+        test_icp_anderson_safeguard();
+        test_icp_compact_pairings();
+        test_icp_se2_mode();
+
         const std::vector<const char*> lst_files{
             {"bunny_decim.xyz.gz", "happy_buddha_decim.xyz.gz"}};
 
@@ -245,6 +538,15 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
              {"mp2p_icp::ICP", "mp2p_icp::Solver_GaussNewton", "mp2p_icp::Matcher_Points_DistanceThreshold"},
              {"mp2p_icp::ICP", "mp2p_icp::Solver_GaussNewton", "mp2p_icp::Matcher_Points_InlierRatio"},
              {"mp2p_icp::ICP", "mp2p_icp::Solver_GaussNewton", "mp2p_icp::Matcher_Point2Plane"},
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_GaussNewton", "mp2p_icp::Matcher_Point2PlaneSymmetric"},
+
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_LevenbergMarquardt", "mp2p_icp::Matcher_Points_DistanceThreshold"},
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_LevenbergMarquardt", "mp2p_icp::Matcher_Point2Plane"},
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_LevenbergMarquardt", "mp2p_icp::Matcher_Point2PlaneSymmetric"},
+
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_PointToPlaneLinear", "mp2p_icp::Matcher_Points_DistanceThreshold"},
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_PointToPlaneLinear", "mp2p_icp::Matcher_Point2Plane"},
+             {"mp2p_icp::ICP", "mp2p_icp::Solver_PointToPlaneLinear", "mp2p_icp::Matcher_Point2PlaneSymmetric"},
              };
         // clang-format on
 
@@ -257,6 +559,13 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
                 test_icp(
                     fil, std::get<0>(algo), std::get<1>(algo),
                     std::get<2>(algo));
+
+        // Anderson-accelerated outer loop:
+        for (const auto& fil : lst_files)
+            test_icp(
+                fil, "mp2p_icp::ICP", "mp2p_icp::Solver_Horn",
+                "mp2p_icp::Matcher_Points_DistanceThreshold",
+                5 /*andersonHistory*/);
     }
     catch (std::exception& e)
     {
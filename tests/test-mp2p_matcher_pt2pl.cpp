@@ -12,8 +12,16 @@
  */
 
 #include <mp2p_icp/Matcher_Point2Plane.h>
+#include <mp2p_icp/Matcher_Point2PlaneSymmetric.h>
+#include <mp2p_icp/estimate_normals.h>
 #include <mp2p_icp/pointcloud.h>
+#include <mrpt/io/CMemoryStream.h>
 #include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/serialization/CArchive.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
 
 static mrpt::maps::CSimplePointsMap::Ptr generateGlobalPoints()
 {
@@ -48,10 +56,186 @@ static mrpt::maps::CSimplePointsMap::Ptr generateLocalPoints()
     return pts;
 }
 
+static void test_estimate_normals()
+{
+    mp2p_icp::pointcloud_t pc;
+    pc.point_layers["raw"] = generateGlobalPoints();
+
+    mp2p_icp::NormalEstimationParameters p;
+    p.knn         = 10;
+    p.maxDistance = 0.05;
+
+    // The same results, regardless of the number of threads:
+    p.maxThreads = 1;
+    const auto serial =
+        mp2p_icp::estimate_normals(*pc.point_layers["raw"], p);
+
+    p.maxThreads = 4;
+    mp2p_icp::estimate_normals(pc, p);
+    const auto normals = pc.normalsOf("raw");
+    ASSERT_(normals);
+    ASSERT_EQUAL_(normals->size(), pc.point_layers["raw"]->size());
+    ASSERT_(normals->nx == serial->nx);
+    ASSERT_(normals->ratio02 == serial->ratio02);
+
+    // Points of the z=0 plane, then of the x=10 plane:
+    for (std::size_t i = 0; i < 200; i++)
+    {
+        ASSERT_(normals->valid[i]);
+        ASSERT_LT_(normals->ratio02[i], 1e-3f);
+        const float n = i < 100 ? normals->nz[i] : normals->nx[i];
+        ASSERT_NEAR_(std::abs(n), 1.0f, 1e-3f);
+    }
+
+    // Normals are serialized with the point cloud:
+    mrpt::io::CMemoryStream buf;
+    auto                    arch = mrpt::serialization::archiveFrom(buf);
+    arch << pc;
+    buf.Seek(0);
+    mp2p_icp::pointcloud_t pc2;
+    arch >> pc2;
+    ASSERT_(pc2.normalsOf("raw"));
+    ASSERT_(pc2.normalsOf("raw")->nz == normals->nz);
+
+    // ...and invalidated if the layer may change, even if it keeps the same
+    // number of points:
+    auto pc3 = pc2;
+    pc3.mutableLayer("raw")->setPoint(0, 5.0f, 5.0f, 5.0f);
+    ASSERT_(!pc3.normalsOf("raw"));
+    ASSERT_(pc2.normalsOf("raw"));
+
+    pc2.mutableLayer("raw")->insertPoint(0, 0, 0);
+    ASSERT_(!pc2.normalsOf("raw"));
+}
+
+// Normals in pointcloud_t::layer_normals give the same pairings as those
+// fit by the matcher itself, with the same neighborhoods:
+static void test_symmetric_precomputed_normals()
+{
+    // Only the two planes of the test cloud:
+    auto planes = mrpt::maps::CSimplePointsMap::Create();
+    {
+        const auto all = generateGlobalPoints();
+        for (std::size_t i = 0; i < 200; i++)
+        {
+            float x, y, z;
+            all->getPoint(i, x, y, z);
+            planes->insertPoint(x, y, z);
+        }
+    }
+
+    mp2p_icp::pointcloud_t pcGlobal, pcLocal;
+    pcGlobal.point_layers["raw"] = planes;
+    pcLocal.point_layers["raw"]  = mrpt::maps::CSimplePointsMap::Create();
+    pcLocal.point_layers["raw"]->insertAnotherMap(
+        planes.get(), mrpt::poses::CPose3D::Identity());
+
+    mrpt::containers::yaml p;
+    p["distanceThreshold"]   = 0.05;
+    p["knn"]                 = 10;
+    p["planeEigenThreshold"] = 0.1;
+
+    const mrpt::poses::CPose3D localPose(0.003, 0, 0.002, 0, 0, 0);
+
+    mp2p_icp::Pairings onDemand;
+    {
+        mp2p_icp::Matcher_Point2PlaneSymmetric m;
+        m.initialize(p);
+        m.match(pcGlobal, pcLocal, localPose, {}, onDemand);
+    }
+    ASSERT_GT_(onDemand.paired_pt2pl_sym.size(), 0U);
+
+    mp2p_icp::NormalEstimationParameters np;
+    np.knn         = 10;
+    np.maxDistance = 0.05;
+    mp2p_icp::estimate_normals(pcGlobal, np);
+    mp2p_icp::estimate_normals(pcLocal, np);
+
+    mp2p_icp::Pairings precomputed;
+    {
+        mp2p_icp::Matcher_Point2PlaneSymmetric m;
+        m.initialize(p);
+        m.match(pcGlobal, pcLocal, localPose, {}, precomputed);
+    }
+    ASSERT_EQUAL_(
+        precomputed.paired_pt2pl_sym.size(), onDemand.paired_pt2pl_sym.size());
+
+    // Normals are equal up to their sign:
+    const auto absDot = [](const mrpt::math::TVector3Df& u,
+                           const mrpt::math::TVector3Df& v) {
+        return std::abs(u.x * v.x + u.y * v.y + u.z * v.z);
+    };
+    for (std::size_t i = 0; i < onDemand.paired_pt2pl_sym.size(); i++)
+    {
+        const auto& a = onDemand.paired_pt2pl_sym[i];
+        const auto& b = precomputed.paired_pt2pl_sym[i];
+        ASSERT_(a.pt_this == b.pt_this);
+        ASSERT_NEAR_(absDot(a.n_this, b.n_this), 1.0f, 1e-4f);
+        ASSERT_NEAR_(absDot(a.n_other, b.n_other), 1.0f, 1e-4f);
+    }
+}
+
+// A local layer matched against several global layers, in parallel, shares
+// one cache of normals, and gets the same pairings than serially:
+static void test_symmetric_shared_local_layer()
+{
+    mp2p_icp::pointcloud_t pcGlobal, pcLocal;
+    for (const char* ly : {"a", "b", "c"})
+        pcGlobal.point_layers[ly] = generateGlobalPoints();
+    pcLocal.point_layers["raw"] = generateGlobalPoints();
+
+    const mrpt::poses::CPose3D localPose(0.003, 0, 0.002, 0, 0, 0);
+
+    std::vector<mp2p_icp::Pairings> results;
+    for (const int nThreads : {1, 4})
+    {
+        auto p = mrpt::containers::yaml::FromText(R"###(
+distanceThreshold: 0.05
+knn: 10
+planeEigenThreshold: 0.1
+pointLayerWeights:
+  a: { raw: 1.0 }
+  b: { raw: 1.0 }
+  c: { raw: 1.0 }
+)###");
+        p["maxLayerMatchingThreads"] = nThreads;
+
+        mp2p_icp::Matcher_Point2PlaneSymmetric m;
+        m.initialize(p);
+
+        mp2p_icp::MatchContext mc;
+        for (mc.icpIteration = 0; mc.icpIteration < 2; mc.icpIteration++)
+        {
+            mp2p_icp::Pairings pairs;
+            m.match(pcGlobal, pcLocal, localPose, mc, pairs);
+            results.push_back(std::move(pairs));
+        }
+    }
+
+    const auto& ref = results.front().paired_pt2pl_sym;
+    ASSERT_GT_(ref.size(), 0U);
+    ASSERT_EQUAL_(ref.size() % 3, 0U);
+    for (const auto& res : results)
+    {
+        const auto& pairs = res.paired_pt2pl_sym;
+        ASSERT_EQUAL_(pairs.size(), ref.size());
+        for (std::size_t i = 0; i < ref.size(); i++)
+        {
+            ASSERT_(pairs[i].pt_other == ref[i].pt_other);
+            ASSERT_(pairs[i].n_other == ref[i].n_other);
+            ASSERT_(pairs[i].n_this == ref[i].n_this);
+        }
+    }
+}
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
 {
     try
     {
+        test_estimate_normals();
+        test_symmetric_precomputed_normals();
+        test_symmetric_shared_local_layer();
+
         mp2p_icp::pointcloud_t pcGlobal;
         pcGlobal.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] =
             generateGlobalPoints();
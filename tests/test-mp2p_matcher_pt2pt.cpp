@@ -11,11 +11,23 @@
  * @date   July 22, 2020
  */
 
+#include <mp2p_icp/ICP.h>
 #include <mp2p_icp/Matcher_Points_DistanceThreshold.h>
 #include <mp2p_icp/Matcher_Points_InlierRatio.h>
+#include <mp2p_icp/SharedPointCloud.h>
+#include <mp2p_icp/morton_order.h>
 #include <mp2p_icp/pointcloud.h>
+#include <mrpt/maps/CPointsMapXYZI.h>
 #include <mrpt/maps/CSimplePointsMap.h>
 
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 static mrpt::maps::CSimplePointsMap::Ptr generateGlobalPoints()
 {
     auto pts = mrpt::maps::CSimplePointsMap::Create();
@@ -36,10 +48,477 @@ static mrpt::maps::CSimplePointsMap::Ptr generateLocalPoints()
     return pts;
 }
 
+static void test_local_points_sampling()
+{
+    using mp2p_icp::Matcher_Points_Base;
+
+    // A dense cluster (1000 pts) and a sparse line (10 pts):
+    auto pts = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 1000; i++)
+        pts->insertPoint(0.01f * (i % 10), 0.01f * ((i / 10) % 10), .0f);
+    for (int i = 0; i < 10; i++) pts->insertPoint(5.0f + i, .0f, .0f);
+
+    Matcher_Points_Base::LocalSamplingParameters sp;
+    sp.seed = 123;
+
+    // No sampling requested:
+    ASSERT_(!Matcher_Points_Base::sample_local_points(*pts, sp).has_value());
+
+    // Random subsets must hold unique, valid indices:
+    for (const bool reservoir : {false, true})
+    {
+        sp.maxLocalPoints = 50;
+        sp.reservoir      = reservoir;
+        const auto idxs = Matcher_Points_Base::sample_local_points(*pts, sp);
+        ASSERT_(idxs.has_value());
+        ASSERT_EQUAL_(idxs->size(), 50U);
+        std::set<std::size_t> unique(idxs->begin(), idxs->end());
+        ASSERT_EQUAL_(unique.size(), 50U);
+        ASSERT_LT_(*unique.rbegin(), pts->size());
+    }
+
+    // Voxel-stratified: the whole dense cluster falls in one voxel, so the
+    // sparse points must all be kept:
+    sp.maxLocalPoints    = 0;
+    sp.reservoir         = false;
+    sp.voxelSize         = 0.5;
+    sp.maxPointsPerVoxel = 2;
+    const auto idxs = Matcher_Points_Base::sample_local_points(*pts, sp);
+    ASSERT_(idxs.has_value());
+    ASSERT_EQUAL_(idxs->size(), 2U + 10U);
+}
+
+// Matching layers in parallel must give exactly the same pairings, in the
+// same order, and with the same per-point weights, than doing it serially:
+static void test_parallel_layers()
+{
+    mp2p_icp::pointcloud_t pcGlobal, pcLocal;
+    for (const char* ly : {"a", "b", "c"})
+    {
+        pcGlobal.point_layers[ly] = generateGlobalPoints();
+        pcLocal.point_layers[ly]  = generateLocalPoints();
+    }
+
+    mp2p_icp::Pairings serialPairs;
+    for (const int nThreads : {1, 4})
+    {
+        auto p = mrpt::containers::yaml::FromText(R"###(
+threshold: 1.0
+pointLayerWeights:
+  a: { a: 1.0 }
+  b: { a: 2.0, b: 2.0 }
+  c: { c: 0.5 }
+)###");
+        p["maxLayerMatchingThreads"] = nThreads;
+
+        mp2p_icp::Matcher_Points_DistanceThreshold m;
+        m.initialize(p);
+
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, {-2, 5, 0, 0, 0, 0}, {}, pairs);
+
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 4U);
+
+        // One weight per pairing, in layer order: {1.0, 2.0, 2.0, 0.5}
+        const std::vector<double> expectedWeights = {1.0, 2.0, 2.0, 0.5};
+        ASSERT_(pairs.weights.pt2pt == expectedWeights);
+
+        if (nThreads == 1)
+        {
+            serialPairs = pairs;
+            continue;
+        }
+        ASSERT_(pairs.weights.pt2pt == serialPairs.weights.pt2pt);
+        for (size_t i = 0; i < pairs.paired_pt2pt.size(); i++)
+        {
+            const auto &p1 = pairs.paired_pt2pt[i],
+                       &p2 = serialPairs.paired_pt2pt[i];
+            ASSERT_EQUAL_(p1.this_idx, p2.this_idx);
+            ASSERT_EQUAL_(p1.other_idx, p2.other_idx);
+            ASSERT_EQUAL_(p1.other_x, p2.other_x);
+        }
+    }
+}
+
+// Local points in an external, interleaved buffer must give the same
+// pairings than the same points in a points map:
+static void test_external_local_layer()
+{
+    mp2p_icp::pointcloud_t pcGlobal, pcLocalMap, pcLocalExt;
+    pcGlobal.point_layers["raw"]   = generateGlobalPoints();
+    pcLocalMap.point_layers["raw"] = generateLocalPoints();
+
+    // x,y,z,intensity:
+    const std::vector<float> buf = {0.f, 0.f, 0.f, 0.9f, 2.f, 0.f, 0.f, 0.1f};
+    pcLocalExt.external_layers["raw"] =
+        mp2p_icp::PointsView::FromInterleaved(buf.data(), 2, 4);
+
+    ASSERT_EQUAL_(pcLocalExt.size(), 2U);
+
+    mp2p_icp::Matcher_Points_DistanceThreshold m;
+    mrpt::containers::yaml                     p;
+    p["threshold"] = 1.0;
+    m.initialize(p);
+
+    for (const auto& pose : {mrpt::poses::CPose3D(0, 5, 0, 0, 0, 0),
+                             mrpt::poses::CPose3D(-2, 5, 0, 0, 0, 0)})
+    {
+        mp2p_icp::Pairings pairsMap, pairsExt;
+        m.match(pcGlobal, pcLocalMap, pose, {}, pairsMap);
+        m.match(pcGlobal, pcLocalExt, pose, {}, pairsExt);
+
+        ASSERT_EQUAL_(pairsExt.paired_pt2pt.size(), 1U);
+        ASSERT_EQUAL_(
+            pairsExt.paired_pt2pt.size(), pairsMap.paired_pt2pt.size());
+
+        const auto &p1 = pairsExt.paired_pt2pt[0],
+                   &p2 = pairsMap.paired_pt2pt[0];
+        ASSERT_EQUAL_(p1.this_idx, p2.this_idx);
+        ASSERT_EQUAL_(p1.other_idx, p2.other_idx);
+        ASSERT_EQUAL_(p1.other_x, p2.other_x);
+    }
+}
+
+// The layers resolved in the first ICP iteration must not be reused in later
+// ones if the layers of the point clouds changed in between:
+static void test_layer_plan_invalidation()
+{
+    mp2p_icp::pointcloud_t pcGlobal, pcLocal;
+    pcGlobal.point_layers["raw"] = generateGlobalPoints();
+    pcLocal.point_layers["raw"]  = generateLocalPoints();
+
+    mp2p_icp::Matcher_Points_DistanceThreshold m;
+    mrpt::containers::yaml                     p;
+    p["threshold"] = 1.0;
+    m.initialize(p);
+
+    const mrpt::poses::CPose3D pose(-2, 5, 0, 0, 0, 0);
+
+    mp2p_icp::MatchContext mc;
+    mc.icpIteration = 0;
+    {
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, pose, mc, pairs);
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 1U);
+    }
+    mc.icpIteration = 1;
+
+    // Same layer name, another layer object:
+    {
+        auto pts = mrpt::maps::CSimplePointsMap::Create();
+        pts->insertPoint(2.f, 0.f, 0.f);
+        pts->insertPoint(2.f, 0.f, 0.f);
+        pts->insertPoint(12.f, -5.f, 1.f);
+        pcLocal.point_layers["raw"] = pts;
+
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, pose, mc, pairs);
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 3U);
+    }
+
+    // Same layer object, resized:
+    {
+        pcLocal.point_layers["raw"]->insertPoint(2.f, 0.f, 0.f);
+
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, pose, mc, pairs);
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 4U);
+    }
+
+    // A new layer:
+    {
+        pcGlobal.point_layers["other"] = generateGlobalPoints();
+        pcLocal.point_layers["other"]  = generateLocalPoints();
+
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, pose, mc, pairs);
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 5U);
+    }
+
+    // A removed layer:
+    {
+        pcLocal.point_layers.erase("raw");
+
+        mp2p_icp::Pairings pairs;
+        m.match(pcGlobal, pcLocal, pose, mc, pairs);
+        ASSERT_EQUAL_(pairs.paired_pt2pt.size(), 1U);
+    }
+}
+
+// Matching against snapshots of a map while another thread extends it must
+// see consistent versions: the pairings only depend on the version.
+static void test_shared_map_snapshots()
+{
+    mp2p_icp::pointcloud_t initial;
+    initial.point_layers["raw"] = generateGlobalPoints();
+    mp2p_icp::SharedPointCloud shared(std::move(initial));
+
+    mp2p_icp::pointcloud_t pcLocal;
+    pcLocal.point_layers["raw"] = generateLocalPoints();
+
+    std::atomic_bool done{false};
+    std::thread      writer([&]() {
+        for (int i = 0; i < 50; i++)
+        {
+            shared.update([i](mp2p_icp::pointcloud_t& m) {
+                // Far from the local points, so pairings do not change:
+                m.mutableLayer("raw")->insertPoint(100.0f + i, 0, 0);
+            });
+        }
+        done = true;
+    });
+
+    const auto reader = [&]() {
+        mp2p_icp::Matcher_Points_DistanceThreshold m;
+        mrpt::containers::yaml                     p;
+        p["threshold"] = 1.0;
+        m.initialize(p);
+
+        while (!done)
+        {
+            const auto snap = shared.snapshot();
+            ASSERT_EQUAL_(
+                snap->map.point_layers.at("raw")->size(), 20 + snap->version);
+
+            mp2p_icp::Pairings pairs;
+            m.match(snap->map, pcLocal, {-2, 5, 0, 0, 0, 0}, {}, pairs);
+            ASSERT_EQUAL_(pairs.size(), 1U);
+            ASSERT_EQUAL_(pairs.paired_pt2pt.at(0).this_idx, 0U);
+        }
+    };
+    std::thread reader1(reader), reader2(reader);
+
+    writer.join();
+    reader1.join();
+    reader2.join();
+
+    ASSERT_EQUAL_(shared.snapshot()->version, 50U);
+}
+
+// Several threads matching against the same, freshly published snapshot
+// get the same pairings than a single one. Nothing is built lazily from the
+// readers, which is what matters when run under a thread sanitizer.
+static void test_shared_map_concurrent_readers()
+{
+    mp2p_icp::pointcloud_t pcLocal;
+    pcLocal.point_layers["raw"] = generateLocalPoints();
+
+    const mrpt::poses::CPose3D localPose(-2, 5, 0, 0, 0, 0);
+
+    mp2p_icp::pointcloud_t initial;
+    initial.point_layers["raw"] = generateGlobalPoints();
+    mp2p_icp::SharedPointCloud shared(std::move(initial));
+    shared.update([](mp2p_icp::pointcloud_t& m) {
+        m.mutableLayer("raw")->insertPoint(100.0f, 0, 0);
+    });
+
+    const auto match = [&](const mp2p_icp::pointcloud_t& map) {
+        mp2p_icp::Matcher_Points_DistanceThreshold m;
+        mrpt::containers::yaml                     p;
+        p["threshold"] = 1.0;
+        m.initialize(p);
+
+        mp2p_icp::Pairings pairs;
+        m.match(map, pcLocal, localPose, {}, pairs);
+        return pairs;
+    };
+
+    const auto snap = shared.snapshot();
+
+    constexpr int                   nReaders = 4;
+    std::atomic_int                 ready{0};
+    std::vector<mp2p_icp::Pairings> results(nReaders);
+    std::vector<std::thread>        readers;
+    for (int r = 0; r < nReaders; r++)
+    {
+        readers.emplace_back([&, r]() {
+            // Start all queries at once:
+            ready++;
+            while (ready < nReaders) std::this_thread::yield();
+
+            results[r] = match(snap->map);
+        });
+    }
+    for (auto& t : readers) t.join();
+
+    const auto ref = match(snap->map);
+    ASSERT_EQUAL_(ref.paired_pt2pt.size(), 1U);
+    for (const auto& res : results)
+    {
+        ASSERT_EQUAL_(res.paired_pt2pt.size(), 1U);
+        ASSERT_EQUAL_(
+            res.paired_pt2pt[0].this_idx, ref.paired_pt2pt[0].this_idx);
+    }
+}
+
+// Reordering a map in Morton order keeps the same points, each with its own
+// extra fields, and makes their codes non-decreasing in memory:
+static void test_morton_reorder()
+{
+    // A grid, in row-major order (which is not Z-order):
+    mrpt::maps::CPointsMapXYZI pts;
+    for (int iy = 0; iy < 16; iy++)
+        for (int ix = 0; ix < 16; ix++)
+        {
+            pts.insertPointFast(ix * 0.5f, iy * 0.5f, (ix + iy) * 0.1f);
+            pts.setPointIntensity(pts.size() - 1, (ix + 16 * iy) / 256.0f);
+        }
+    pts.mark_as_modified();
+
+    using point_t = std::tuple<float, float, float>;
+    const auto allPoints = [](const mrpt::maps::CPointsMapXYZI& m) {
+        std::map<point_t, float> r;
+        for (std::size_t i = 0; i < m.size(); i++)
+        {
+            float x, y, z;
+            m.getPoint(i, x, y, z);
+            r[{x, y, z}] = m.getPointIntensity(i);
+        }
+        return r;
+    };
+
+    const auto before = allPoints(pts);
+    const auto orig   = pts.getPointsBufferRef_x();
+
+    mp2p_icp::reorder_points_morton(pts);
+
+    ASSERT_EQUAL_(pts.size(), 256U);
+    ASSERT_(allPoints(pts) == before);
+    ASSERT_(pts.getPointsBufferRef_x() != orig);
+
+    mrpt::math::TPoint3Df bbMin, bbMax;
+    pts.boundingBox(bbMin.x, bbMax.x, bbMin.y, bbMax.y, bbMin.z, bbMax.z);
+    for (std::size_t i = 1; i < pts.size(); i++)
+    {
+        float x0, y0, z0, x1, y1, z1;
+        pts.getPoint(i - 1, x0, y0, z0);
+        pts.getPoint(i, x1, y1, z1);
+        ASSERT_LE_(
+            mp2p_icp::morton_code(x0, y0, z0, bbMin, bbMax),
+            mp2p_icp::morton_code(x1, y1, z1, bbMin, bbMax));
+    }
+
+    // Reordering a copy of a point cloud leaves the original untouched:
+    mp2p_icp::pointcloud_t pc;
+    pc.point_layers["raw"] = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 100; i++)
+        pc.point_layers["raw"]->insertPoint(i % 10, i / 10, 0);
+
+    // Normals tagged with the coordinates of their points:
+    auto normals = mp2p_icp::PointNormals::Create();
+    normals->resize(100);
+    for (std::size_t i = 0; i < 100; i++)
+    {
+        normals->nx[i]        = static_cast<float>(i % 10);
+        normals->ny[i]        = static_cast<float>(i / 10);
+        normals->curvature[i] = static_cast<float>(i);
+        normals->valid[i]     = static_cast<uint8_t>(i % 2);
+    }
+    pc.layer_normals["raw"] = normals;
+
+    auto c = pc;
+    mp2p_icp::reorder_layers_morton(c);
+    ASSERT_(c.point_layers["raw"] != pc.point_layers["raw"]);
+    for (std::size_t i = 0; i < 100; i++)
+    {
+        float x, y, z;
+        pc.point_layers["raw"]->getPoint(i, x, y, z);
+        ASSERT_EQUAL_(x, static_cast<float>(i % 10));
+        ASSERT_EQUAL_(y, static_cast<float>(i / 10));
+        ASSERT_EQUAL_(normals->curvature[i], static_cast<float>(i));
+    }
+
+    // Normals follow their points:
+    const auto cNormals = c.normalsOf("raw");
+    ASSERT_(cNormals);
+    ASSERT_(cNormals != normals);
+    for (std::size_t i = 0; i < 100; i++)
+    {
+        float x, y, z;
+        c.point_layers["raw"]->getPoint(i, x, y, z);
+        ASSERT_EQUAL_(cNormals->nx[i], x);
+        ASSERT_EQUAL_(cNormals->ny[i], y);
+
+        const auto orig = static_cast<std::size_t>(x + 10 * y);
+        ASSERT_EQUAL_(cNormals->curvature[i], static_cast<float>(orig));
+        ASSERT_EQUAL_(cNormals->valid[i], static_cast<uint8_t>(orig % 2));
+    }
+}
+
+// Running several matchers concurrently, all of them querying the same
+// global layer, must give the same pairings than running them serially:
+static void test_parallel_matchers()
+{
+    mp2p_icp::pointcloud_t pcGlobal, pcLocal;
+
+    auto gPts = mrpt::maps::CSimplePointsMap::Create();
+    auto lPts = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 2000; i++)
+    {
+        const float x = 0.05f * (i % 40), y = 0.05f * (i / 40),
+                    z = 0.1f * std::sin(0.3f * i);
+        gPts->insertPoint(x, y, z);
+        if (i % 3 == 0) lPts->insertPoint(x + 0.01f, y - 0.02f, z);
+    }
+    for (const char* ly : {"a", "b"})
+    {
+        // The same map object under two names, and a shared local layer:
+        pcGlobal.point_layers[ly] = gPts;
+        pcLocal.point_layers[ly]  = lPts;
+    }
+
+    mp2p_icp::ICP::matcher_list_t matchers;
+    for (const double threshold : {0.05, 0.5})
+    {
+        auto m = mp2p_icp::Matcher_Points_DistanceThreshold::Create();
+        mrpt::containers::yaml p;
+        p["threshold"]               = threshold;
+        p["maxLayerMatchingThreads"] = 0;
+        m->initialize(p);
+        matchers.push_back(m);
+    }
+    {
+        auto m = mp2p_icp::Matcher_Points_InlierRatio::Create();
+        mrpt::containers::yaml p;
+        p["inliersRatio"] = 0.5;
+        m->initialize(p);
+        matchers.push_back(m);
+    }
+
+    const mrpt::poses::CPose3D pose(0.02, -0.01, 0, 0.01, 0, 0);
+
+    const auto serial =
+        mp2p_icp::ICP::run_matchers(matchers, pcGlobal, pcLocal, pose, {}, 1);
+    ASSERT_GT_(serial.paired_pt2pt.size(), 0U);
+
+    for (const std::size_t nThreads : {0, 3})
+    {
+        const auto par = mp2p_icp::ICP::run_matchers(
+            matchers, pcGlobal, pcLocal, pose, {}, nThreads);
+
+        ASSERT_EQUAL_(par.paired_pt2pt.size(), serial.paired_pt2pt.size());
+        for (size_t i = 0; i < par.paired_pt2pt.size(); i++)
+        {
+            const auto &p1 = par.paired_pt2pt[i], &p2 = serial.paired_pt2pt[i];
+            ASSERT_EQUAL_(p1.this_idx, p2.this_idx);
+            ASSERT_EQUAL_(p1.other_idx, p2.other_idx);
+        }
+    }
+}
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
 {
     try
     {
+        test_morton_reorder();
+        test_local_points_sampling();
+        test_parallel_layers();
+        test_parallel_matchers();
+        test_external_local_layer();
+        test_layer_plan_invalidation();
+        test_shared_map_snapshots();
+        test_shared_map_concurrent_readers();
+
         mp2p_icp::pointcloud_t pcGlobal;
         pcGlobal.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] =
             generateGlobalPoints();
@@ -48,10 +527,13 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
         pcLocal.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] =
             generateLocalPoints();
 
+        // Sorting local points in Morton order must not change the pairings:
+        for (const bool mortonOrder : {false, true})
         {
             mp2p_icp::Matcher_Points_DistanceThreshold m;
             mrpt::containers::yaml               p;
-            p["threshold"] = 1.0;
+            p["threshold"]              = 1.0;
+            p["mortonOrderLocalPoints"] = mortonOrder;
 
             m.initialize(p);
 
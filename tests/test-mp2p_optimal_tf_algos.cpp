@@ -11,18 +11,28 @@
  * @date   May 12, 2019
  */
 
+#include <mp2p_icp/CompactPairings.h>
+#include <mp2p_icp/Solver_GaussNewton.h>
+#include <mp2p_icp/Solver_RANSAC.h>
 #include <mp2p_icp/optimal_tf_gauss_newton.h>
 #include <mp2p_icp/optimal_tf_horn.h>
+#include <mp2p_icp/optimal_tf_levenberg_marquardt.h>
 #include <mp2p_icp/optimal_tf_olae.h>
+#include <mp2p_icp/optimal_tf_point2plane_linear.h>
+#include <mp2p_icp/optimal_tf_se2.h>
+#include <mp2p_icp/select_informative_pairings.h>
 #include <mrpt/core/exceptions.h>
 #include <mrpt/core/get_env.h>
+#include <mrpt/poses/CPose2D.h>
 #include <mrpt/poses/CPose3D.h>
 #include <mrpt/poses/CPose3DQuat.h>
+#include <mrpt/poses/Lie/SE.h>
 #include <mrpt/poses/Lie/SO.h>
 #include <mrpt/random.h>
 #include <mrpt/system/CTimeLogger.h>
 #include <mrpt/system/filesystem.h>  // fileNameStripInvalidChars()
 
+#include <cmath>
 #include <cstdlib>
 #include <sstream>
 
@@ -503,6 +513,609 @@ bool test_icp_algos(
     MRPT_END
 }
 
+// Gauss-Newton must converge to the minimum of sum_i w_i |e_i|^2, with its
+// historical weighting of the Jacobians only. The same local points are
+// paired with two global copies, shifted by tA and tB, with weights wA and
+// wB, so the optimum is a pure translation by their weighted mean.
+// Point-to-plane pairings, consistent with that optimum, must not change it.
+static void test_gauss_newton_weights()
+{
+    using namespace mp2p_icp;
+
+    const TPoints               pts = generate_points(50);
+    const mrpt::math::TVector3D tA(1.0, -2.0, 0.5), tB(-1.0, 0.0, 1.5);
+    const double                wA = 3.0, wB = 1.0;
+    const auto                  tOpt = (tA * wA + tB * wB) * (1.0 / (wA + wB));
+
+    Pairings in;
+    for (const auto& [t, w] : {std::make_pair(tA, wA), std::make_pair(tB, wB)})
+    {
+        for (size_t i = 0; i < pts.size(); i++)
+        {
+            auto& p     = in.paired_pt2pt.emplace_back();
+            p.this_idx  = in.paired_pt2pt.size() - 1;
+            p.other_idx = i;
+            p.this_x    = pts[i].x + t.x;
+            p.this_y    = pts[i].y + t.y;
+            p.this_z    = pts[i].z + t.z;
+            p.other_x   = pts[i].x;
+            p.other_y   = pts[i].y;
+            p.other_z   = pts[i].z;
+            in.weights.pt2pt.push_back(w);
+        }
+    }
+    for (const auto& pl : generate_planes(20))
+    {
+        const auto q = pl.centroid - tOpt;
+        in.paired_pt2pl.emplace_back(
+            pl, mrpt::math::TPoint3Df(
+                    static_cast<float>(q.x), static_cast<float>(q.y),
+                    static_cast<float>(q.z)));
+    }
+
+    const mrpt::poses::CPose3D expected(tOpt.x, tOpt.y, tOpt.z, 0, 0, 0);
+    const auto                 errAfter = [&](const uint32_t nIters) {
+        OptimalTF_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = nIters;
+        gnParams.linearizationPoint     = mrpt::poses::CPose3D();
+
+        WeightParameters wp;
+        OptimalTF_Result res;
+        optimal_tf_gauss_newton(in, wp, res, gnParams);
+        return mrpt::poses::Lie::SE<3>::log(res.optimalPose - expected).norm();
+    };
+
+    // Weighting only the Jacobians gives steps shorter than Gauss-Newton on
+    // the weighted cost, which would solve this linear problem in one
+    // iteration...
+    ASSERT_GT_(errAfter(1), 1e-2);
+
+    // ...but to the same solution:
+    ASSERT_LT_(errAfter(100), 1e-4);
+
+    std::cout << "test_gauss_newton_weights: OK\n";
+}
+
+// The linearized point-to-plane solver must recover a known pose from
+// exact point-to-plane pairings, converging by relinearizing a few times,
+// and refuse to solve with too few pairings:
+static void test_point2plane_linear()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        0.5, -0.3, 0.2, mrpt::DEG2RAD(8.0), mrpt::DEG2RAD(-4.0),
+        mrpt::DEG2RAD(3.0));
+
+    Pairings in;
+    for (const auto& pl : generate_planes(60))
+    {
+        // A few points on each plane, around its centroid:
+        const auto n = pl.plane.getUnitaryNormalVector();
+        auto       u = mrpt::math::crossProduct3D(
+            n, std::abs(n.x) < 0.9 ? mrpt::math::TVector3D(1, 0, 0)
+                                   : mrpt::math::TVector3D(0, 1, 0));
+        u *= 1.0 / u.norm();
+        const auto v = mrpt::math::crossProduct3D(n, u);
+
+        for (int k = 0; k < 3; k++)
+        {
+            const mrpt::math::TPoint3D q = pl.centroid +
+                                           u * rnd.drawUniform(-2.0, 2.0) +
+                                           v * rnd.drawUniform(-2.0, 2.0);
+            mrpt::math::TPoint3D p;
+            gt_pose.inverseComposePoint(q, p);
+            in.paired_pt2pl.emplace_back(
+                pl, mrpt::math::TPoint3Df(
+                        static_cast<float>(p.x), static_cast<float>(p.y),
+                        static_cast<float>(p.z)));
+        }
+    }
+
+    WeightParameters     wp;
+    mrpt::poses::CPose3D pose;
+    for (int iter = 0; iter < 5; iter++)
+    {
+        OptimalTF_Result res;
+        const bool ok = optimal_tf_point2plane_linear(in, wp, pose, res);
+        ASSERT_(ok);
+        pose = res.optimalPose;
+    }
+    const double err = mrpt::poses::Lie::SE<3>::log(pose - gt_pose).norm();
+    ASSERT_LT_(err, 1e-4);
+
+    // Not enough pairings to constrain 6 DOFs:
+    Pairings few;
+    few.paired_pt2pl.assign(
+        in.paired_pt2pl.begin(), in.paired_pt2pl.begin() + 2);
+    OptimalTF_Result res;
+    ASSERT_(!optimal_tf_point2plane_linear(few, wp, pose, res));
+
+    std::cout << "test_point2plane_linear: OK\n";
+}
+
+// Levenberg-Marquardt must converge from an initial guess far enough for
+// plain Gauss-Newton steps to overshoot:
+static void test_levenberg_marquardt()
+{
+    using namespace mp2p_icp;
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        2.0, -1.0, 0.5, mrpt::DEG2RAD(30.0), mrpt::DEG2RAD(-10.0),
+        mrpt::DEG2RAD(5.0));
+
+    const TPoints pA = generate_points(100);
+
+    Pairings in;
+    for (size_t i = 0; i < pA.size(); i++)
+    {
+        mrpt::math::TPoint3D pB;
+        gt_pose.inverseComposePoint(pA[i], pB);
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA[i].x;
+        p.this_y    = pA[i].y;
+        p.this_z    = pA[i].z;
+        p.other_x   = pB.x;
+        p.other_y   = pB.y;
+        p.other_z   = pB.z;
+    }
+
+    OptimalTF_LM_Parameters lmParams;
+    lmParams.maxInnerLoopIterations = 50;
+    lmParams.linearizationPoint     = mrpt::poses::CPose3D();
+
+    WeightParameters wp;
+    OptimalTF_Result res;
+    optimal_tf_levenberg_marquardt(in, wp, res, lmParams);
+
+    const double err =
+        mrpt::poses::Lie::SE<3>::log(res.optimalPose - gt_pose).norm();
+    ASSERT_LT_(err, 1e-6);
+
+    std::cout << "test_levenberg_marquardt: OK\n";
+}
+
+// Redescending robust kernels must completely ignore gross outliers:
+static void test_gauss_newton_robust_kernels()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        1.0, 2.0, -0.5, mrpt::DEG2RAD(10.0), mrpt::DEG2RAD(5.0),
+        mrpt::DEG2RAD(-3.0));
+
+    const TPoints pA = generate_points(200);
+
+    Pairings in;
+    for (size_t i = 0; i < pA.size(); i++)
+    {
+        mrpt::math::TPoint3D pB;
+        gt_pose.inverseComposePoint(pA[i], pB);
+
+        // 20% of outliers:
+        if (i % 5 == 0)
+        {
+            pB.x += rnd.drawUniform(5.0, 20.0);
+            pB.y -= rnd.drawUniform(5.0, 20.0);
+        }
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA[i].x;
+        p.this_y    = pA[i].y;
+        p.this_z    = pA[i].z;
+        p.other_x   = pB.x;
+        p.other_y   = pB.y;
+        p.other_z   = pB.z;
+    }
+
+    for (const auto kernel : {RobustKernel::Tukey, RobustKernel::GemanMcClure})
+    {
+        OptimalTF_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = 15;
+        gnParams.kernel                 = kernel;
+        gnParams.kernelParam            = 0.5;
+        gnParams.linearizationPoint =
+            gt_pose + mrpt::poses::CPose3D(
+                          0.02, -0.01, 0.01, mrpt::DEG2RAD(0.05), 0, 0);
+
+        WeightParameters wp;
+        OptimalTF_Result res;
+        optimal_tf_gauss_newton(in, wp, res, gnParams);
+
+        // Geman-McClure still gives outliers a tiny, non-zero weight:
+        const double err =
+            mrpt::poses::Lie::SE<3>::log(res.optimalPose - gt_pose).norm();
+        ASSERT_LT_(err, 1e-3);
+    }
+
+    std::cout << "test_gauss_newton_robust_kernels: OK\n";
+}
+
+// The compact form of pairings must convert back exactly, store shared
+// planes once, and give the iterative solvers the same results:
+static void test_compact_pairings()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        0.5, -0.3, 0.2, mrpt::DEG2RAD(8.0), mrpt::DEG2RAD(-4.0),
+        mrpt::DEG2RAD(3.0));
+
+    const TPoints pA     = generate_points(100);
+    const auto    planes = generate_planes(20);
+
+    Pairings in;
+    for (size_t i = 0; i < pA.size(); i++)
+    {
+        mrpt::math::TPoint3D pB;
+        gt_pose.inverseComposePoint(pA[i], pB);
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA[i].x;
+        p.this_y    = pA[i].y;
+        p.this_z    = pA[i].z;
+        p.other_x   = pB.x + rnd.drawGaussian1D(0, 0.01);
+        p.other_y   = pB.y + rnd.drawGaussian1D(0, 0.01);
+        p.other_z   = pB.z + rnd.drawGaussian1D(0, 0.01);
+        in.weights.pt2pt.push_back(rnd.drawUniform(0.5, 2.0));
+    }
+    // Each plane paired several times:
+    for (int k = 0; k < 3; k++)
+    {
+        for (const auto& pl : planes)
+        {
+            mrpt::math::TPoint3D p;
+            gt_pose.inverseComposePoint(pl.centroid, p);
+            in.paired_pt2pl.emplace_back(
+                pl, mrpt::math::TPoint3Df(
+                        static_cast<float>(p.x), static_cast<float>(p.y),
+                        static_cast<float>(p.z)));
+        }
+    }
+
+    const auto c = CompactPairings::FromPairings(in);
+    ASSERT_EQUAL_(c.size(), in.size());
+    ASSERT_EQUAL_(c.pt2pl.size(), in.paired_pt2pl.size());
+    ASSERT_EQUAL_(c.planes.size(), planes.size());
+
+    // Back to the legacy form:
+    const auto& legacy = c.asPairings();
+    ASSERT_EQUAL_(legacy.size(), in.size());
+    ASSERT_(legacy.weights.pt2pt == in.weights.pt2pt);
+    for (size_t i = 0; i < in.paired_pt2pt.size(); i++)
+    {
+        const auto &a = in.paired_pt2pt[i], &b = legacy.paired_pt2pt[i];
+        ASSERT_EQUAL_(a.this_idx, b.this_idx);
+        ASSERT_EQUAL_(a.other_x, b.other_x);
+        ASSERT_EQUAL_(a.this_z, b.this_z);
+    }
+    for (size_t i = 0; i < in.paired_pt2pl.size(); i++)
+    {
+        const auto &a = in.paired_pt2pl[i], &b = legacy.paired_pt2pl[i];
+        ASSERT_EQUAL_(a.pt_other.x, b.pt_other.x);
+        for (int k = 0; k < 4; k++)
+            ASSERT_EQUAL_(a.pl_this.plane.coefs[k], b.pl_this.plane.coefs[k]);
+        ASSERT_EQUAL_(a.pl_this.centroid.y, b.pl_this.centroid.y);
+    }
+
+    // Same solution from both forms:
+    WeightParameters wp;
+
+    OptimalTF_GN_Parameters gnParams;
+    gnParams.linearizationPoint = mrpt::poses::CPose3D();
+    gnParams.kernel             = RobustKernel::Huber;
+
+    OptimalTF_Result gn1, gn2;
+    optimal_tf_gauss_newton(in, wp, gn1, gnParams);
+    optimal_tf_gauss_newton(c, wp, gn2, gnParams);
+    ASSERT_EQUAL_(gn1.optimalPose.asString(), gn2.optimalPose.asString());
+
+    OptimalTF_LM_Parameters lmParams;
+    lmParams.linearizationPoint = mrpt::poses::CPose3D();
+
+    OptimalTF_Result lm1, lm2;
+    optimal_tf_levenberg_marquardt(in, wp, lm1, lmParams);
+    optimal_tf_levenberg_marquardt(c, wp, lm2, lmParams);
+    ASSERT_EQUAL_(lm1.optimalPose.asString(), lm2.optimalPose.asString());
+
+    const double err =
+        mrpt::poses::Lie::SE<3>::log(lm2.optimalPose - gt_pose).norm();
+    ASSERT_LT_(err, 1e-2);
+
+    // Through the Solver interface:
+    Solver_GaussNewton solver;
+    SolverContext      sc;
+    sc.guessRelativePose = mrpt::poses::CPose3D();
+
+    OptimalTF_Result s1, s2;
+    ASSERT_(solver.optimal_pose(in, s1, wp, sc));
+    ASSERT_(solver.optimal_pose(c, s2, wp, sc));
+    ASSERT_EQUAL_(s1.optimalPose.asString(), s2.optimalPose.asString());
+
+    std::cout << "test_compact_pairings: OK\n";
+}
+
+// Planar mask: only x, y, yaw must change, keeping z, pitch, roll from the
+// initial guess, which need not be zero.
+static void test_dof_mask_planar()
+{
+    using namespace mp2p_icp;
+
+    const auto guess = mrpt::poses::CPose3D(
+        0.0, 0.0, 0.3, 0.0, mrpt::DEG2RAD(4.0), mrpt::DEG2RAD(-3.0));
+    const auto gt_pose = mrpt::poses::CPose3D(
+        1.5, -0.7, 0.3, mrpt::DEG2RAD(25.0), mrpt::DEG2RAD(4.0),
+        mrpt::DEG2RAD(-3.0));
+
+    const TPoints pA = generate_points(100);
+
+    Pairings in;
+    for (size_t i = 0; i < pA.size(); i++)
+    {
+        mrpt::math::TPoint3D pB;
+        gt_pose.inverseComposePoint(pA[i], pB);
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA[i].x;
+        p.this_y    = pA[i].y;
+        p.this_z    = pA[i].z;
+        p.other_x   = pB.x;
+        p.other_y   = pB.y;
+        p.other_z   = pB.z;
+    }
+
+    const auto checkSolution = [&](const mrpt::poses::CPose3D& sol) {
+        const double err = mrpt::poses::Lie::SE<3>::log(sol - gt_pose).norm();
+        ASSERT_LT_(err, 1e-6);
+        ASSERT_NEAR_(sol.z(), guess.z(), 1e-9);
+        ASSERT_NEAR_(sol.pitch(), guess.pitch(), 1e-9);
+        ASSERT_NEAR_(sol.roll(), guess.roll(), 1e-9);
+    };
+
+    WeightParameters wp;
+
+    // Gauss-Newton:
+    {
+        OptimalTF_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = 20;
+        gnParams.linearizationPoint     = guess;
+        gnParams.dofMask                = DOFMask::Planar();
+
+        OptimalTF_Result res;
+        optimal_tf_gauss_newton(in, wp, res, gnParams);
+        checkSolution(res.optimalPose);
+    }
+
+    // Linearized point-to-plane, relinearized a few times:
+    {
+        OptimalTF_Result res;
+        res.optimalPose = guess;
+        for (int i = 0; i < 10; i++)
+        {
+            const bool ok = optimal_tf_point2plane_linear(
+                in, wp, res.optimalPose, res, DOFMask::Planar());
+            ASSERT_(ok);
+        }
+        checkSolution(res.optimalPose);
+    }
+
+    std::cout << "test_dof_mask_planar: OK\n";
+}
+
+static void test_se2_solvers()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose2D(2.1, -0.4, mrpt::DEG2RAD(35.0));
+
+    Pairings in;
+    for (size_t i = 0; i < 50; i++)
+    {
+        const mrpt::math::TPoint2D pA(
+            rnd.drawUniform(-10.0, 10.0), rnd.drawUniform(-10.0, 10.0));
+        mrpt::math::TPoint2D pB;
+        gt_pose.inverseComposePoint(pA.x, pA.y, pB.x, pB.y);
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA.x;
+        p.this_y    = pA.y;
+        p.this_z    = 0;
+        p.other_x   = pB.x;
+        p.other_y   = pB.y;
+        p.other_z   = 0;
+    }
+
+    const auto checkSolution = [&](const mrpt::poses::CPose3D& sol) {
+        const auto sol2D = mrpt::poses::CPose2D(sol);
+        ASSERT_NEAR_(sol2D.x(), gt_pose.x(), 1e-6);
+        ASSERT_NEAR_(sol2D.y(), gt_pose.y(), 1e-6);
+        ASSERT_NEAR_(sol2D.phi(), gt_pose.phi(), 1e-6);
+        ASSERT_NEAR_(sol.z(), 0.0, 1e-9);
+        ASSERT_NEAR_(sol.pitch(), 0.0, 1e-9);
+        ASSERT_NEAR_(sol.roll(), 0.0, 1e-9);
+    };
+
+    WeightParameters wp;
+
+    // Closed form:
+    {
+        OptimalTF_Result res;
+        const bool       ok = optimal_tf_se2_closed_form(in, wp, res);
+        ASSERT_(ok);
+        checkSolution(res.optimalPose);
+    }
+
+    // Gauss-Newton:
+    {
+        OptimalTF_SE2_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = 20;
+        gnParams.linearizationPoint     = mrpt::poses::CPose2D(0, 0, 0);
+
+        OptimalTF_Result res;
+        optimal_tf_se2_gauss_newton(in, wp, res, gnParams);
+        checkSolution(res.optimalPose);
+    }
+
+    // Gauss-Newton, with a fixed yaw: it must keep the value of the
+    // linearization point, whether it is the right one or not:
+    for (const double fixedYaw : {gt_pose.phi(), 0.0})
+    {
+        OptimalTF_SE2_GN_Parameters gnParams;
+        gnParams.maxInnerLoopIterations = 20;
+        gnParams.linearizationPoint = mrpt::poses::CPose2D(0, 0, fixedYaw);
+        gnParams.dofMask.yaw        = false;
+
+        OptimalTF_Result res;
+        optimal_tf_se2_gauss_newton(in, wp, res, gnParams);
+
+        const auto sol2D = mrpt::poses::CPose2D(res.optimalPose);
+        ASSERT_NEAR_(sol2D.phi(), fixedYaw, 1e-9);
+        if (fixedYaw == gt_pose.phi()) checkSolution(res.optimalPose);
+    }
+
+    std::cout << "test_se2_solvers: OK\n";
+}
+
+// Half of the point-to-point pairings are gross outliers:
+static void test_solver_ransac()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const auto gt_pose = mrpt::poses::CPose3D(
+        1.0, -2.0, 0.5, mrpt::DEG2RAD(40.0), mrpt::DEG2RAD(-10.0),
+        mrpt::DEG2RAD(5.0));
+
+    const TPoints pA = generate_points(200);
+
+    Pairings            in;
+    std::vector<size_t> gtOutliers;
+    for (size_t i = 0; i < pA.size(); i++)
+    {
+        mrpt::math::TPoint3D pB;
+        gt_pose.inverseComposePoint(pA[i], pB);
+
+        if (i % 2)
+        {
+            pB.x += rnd.drawUniform(1.0, 5.0);
+            pB.y -= rnd.drawUniform(1.0, 5.0);
+            gtOutliers.push_back(i);
+        }
+
+        auto& p     = in.paired_pt2pt.emplace_back();
+        p.this_idx  = i;
+        p.other_idx = i;
+        p.this_x    = pA[i].x;
+        p.this_y    = pA[i].y;
+        p.this_z    = pA[i].z;
+        p.other_x   = pB.x;
+        p.other_y   = pB.y;
+        p.other_z   = pB.z;
+    }
+
+    Solver_RANSAC solver;
+    solver.inlierThreshold = 0.05;
+    solver.randomSeed      = 1234;
+
+    WeightParameters wp;
+    wp.use_scale_outlier_detector = false;
+
+    OptimalTF_Result res;
+    const bool       ok = solver.optimal_pose(in, res, wp, SolverContext());
+    ASSERT_(ok);
+
+    const double err =
+        mrpt::poses::Lie::SE<3>::log(res.optimalPose - gt_pose).norm();
+    ASSERT_LT_(err, 1e-4);
+    ASSERT_(res.outliers.point2point == gtOutliers);
+
+    // Same result regardless of the number of threads:
+    for (const uint32_t nThreads : {1U, 4U})
+    {
+        solver.maxThreads = nThreads;
+
+        OptimalTF_Result res2;
+        ASSERT_(solver.optimal_pose(in, res2, wp, SolverContext()));
+        ASSERT_EQUAL_(res2.optimalPose.asString(), res.optimalPose.asString());
+        ASSERT_(res2.outliers.point2point == res.outliers.point2point);
+    }
+
+    std::cout << "test_solver_ransac: OK\n";
+}
+
+// A long corridor: most point-to-plane pairings lie on the side walls and only
+// a few on the far end wall, which alone constrain the motion along it.
+// Those must survive a strong decimation of pairings.
+static void test_select_informative_pairings()
+{
+    using namespace mp2p_icp;
+
+    auto& rnd = mrpt::random::getRandomGenerator();
+
+    const mrpt::math::TPlane leftWall({0, 1, 0}, {1, 1, 0}, {0, 1, 1});
+    const mrpt::math::TPlane rightWall({0, -1, 0}, {1, -1, 0}, {0, -1, 1});
+    const mrpt::math::TPlane endWall({50, 0, 0}, {50, 1, 0}, {50, 0, 1});
+
+    const size_t nSide = 1000, nEnd = 10;
+
+    Pairings in;
+    for (size_t i = 0; i < nSide; i++)
+    {
+        const mrpt::math::TPoint3Df pt(
+            rnd.drawUniform(0.0f, 50.0f), (i % 2) ? 1.0f : -1.0f,
+            rnd.drawUniform(0.0f, 3.0f));
+        in.paired_pt2pl.emplace_back(
+            plane_patch_t(
+                (i % 2) ? leftWall : rightWall, mrpt::math::TPoint3D(pt)),
+            pt);
+    }
+    for (size_t i = 0; i < nEnd; i++)
+    {
+        const mrpt::math::TPoint3Df pt(
+            50.0f, rnd.drawUniform(-1.0f, 1.0f), rnd.drawUniform(0.0f, 3.0f));
+        in.paired_pt2pl.emplace_back(
+            plane_patch_t(endWall, mrpt::math::TPoint3D(pt)), pt);
+    }
+
+    PairingsSelectionParameters p;
+    p.enabled     = true;
+    p.keepRatio   = 0.05;
+    p.minPairings = 0;
+
+    const Pairings out =
+        select_informative_pairings(in, p, mrpt::poses::CPose3D());
+
+    ASSERT_EQUAL_(out.paired_pt2pl.size(), 51U);
+
+    size_t nEndKept = 0;
+    for (const auto& pair : out.paired_pt2pl)
+        if (pair.pt_other.x == 50.0f) nEndKept++;
+
+    ASSERT_EQUAL_(nEndKept, nEnd);
+
+    std::cout << "test_select_informative_pairings: OK\n";
+}
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
 {
     try
@@ -513,6 +1126,16 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
         const double nXYZ = 0.001;  // [meters] std. noise of XYZ points
         const double nN   = mrpt::DEG2RAD(0.5);  // normals noise
 
+        test_select_informative_pairings();
+        test_gauss_newton_weights();
+        test_point2plane_linear();
+        test_levenberg_marquardt();
+        test_gauss_newton_robust_kernels();
+        test_compact_pairings();
+        test_dof_mask_planar();
+        test_se2_solvers();
+        test_solver_ransac();
+
         // arguments: nPts, nLines, nPlanes
         // Points only. Noiseless:
         ASSERT_(test_icp_algos(3 /*pt*/, 0 /*li*/, 0 /*pl*/));
@@ -0,0 +1,504 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @file   test-mp2p_pointcloud_io.cpp
+ * @brief  Unit tests for pointcloud_t serialization and file formats
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/MappedPointCloud.h>
+#include <mp2p_icp/TiledPointCloud.h>
+#include <mp2p_icp/morton_order.h>
+#include <mp2p_icp/pointcloud.h>
+#include <mrpt/io/CMemoryStream.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+#include <mrpt/serialization/CArchive.h>
+#include <mrpt/system/filesystem.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+static mp2p_icp::pointcloud_t generateTestCloud()
+{
+    mp2p_icp::pointcloud_t pc;
+
+    auto pts = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 1000; i++)
+        pts->insertPoint(i * 0.1f, -i * 0.2f, 1.0f + i * 0.01f);
+    pc.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] = pts;
+
+    // An empty layer:
+    pc.point_layers["empty"] = mrpt::maps::CSimplePointsMap::Create();
+
+    pc.planes.emplace_back(
+        mrpt::math::TPlane(0, 0, 1, -2), mrpt::math::TPoint3D(1, 2, 2));
+    pc.planes.emplace_back(
+        mrpt::math::TPlane(1, 0, 0, 5), mrpt::math::TPoint3D(-5, 0, 1));
+
+    pc.lines.push_back(mrpt::math::TLine3D::FromPointAndDirector(
+        {1.0, 2.0, 3.0}, {0.0, 0.0, 1.0}));
+
+    return pc;
+}
+
+static void checkEqual(
+    const mp2p_icp::pointcloud_t& a, const mp2p_icp::pointcloud_t& b)
+{
+    ASSERT_EQUAL_(a.point_layers.size(), b.point_layers.size());
+    for (const auto& [name, pts] : a.point_layers)
+    {
+        ASSERT_(b.point_layers.count(name) != 0);
+        const auto& other = b.point_layers.at(name);
+        ASSERT_EQUAL_(pts->size(), other->size());
+        for (std::size_t i = 0; i < pts->size(); i++)
+        {
+            ASSERT_EQUAL_(
+                pts->getPointsBufferRef_x()[i],
+                other->getPointsBufferRef_x()[i]);
+            ASSERT_EQUAL_(
+                pts->getPointsBufferRef_y()[i],
+                other->getPointsBufferRef_y()[i]);
+            ASSERT_EQUAL_(
+                pts->getPointsBufferRef_z()[i],
+                other->getPointsBufferRef_z()[i]);
+        }
+    }
+
+    ASSERT_EQUAL_(a.planes.size(), b.planes.size());
+    for (std::size_t i = 0; i < a.planes.size(); i++)
+    {
+        for (int k = 0; k < 4; k++)
+            ASSERT_EQUAL_(
+                a.planes[i].plane.coefs[k], b.planes[i].plane.coefs[k]);
+        ASSERT_EQUAL_(a.planes[i].centroid, b.planes[i].centroid);
+    }
+
+    ASSERT_EQUAL_(a.lines.size(), b.lines.size());
+    for (std::size_t i = 0; i < a.lines.size(); i++)
+    {
+        ASSERT_EQUAL_(a.lines[i].pBase, b.lines[i].pBase);
+        for (int k = 0; k < 3; k++)
+            ASSERT_EQUAL_(a.lines[i].director[k], b.lines[i].director[k]);
+    }
+}
+
+static void test_serialization()
+{
+    const auto pc = generateTestCloud();
+
+    mrpt::io::CMemoryStream buf;
+    auto                    arch = mrpt::serialization::archiveFrom(buf);
+    arch << pc;
+
+    buf.Seek(0);
+    mp2p_icp::pointcloud_t pc2;
+    arch >> pc2;
+
+    checkEqual(pc, pc2);
+}
+
+static void test_columnar_file()
+{
+    const auto        pc   = generateTestCloud();
+    const std::string file = mrpt::system::getTempFileName();
+
+    mp2p_icp::save_columnar(pc, file);
+
+    {
+        const mp2p_icp::MappedPointCloud m(file);
+
+        ASSERT_EQUAL_(m.layers().size(), 2U);
+        ASSERT_EQUAL_(m.planeCount(), 2U);
+        ASSERT_EQUAL_(m.lineCount(), 1U);
+        ASSERT_(m.layer("missing") == nullptr);
+
+        const auto* raw = m.layer(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        ASSERT_(raw != nullptr);
+        ASSERT_EQUAL_(raw->size, 1000U);
+        ASSERT_EQUAL_(
+            raw->className,
+            std::string(CLASS_ID(mrpt::maps::CSimplePointsMap)->className));
+        ASSERT_EQUAL_(raw->y[10], -10 * 0.2f);
+
+        // Columns are page aligned:
+        ASSERT_EQUAL_(reinterpret_cast<uintptr_t>(raw->x) % 4096, 0U);
+
+        checkEqual(pc, m.toPointCloud());
+    }
+
+    // Not a valid file:
+    {
+        mrpt::io::CMemoryStream buf;
+        auto                    arch = mrpt::serialization::archiveFrom(buf);
+        arch << pc;
+        buf.saveBufferToFile(file);
+    }
+    bool thrown = false;
+    try
+    {
+        const mp2p_icp::MappedPointCloud m(file);
+    }
+    catch (const std::exception&)
+    {
+        thrown = true;
+    }
+    ASSERT_(thrown);
+
+    // Contents the format cannot hold are refused, not dropped:
+    const std::vector<float> xyz = {1.0f, 2.0f, 3.0f};
+    for (int k = 0; k < 3; k++)
+    {
+        auto pc2 = pc;
+        if (k == 0)
+            pc2.external_layers["scan"] =
+                mp2p_icp::PointsView::FromInterleaved(xyz.data(), 1);
+        else if (k == 1)
+            pc2.quantized_layers["map"] = mp2p_icp::QuantizedPoints::Create();
+        else
+            pc2.layer_normals[mp2p_icp::pointcloud_t::PT_LAYER_RAW] =
+                mp2p_icp::PointNormals::Create();
+
+        thrown = false;
+        try
+        {
+            mp2p_icp::save_columnar(pc2, file);
+        }
+        catch (const std::exception&)
+        {
+            thrown = true;
+        }
+        ASSERT_(thrown);
+    }
+
+    mrpt::system::deleteFile(file);
+}
+
+static void test_merge()
+{
+    const auto  pc  = generateTestCloud();
+    const auto& raw = pc.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+
+    // Without a pose, new layers are copied:
+    {
+        mp2p_icp::pointcloud_t m;
+        m.mergeWith(pc);
+        checkEqual(pc, m);
+        ASSERT_(
+            m.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW) != raw);
+
+        m.mergeWith(pc);
+        ASSERT_EQUAL_(raw->size(), 1000U);
+        ASSERT_EQUAL_(
+            m.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW)->size(),
+            2000U);
+        ASSERT_EQUAL_(m.planes.size(), 4U);
+
+        m.mutableLayer("empty")->insertPoint(1, 2, 3);
+        ASSERT_(pc.point_layers.at("empty")->empty());
+    }
+
+    // Modifying the source after a merge, even through its layer pointers,
+    // leaves the merged copy untouched:
+    {
+        auto  src = generateTestCloud();
+        auto& srcRaw =
+            src.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        auto srcN = mp2p_icp::PointNormals::Create();
+        srcN->resize(srcRaw->size());
+        src.layer_normals[mp2p_icp::pointcloud_t::PT_LAYER_RAW] = srcN;
+
+        mp2p_icp::pointcloud_t m;
+        m.mergeWith(src);
+        checkEqual(src, m);
+
+        srcRaw->setPoint(0, 1e3f, 1e3f, 1e3f);
+        srcRaw->insertPoint(1, 2, 3);
+        srcN->nx[0] = 7.0f;
+
+        const auto& mRaw =
+            m.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        ASSERT_EQUAL_(mRaw->size(), raw->size());
+        float x, y, z;
+        mRaw->getPoint(0, x, y, z);
+        ASSERT_LT_(x, 1e3f);
+
+        const auto mNormals =
+            m.normalsOf(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        ASSERT_(mNormals);
+        ASSERT_(mNormals->nx[0] != 7.0f);
+
+        // The rvalue overload shares layers held elsewhere instead:
+        const auto srcCopy = src;
+        mp2p_icp::pointcloud_t m2;
+        m2.mergeWith(std::move(src));
+        ASSERT_(
+            m2.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW) ==
+            srcCopy.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW));
+    }
+
+    // With a pose: points, lines and planes are transformed.
+    {
+        const mrpt::math::TPose3D  p(1.0, 2.0, 3.0, 0.5, 0.2, -0.1);
+        const mrpt::poses::CPose3D pose(p);
+
+        mp2p_icp::pointcloud_t m;
+        m.mergeWith(pc, p);
+        ASSERT_EQUAL_(m.size(), pc.size());
+
+        const auto& mRaw =
+            m.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        for (std::size_t i = 0; i < raw->size(); i += 100)
+        {
+            float x, y, z;
+            raw->getPoint(i, x, y, z);
+            const auto g = pose.composePoint(mrpt::math::TPoint3D(x, y, z));
+            mRaw->getPoint(i, x, y, z);
+            ASSERT_NEAR_(x, g.x, 1e-4);
+            ASSERT_NEAR_(y, g.y, 1e-4);
+            ASSERT_NEAR_(z, g.z, 1e-4);
+        }
+
+        for (std::size_t i = 0; i < pc.planes.size(); i++)
+        {
+            const auto& pl = m.planes[i];
+            const auto  c  = pose.composePoint(pc.planes[i].centroid);
+            ASSERT_NEAR_(pl.centroid.x, c.x, 1e-9);
+            // The transformed centroid lies on the transformed plane:
+            ASSERT_NEAR_(pl.plane.evaluatePoint(pl.centroid), 0.0, 1e-9);
+            const auto n = pose.rotateVector(
+                pc.planes[i].plane.getUnitaryNormalVector());
+            const auto n2 = pl.plane.getUnitaryNormalVector();
+            ASSERT_NEAR_(n.x, n2.x, 1e-9);
+            ASSERT_NEAR_(n.y, n2.y, 1e-9);
+            ASSERT_NEAR_(n.z, n2.z, 1e-9);
+        }
+
+        // The rvalue overload gives the same result, and steals the layers:
+        auto pcCopy = generateTestCloud();
+        const auto* rawCopy =
+            pcCopy.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW).get();
+
+        mp2p_icp::pointcloud_t m2;
+        m2.mergeWith(std::move(pcCopy), p);
+        checkEqual(m, m2);
+        ASSERT_(pcCopy.empty());
+        ASSERT_(
+            m2.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW).get() ==
+            rawCopy);
+    }
+
+    // Large translations (e.g. UTM coordinates) are applied in double
+    // precision: only the stored result is rounded to float.
+    {
+        const mrpt::math::TPose3D  p(4.5e5, 4.1e6, 120.0, 0.3, 0.01, -0.02);
+        const mrpt::poses::CPose3D pose(p);
+
+        mp2p_icp::pointcloud_t m;
+        m.mergeWith(pc, p);
+
+        const auto& mRaw =
+            m.point_layers.at(mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        const auto ulp = [](const double v) {
+            const auto f = static_cast<float>(v);
+            return std::nextafter(f, std::numeric_limits<float>::max()) - f;
+        };
+        for (std::size_t i = 0; i < raw->size(); i += 10)
+        {
+            float x, y, z;
+            raw->getPoint(i, x, y, z);
+            const auto g = pose.composePoint(mrpt::math::TPoint3D(x, y, z));
+            mRaw->getPoint(i, x, y, z);
+            ASSERT_LE_(std::abs(x - g.x), ulp(g.x));
+            ASSERT_LE_(std::abs(y - g.y), ulp(g.y));
+            ASSERT_LE_(std::abs(z - g.z), ulp(g.z));
+        }
+    }
+}
+
+static void test_quantized_layers()
+{
+    const double res = 1e-3;
+
+    // Points spanning several tiles, including negative coordinates:
+    auto pts = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 500; i++)
+        pts->insertPoint(-100.0f + i * 0.4123f, 50.0f - i * 0.0377f, i * 0.05f);
+
+    auto q = mp2p_icp::QuantizedPoints::Create(res);
+    q->insertPoints(mp2p_icp::PointsView::FromPointsMap(*pts));
+    ASSERT_EQUAL_(q->size(), pts->size());
+
+    // Points are reordered by tile: compare against the closest original one.
+    const auto checkDecoded = [&](const mp2p_icp::QuantizedPoints& qp) {
+        const auto dec = qp.toPointsMap();
+        ASSERT_EQUAL_(dec->size(), pts->size());
+        for (std::size_t i = 0; i < dec->size(); i++)
+        {
+            float x, y, z;
+            dec->getPoint(i, x, y, z);
+            double minErr = std::numeric_limits<double>::max();
+            for (std::size_t j = 0; j < pts->size(); j++)
+            {
+                float ox, oy, oz;
+                pts->getPoint(j, ox, oy, oz);
+                const double err = std::max(
+                    {std::abs(x - ox), std::abs(y - oy), std::abs(z - oz)});
+                minErr = std::min(minErr, err);
+            }
+            ASSERT_LT_(minErr, 0.5 * res + 1e-4);
+        }
+    };
+    checkDecoded(*q);
+
+    // Planarity, from the quantized z offsets only:
+    {
+        auto flat = mrpt::maps::CSimplePointsMap::Create();
+        for (int i = 0; i < 500; i++)
+            flat->insertPoint(-100.0f + i * 0.4123f, 50.0f - i * 0.0377f, 0);
+
+        mp2p_icp::pointcloud_t pcFlat;
+        pcFlat.quantized_layers["map"] = mp2p_icp::QuantizedPoints::Create(res);
+        pcFlat.quantized_layers["map"]->insertPoints(
+            mp2p_icp::PointsView::FromPointsMap(*flat));
+        ASSERT_(pcFlat.isPlanar());
+
+        // Just one point off the plane, in the last tile:
+        flat->insertPoint(120.0f, 0.0f, 0.01f);
+        pcFlat.quantized_layers["map"]->insertPoints(
+            mp2p_icp::PointsView::FromPointsMap(*flat));
+        ASSERT_(!pcFlat.isPlanar());
+        ASSERT_(pcFlat.quantized_layers["map"]->isPlanar(0.1));
+
+        ASSERT_(!q->isPlanar(1e-6));
+    }
+
+    // Serialization, within a pointcloud_t:
+    mp2p_icp::pointcloud_t pc;
+    pc.quantized_layers["map"] = q;
+    ASSERT_EQUAL_(pc.size(), pts->size());
+
+    mrpt::io::CMemoryStream buf;
+    auto                    arch = mrpt::serialization::archiveFrom(buf);
+    arch << pc;
+    buf.Seek(0);
+    mp2p_icp::pointcloud_t pc2;
+    arch >> pc2;
+
+    ASSERT_EQUAL_(pc2.quantized_layers.size(), 1U);
+    ASSERT_NEAR_(pc2.quantized_layers.at("map")->resolution(), res, 1e-12);
+    checkDecoded(*pc2.quantized_layers.at("map"));
+
+    // Merging:
+    pc2.mergeWith(pc);
+    ASSERT_EQUAL_(pc2.quantized_layers.at("map")->size(), 2 * pts->size());
+}
+
+static void test_tiled_map()
+{
+    // generateTestCloud() points have x in [0,100], y in [-200,0]:
+    const auto pc = generateTestCloud();
+
+    const std::string dir = mrpt::system::getTempFileName();
+    mrpt::system::deleteFile(dir);
+    ASSERT_(mrpt::system::createDirectory(dir));
+
+    mp2p_icp::save_tiled(pc, dir, 10.0);
+
+    {
+        mp2p_icp::TiledPointCloud tiled(dir, 3);
+        ASSERT_EQUAL_(tiled.tileSize(), 10.0);
+
+        // All points and primitives are in some tile:
+        std::size_t n = 0;
+        for (const auto& idx : tiled.tiles()) n += tiled.tile(idx)->size();
+        ASSERT_EQUAL_(n, pc.size());
+        ASSERT_EQUAL_(tiled.cachedTileCount(), 3U);
+
+        // Points in tiles are in Z-order:
+        const auto t0 = tiled.tile(*tiled.tiles().begin());
+        for (const auto& layer : t0->point_layers)
+        {
+            const auto& pts = *layer.second;
+
+            mrpt::math::TPoint3Df bbMin, bbMax;
+            pts.boundingBox(
+                bbMin.x, bbMax.x, bbMin.y, bbMax.y, bbMin.z, bbMax.z);
+
+            const auto& xs = pts.getPointsBufferRef_x();
+            const auto& ys = pts.getPointsBufferRef_y();
+            const auto& zs = pts.getPointsBufferRef_z();
+            for (std::size_t i = 1; i < pts.size(); i++)
+            {
+                ASSERT_LE_(
+                    mp2p_icp::morton_code(
+                        xs[i - 1], ys[i - 1], zs[i - 1], bbMin, bbMax),
+                    mp2p_icp::morton_code(xs[i], ys[i], zs[i], bbMin, bbMax));
+            }
+        }
+
+        ASSERT_(tiled.tile({1000, 1000, 1000}) == nullptr);
+
+        // A region with only the first points:
+        const auto m1 = tiled.mapAround({0, -1, 0}, {1, 0, 2});
+        ASSERT_(m1->point_layers.count(mp2p_icp::pointcloud_t::PT_LAYER_RAW));
+        const auto& raw = m1->point_layers.at(
+            mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+        ASSERT_(raw->size() > 0 && raw->size() < 1000U);
+
+        // Same tiles, same map:
+        ASSERT_(tiled.mapAround({0.5, -0.5, 1}, {0.6, 0.5, 1.1}) == m1);
+
+        // From a local cloud:
+        mp2p_icp::pointcloud_t local;
+        auto                   lpts = mrpt::maps::CSimplePointsMap::Create();
+        lpts->insertPoint(-0.5f, -0.5f, 0.0f);
+        lpts->insertPoint(0.5f, 0.5f, 0.0f);
+        local.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] = lpts;
+
+        const auto m2 =
+            tiled.mapFor(local, mrpt::poses::CPose3D(50, -100, 1.5, 0, 0, 0));
+        ASSERT_(m2 != m1);
+        ASSERT_(!m2->empty());
+
+        // The same local box, from an external layer, and a smaller one, are
+        // within the last map:
+        const std::vector<float> buf = {-0.5f, -0.5f, 0.0f, 0.5f, 0.5f, 0.0f};
+        mp2p_icp::pointcloud_t   localExt;
+        localExt.external_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] =
+            mp2p_icp::PointsView::FromInterleaved(buf.data(), 2);
+        ASSERT_(
+            tiled.mapFor(
+                localExt, mrpt::poses::CPose3D(50, -100, 1.5, 0, 0, 0)) == m2);
+        ASSERT_(tiled.mapAround({50, -100, 1.5}, {50, -100, 1.5}) == m2);
+
+        tiled.prefetch(
+            local, {mrpt::poses::CPose3D(90, -180, 1.5, 0, 0, 0)}, 1.0);
+    }
+
+    mrpt::system::deleteFilesInDirectory(dir, true);
+}
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
+{
+    try
+    {
+        test_serialization();
+        test_columnar_file();
+        test_merge();
+        test_quantized_layers();
+        test_tiled_map();
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << mrpt::exception_to_str(e) << "\n";
+        return 1;
+    }
+}
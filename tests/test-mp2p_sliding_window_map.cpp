@@ -0,0 +1,160 @@
+/* -------------------------------------------------------------------------
+ *  A repertory of multi primitive-to-primitive (MP2P) ICP algorithms in C++
+ * Copyright (C) 2018-2020 Jose Luis Blanco, University of Almeria
+ * See LICENSE for license information.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * @file   test-mp2p_sliding_window_map.cpp
+ * @brief  Unit tests for SlidingWindowMap
+ * @author Jose Luis Blanco Claraco
+ * @date   Oct 18, 2020
+ */
+
+#include <mp2p_icp/SlidingWindowMap.h>
+#include <mrpt/maps/CSimplePointsMap.h>
+
+#include <iostream>
+
+// A 1x1 m square with points every 5 cm:
+static mp2p_icp::pointcloud_t generateScan()
+{
+    auto pts = mrpt::maps::CSimplePointsMap::Create();
+    for (int i = 0; i < 20; i++)
+        for (int j = 0; j < 20; j++)
+            pts->insertPoint(0.025f + i * 0.05f, 0.025f + j * 0.05f, 0.1f);
+
+    mp2p_icp::pointcloud_t pc;
+    pc.point_layers[mp2p_icp::pointcloud_t::PT_LAYER_RAW] = pts;
+    return pc;
+}
+
+static void test_dedup_and_eviction()
+{
+    const auto scan = generateScan();
+
+    mp2p_icp::SlidingWindowMap map;
+    map.voxelSize             = 0.2;
+    map.radius                = 10.0;
+    map.evictionCheckDistance = 0;
+
+    // One point per voxel of the 5x5 voxels covered by the scan:
+    map.insertScan(scan, mrpt::poses::CPose3D::Identity());
+    ASSERT_EQUAL_(map.size(), 25U);
+
+    // The same scan again adds nothing:
+    map.insertScan(scan, mrpt::poses::CPose3D::Identity());
+    ASSERT_EQUAL_(map.size(), 25U);
+
+    // Half a meter away, a half-overlapping scan:
+    map.insertScan(scan, mrpt::poses::CPose3D(0.5, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.size(), 25U + 15U);
+
+    // Far away: all previous points are evicted.
+    const mrpt::poses::CPose3D farPose(100, 0, 0, 0, 0, 0);
+    map.insertScan(scan, farPose);
+    ASSERT_EQUAL_(map.size(), 25U);
+
+    const auto& pts = map.asPointCloud().point_layers.at(
+        mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+    for (const float x : pts->getPointsBufferRef_x()) ASSERT_GT_(x, 99.0f);
+
+    // The voxel index is still consistent after eviction:
+    map.insertScan(scan, farPose);
+    ASSERT_EQUAL_(map.size(), 25U);
+
+    map.clear();
+    ASSERT_EQUAL_(map.size(), 0U);
+}
+
+// New points only reach the map, whose KD-trees must be rebuilt then, once
+// they are a given fraction of it:
+static void test_pending_points()
+{
+    const auto scan = generateScan();
+
+    mp2p_icp::SlidingWindowMap map;
+    map.initialize(mrpt::containers::yaml::FromText(R"###(
+voxelSize: 0.2
+radius: 10.0
+evictionCheckDistance: 1000.0
+maxPendingRatio: 0.5
+)###"));
+    ASSERT_EQUAL_(map.maxPendingRatio, 0.5);
+
+    // An empty map gets the first scan right away:
+    map.insertScan(scan, mrpt::poses::CPose3D::Identity());
+    ASSERT_EQUAL_(map.size(), 25U);
+    ASSERT_EQUAL_(map.pendingSize(), 0U);
+
+    // Each shift by one voxel adds a column of 5 new voxels:
+    map.insertScan(scan, mrpt::poses::CPose3D(0.2, 0, 0, 0, 0, 0));
+    map.insertScan(scan, mrpt::poses::CPose3D(0.4, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.size(), 25U);
+    ASSERT_EQUAL_(map.pendingSize(), 10U);
+
+    // Pending points are deduplicated too:
+    map.insertScan(scan, mrpt::poses::CPose3D(0.4, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.pendingSize(), 10U);
+
+    // Above 50% of the map:
+    map.insertScan(scan, mrpt::poses::CPose3D(0.6, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.size(), 40U);
+    ASSERT_EQUAL_(map.pendingSize(), 0U);
+
+    map.insertScan(scan, mrpt::poses::CPose3D(0.8, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.pendingSize(), 5U);
+    map.flush();
+    ASSERT_EQUAL_(map.size(), 45U);
+    ASSERT_EQUAL_(map.pendingSize(), 0U);
+
+    // Pending points are visible to matching:
+    map.insertScan(scan, mrpt::poses::CPose3D(1.0, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.pendingSize(), 5U);
+    ASSERT_EQUAL_(map.asPointCloud().size(), 50U);
+    ASSERT_EQUAL_(map.pendingSize(), 0U);
+}
+
+// Eviction only copies the layers it changes, when they are shared with a
+// copy of the map still in use:
+static void test_eviction_keeps_snapshots()
+{
+    const auto scan = generateScan();
+
+    mp2p_icp::SlidingWindowMap map;
+    map.voxelSize             = 0.2;
+    map.radius                = 10.0;
+    map.evictionCheckDistance = 0;
+
+    map.insertScan(scan, mrpt::poses::CPose3D::Identity());
+    const mp2p_icp::pointcloud_t snapshot = map.asPointCloud();
+    const auto& raw = snapshot.point_layers.at(
+        mp2p_icp::pointcloud_t::PT_LAYER_RAW);
+
+    // Nothing to evict: the layer is not copied.
+    map.insertScan(scan, mrpt::poses::CPose3D::Identity());
+    ASSERT_(
+        map.asPointCloud().point_layers.at(
+            mp2p_icp::pointcloud_t::PT_LAYER_RAW) == raw);
+
+    // All points evicted: the snapshot is left untouched.
+    map.insertScan(scan, mrpt::poses::CPose3D(100, 0, 0, 0, 0, 0));
+    ASSERT_EQUAL_(map.size(), 25U);
+    ASSERT_EQUAL_(raw->size(), 25U);
+    for (const float x : raw->getPointsBufferRef_x()) ASSERT_LT_(x, 2.0f);
+}
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
+{
+    try
+    {
+        test_dedup_and_eviction();
+        test_pending_points();
+        test_eviction_keeps_snapshots();
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << mrpt::exception_to_str(e) << "\n";
+        return 1;
+    }
+}